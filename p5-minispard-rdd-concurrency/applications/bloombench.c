@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "lib.h"
+#include "minispark.h"
+#include "optimizer.h"
+
+// runs a sumjoin of a few files against many (see sumjoin.c) with and
+// without the semi-join filter, and reports how many rows went through
+// the shuffles and the join.
+
+static long shuffled = 0;
+static long joined = 0;
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+unsigned long CountingPartitioner(void* arg, int numpartitions, void* ctx) {
+  __atomic_fetch_add(&shuffled, 1, __ATOMIC_RELAXED);
+  return ColumnHashPartitioner(arg, numpartitions, ctx);
+}
+
+void* CountingSumJoin(void* row1, void* row2, void* ctx) {
+  __atomic_fetch_add(&joined, 1, __ATOMIC_RELAXED);
+  return SumJoin(row1, row2, ctx);
+}
+
+static void run(const char* name, int bloom, struct sumjoin_ctx* sctx, char* files[], int nsmall, int numfiles) {
+  struct colpart_ctx pctx;
+  pctx.keynum = sctx->keynum;
+
+  MS_SetBloomJoin(bloom);
+  MS_ResetBloomJoinStats();
+  shuffled = 0;
+  joined = 0;
+  double t0 = now();
+  RDD* small = map(map(RDDFromFiles(files, nsmall), GetLines), SplitCols);
+  RDD* large = map(map(RDDFromFiles(files + nsmall, numfiles - nsmall), GetLines), SplitCols);
+  RDD* repart1 = partitionBy(small, CountingPartitioner, 4, &pctx);
+  RDD* repart2 = partitionBy(large, CountingPartitioner, 4, &pctx);
+  RDD* joins = withJoinKey(join(repart1, repart2, CountingSumJoin, sctx), ColumnKey, &pctx);
+  int n = count(joins);
+  double secs = now() - t0;
+
+  BloomJoinStats s = MS_GetBloomJoinStats();
+  printf("%-8s rows %d, %.3f s, %ld rows shuffled, %ld pairs joined", name, n, secs, shuffled, joined);
+  if (bloom) {
+    printf(", filter of %ld keys passed %ld of %ld rows", s.keys, s.passed, s.probed);
+  }
+  printf("\n");
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 6) {
+    printf("usage: ./bloombench n m nsmall file1 file2 ...\n");
+    return -1;
+  }
+  struct sumjoin_ctx sctx;
+  sctx.keynum = atoi(argv[1]);
+  sctx.target = atoi(argv[2]);
+  int nsmall = atoi(argv[3]);
+  char** files = argv + 4;
+  int numfiles = argc - 4;
+  if (nsmall < 1 || nsmall >= numfiles) {
+    printf("nsmall must leave files on both sides\n");
+    return -1;
+  }
+
+  MS_Run();
+  run("plain", 0, &sctx, files, nsmall, numfiles);
+  run("bloom", 1, &sctx, files, nsmall, numfiles);
+  MS_TearDown();
+  return 0;
+}
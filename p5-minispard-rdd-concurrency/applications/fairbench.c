@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "lib.h"
+#include "minispark.h"
+#include "scheduler.h"
+
+// runs a big batch job and, while it is running, a few small
+// interactive counts in another pool, and reports each pool's queue
+// wait under the FIFO and the fair scheduler.
+
+static char** files;
+static int numfiles;
+static JobPool* batch_pool;
+static JobPool* interactive_pool;
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+void* SlowMap(void* arg) {
+  usleep(200);
+  return arg;
+}
+
+static void* run_batch(void* arg) {
+  (void)arg;
+  MS_SetPool(batch_pool);
+  count(map(map(RDDFromFiles(files, numfiles), GetLines), SlowMap));
+  return NULL;
+}
+
+static void report(JobPool* pool) {
+  JobPoolStats s = MS_GetPoolStats(pool);
+  printf("  %-12s jobs %ld, tasks %ld, mean wait %.1f usec, max wait %ld usec\n", pool->name,
+         s.jobs, s.tasks, s.tasks > 0 ? (double)s.wait_us / s.tasks : 0.0, s.max_wait_us);
+}
+
+static void run(SchedPolicy* policy) {
+  MS_SetScheduler(policy);
+  MS_Run();
+  MS_ResetPoolStats(batch_pool);
+  MS_ResetPoolStats(interactive_pool);
+
+  pthread_t batch;
+  pthread_create(&batch, NULL, run_batch, NULL);
+  usleep(20 * 1000);
+  MS_SetPool(interactive_pool);
+  double latency = 0;
+  for (int i = 0; i < 5; i++) {
+    double t0 = now();
+    count(map(RDDFromFiles(files, 1), GetLines));
+    latency += now() - t0;
+  }
+  pthread_join(batch, NULL);
+  MS_TearDown();
+
+  printf("%s: interactive count %.1f msec on average\n", policy->name, latency / 5 * 1e3);
+  report(batch_pool);
+  report(interactive_pool);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: ./fairbench file1 ...\n");
+    return -1;
+  }
+  files = argv + 1;
+  numfiles = argc - 1;
+  batch_pool = MS_CreatePool("batch", 1, 0);
+  interactive_pool = MS_CreatePool("interactive", 1, 1);
+  // one task per line, so the batch job floods the queue
+  MS_SetMorselSize(1, 0);
+
+  run(&sched_fifo);
+  run(&sched_fair);
+  return 0;
+}
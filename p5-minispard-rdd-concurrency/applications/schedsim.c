@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+#include "scheduler.h"
+#include "simulator.h"
+
+// records the trace of a job (split the columns of the files, shuffle
+// them by the first column and count both), or loads a saved one, and
+// replays it on CORES simulated cores under each scheduling policy.
+
+#define REMOTE_PENALTY (0.2)
+
+static JobTrace* record(char* files[], int numfiles) {
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+
+  MS_Run();
+  MS_TraceStart();
+  RDD* rows = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+  RDD* repart = partitionBy(rows, ColumnHashPartitioner, numfiles, &pctx);
+  int n = count(repart);
+  int kept = count(filter(rows, StringContains, "a"));
+  JobTrace* trace = MS_TraceStop();
+  MS_TearDown();
+  printf("recorded %d rows (%d kept): %d stages, %d tasks\n", n, kept, trace->nstages, trace->ntasks);
+  return trace;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf("usage: ./schedsim CORES [-o trace] file1 ...\n");
+    printf("       ./schedsim CORES -t trace\n");
+    return -1;
+  }
+  int cores = atoi(argv[1]);
+  JobTrace* trace = NULL;
+  if (strcmp(argv[2], "-t") == 0 && argc > 3) {
+    FILE* in = fopen(argv[3], "r");
+    trace = in != NULL ? trace_load(in) : NULL;
+    if (in != NULL) {
+      fclose(in);
+    }
+    if (trace == NULL) {
+      printf("error, could not load the trace in %s\n", argv[3]);
+      return -1;
+    }
+  } else if (strcmp(argv[2], "-o") == 0 && argc > 4) {
+    trace = record(argv + 4, argc - 4);
+    FILE* out = fopen(argv[3], "w");
+    if (out == NULL || trace_save(trace, out) != 0) {
+      printf("error, could not save the trace to %s\n", argv[3]);
+    }
+    if (out != NULL) {
+      fclose(out);
+    }
+  } else {
+    trace = record(argv + 2, argc - 2);
+  }
+
+  SchedPolicy* policies[] = {&sched_fifo, &sched_steal, &sched_locality, &sched_fair};
+  printf("%d cores, remote tasks %.0f%% slower\n", cores, REMOTE_PENALTY * 100);
+  for (int i = 0; i < 4; i++) {
+    SimConfig config = {cores, policies[i], REMOTE_PENALTY};
+    SimResult r;
+    if (sched_simulate(trace, &config, &r) != 0) {
+      return -1;
+    }
+    printf("  %-9s makespan %8.3f ms, utilization %5.1f%%, remote tasks %d/%d, mean wait %.1f usec\n",
+           policies[i]->name, r.makespan_us / 1e3, r.utilization * 100, r.remote_tasks, r.tasks, r.mean_wait_us);
+  }
+  trace_free(trace);
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "lib.h"
+#include "minispark.h"
+#include "shuffle.h"
+
+// runs the sumjoin job with partitionBy (see sumjoin.c) with element
+// pointers, serialized rows and compressed rows as the shuffle, and
+// reports the bytes the shuffles moved and their CPU cost.
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void run(const char* name, ShuffleCodec* codec, struct sumjoin_ctx* sctx, char* files[], int numfiles) {
+  int group1 = numfiles / 2;
+  int group2 = numfiles - group1;
+  struct colpart_ctx pctx;
+  pctx.keynum = sctx->keynum;
+
+  MS_SetShuffleCodec(codec);
+  MS_ResetShuffleStats();
+  double t0 = now();
+  RDD* data1 = map(map(RDDFromFiles(files, group1), GetLines), SplitCols);
+  RDD* data2 = map(map(RDDFromFiles(files + group1, group2), GetLines), SplitCols);
+  RDD* repart1 = withEncoding(partitionBy(data1, ColumnHashPartitioner, 4, &pctx), RowEncoder, RowDecoder);
+  RDD* repart2 = withEncoding(partitionBy(data2, ColumnHashPartitioner, 4, &pctx), RowEncoder, RowDecoder);
+  int n = count(join(repart1, repart2, SumJoin, sctx));
+  double secs = now() - t0;
+
+  ShuffleStats s = MS_GetShuffleStats();
+  printf("%-8s rows %d, %.3f s", name, n, secs);
+  if (codec == NULL) {
+    printf(", pointers only\n");
+    return;
+  }
+  printf(", %ld rows in %ld blocks, %ld -> %ld bytes (%.1f%%), write %.1f ms, read %.1f ms CPU\n",
+         s.elements, s.blocks, s.raw_bytes, s.bytes, s.raw_bytes > 0 ? 100.0 * s.bytes / s.raw_bytes : 0.0,
+         s.write_us / 1e3, s.read_us / 1e3);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 5) {
+    printf("usage: ./shufflebench n m file1 file2 ...\n");
+    return -1;
+  }
+  struct sumjoin_ctx sctx;
+  sctx.keynum = atoi(argv[1]);
+  sctx.target = atoi(argv[2]);
+  char** files = argv + 3;
+  int numfiles = argc - 3;
+
+  MS_Run();
+  run("pointer", NULL, &sctx, files, numfiles);
+  run("raw", &codec_raw, &sctx, files, numfiles);
+  run("lz", &codec_lz, &sctx, files, numfiles);
+  MS_TearDown();
+  return 0;
+}
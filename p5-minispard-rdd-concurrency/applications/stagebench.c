@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "lib.h"
+#include "minispark.h"
+
+// measures the latency of short stages run back to back, i.e. how fast
+// idle workers pick up the next stage's tasks, under different idling
+// policies and pool sizes, and of stages with WIDE_PARTITIONS tasks,
+// where creating and queueing the tasks dominates.
+
+#define WIDE_PARTITIONS (1000)
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+void* Touch(void* arg) {
+  return arg;
+}
+
+static void run(const char* name, int stages, char* files[], int numfiles) {
+  MS_Run();
+  RDD* rdd = map(RDDFromFiles(files, numfiles), GetLines);
+  count(rdd);
+
+  double total = 0, worst = 0;
+  for (int i = 0; i < stages; i++) {
+    rdd = map(rdd, Touch);
+    double t0 = now();
+    count(rdd);
+    double t = now() - t0;
+    total += t;
+    worst = t > worst ? t : worst;
+  }
+  printf("%-8s stages %d, mean %.1f usec, max %.1f usec\n",
+         name, stages, total / stages * 1e6, worst * 1e6);
+  MS_TearDown();
+}
+
+static void run_wide(int stages, char* files[], int numfiles) {
+  MS_Run();
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+  RDD* rows = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+  RDD* wide = partitionBy(rows, ColumnHashPartitioner, WIDE_PARTITIONS, &pctx);
+  count(wide);
+
+  double total = 0, worst = 0;
+  for (int i = 0; i < stages; i++) {
+    RDD* rdd = map(wide, Touch);
+    double t0 = now();
+    count(rdd);
+    double t = now() - t0;
+    total += t;
+    worst = t > worst ? t : worst;
+  }
+  TaskPoolStats s = MS_GetTaskPoolStats();
+  printf("%-8s stages %d of %d tasks, mean %.1f usec (%.2f usec/task), max %.1f usec, %ld tasks allocated, %ld "
+         "recycled\n",
+         "wide", stages, WIDE_PARTITIONS, total / stages * 1e6, total / stages / WIDE_PARTITIONS * 1e6, worst * 1e6,
+         s.allocated, s.recycled);
+  MS_TearDown();
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf("usage: ./stagebench STAGES file1 ...\n");
+    return -1;
+  }
+  int stages = atoi(argv[1]);
+  char** files = argv + 2;
+  int numfiles = argc - 2;
+
+  MS_SetIdlePolicy(0, 0, DEFAULT_IDLE_TIMEOUT_MS);
+  run("park", stages, files, numfiles);
+
+  MS_SetIdlePolicy(DEFAULT_IDLE_SPINS, DEFAULT_IDLE_YIELDS, DEFAULT_IDLE_TIMEOUT_MS);
+  run("spin", stages, files, numfiles);
+
+  // start with one worker and grow with the queue
+  MS_SetPoolSize(1, 2 * numfiles);
+  run("elastic", stages, files, numfiles);
+
+  MS_SetPoolSize(0, 0);
+  run_wide(stages, files, numfiles);
+  return 0;
+}
@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib.h"
+#include "minispark.h"
+#include "stream.h"
+
+// grepcount over growing files: every interval, only the lines appended
+// since the previous batch are read and filtered.
+int main(int argc, char* argv[]) {
+  if (argc < 5) {
+    printf("usage: ./streamgrepcount <interval ms> <batches> <query> file1 ...\n");
+    return -1;
+  }
+  int interval = atoi(argv[1]);
+  int batches = atoi(argv[2]);
+
+  MS_Run();
+  Stream* s = stream_init(argv + 4, argc - 4, interval);
+  StreamQuery* matches = stream_count(s, filter(stream_source(s), StringContains, argv[3]));
+
+  for (int i = 0; i < batches; i++) {
+    int newlines = stream_run_batch(s);
+    if (newlines < 0) {
+      printf("error reading batch %d\n", i);
+      break;
+    }
+    printf("batch %d: %d new lines, found %ld matches\n", i, newlines, stream_query_count(matches));
+    fflush(stdout);
+  }
+
+  stream_destroy(s);
+  MS_TearDown();
+  return 0;
+}
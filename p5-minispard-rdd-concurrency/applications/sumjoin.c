@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include "lib.h"
 #include "minispark.h"
+#include "tokenize.h"
 
 // - join on column n, sum column m for each joined key
 // - if there are only 2 files, we don't use partitionby
@@ -23,15 +24,15 @@ int main(int argc, char* argv[]) {
 
   MS_Run();
   if (numfiles == 2) {
-    RDD* data1 = map(map(RDDFromFiles(files, 1), GetLines), SplitCols);
-    RDD* data2 = map(map(RDDFromFiles(files + 1, 1), GetLines), SplitCols);
+    RDD* data1 = map(map(RDDFromFiles(files, 1), GetLines), SplitColsFast);
+    RDD* data2 = map(map(RDDFromFiles(files + 1, 1), GetLines), SplitColsFast);
     print(join(data1, data2, SumJoin, (void*)&sctx), RowPrinter);
   } else {
     int group1 = numfiles / 2;
     int group2 = numfiles - group1;
     
-    RDD* data1 = map(map(RDDFromFiles(files, group1), GetLines), SplitCols);
-    RDD* data2 = map(map(RDDFromFiles(files + group1, group2), GetLines), SplitCols);
+    RDD* data1 = map(map(RDDFromFiles(files, group1), GetLines), SplitColsFast);
+    RDD* data2 = map(map(RDDFromFiles(files + group1, group2), GetLines), SplitColsFast);
 
     struct colpart_ctx pctx;
     pctx.keynum = 0;
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "lib.h"
+#include "rowview.h"
+#include "tokenize.h"
+
+// splits the lines of the given files, held in memory, over and over
+// and reports the throughput of SplitCols(), SplitColsFast(),
+// SplitColsView() and tokenize_lines() with each kernel, in MB/s of
+// input, the best of REPEATS runs.
+
+#define REPEATS (3)
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static char* buf;
+static long len;
+static int nlines;
+static struct rowview* views;
+
+// one call of "split" on a copy of every line, as GetLines() makes them
+static void split_lines(void* (*split)(void*)) {
+  for (const char* p = buf; p < buf + len;) {
+    const char* nl = memchr(p, '\n', buf + len - p);
+    long n = (nl ? nl + 1 : buf + len) - p;
+    char* line = malloc(n + 1);
+    memcpy(line, p, n);
+    line[n] = '\0';
+    free(split(line)); // frees the line
+    p += n;
+  }
+}
+
+static void split_views() {
+  int i = 0;
+  for (const char* p = buf; p < buf + len; i++) {
+    const char* nl = memchr(p, '\n', buf + len - p);
+    views[i].line = p;
+    views[i].len = (nl ? nl + 1 : buf + len) - p;
+    SplitColsView(&views[i]);
+    p += views[i].len;
+  }
+}
+
+static void report(const char* name, double secs, int rounds) {
+  printf("%-16s %8.1f MB/s\n", name, (double)len * rounds / secs / 1e6);
+}
+
+static double best(double secs, double t0) {
+  double t = now() - t0;
+  return secs == 0 || t < secs ? t : secs;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf("usage: ./tokenbench ROUNDS file1 ...\n");
+    return -1;
+  }
+  int rounds = atoi(argv[1]);
+  // all files in one buffer
+  long cap = 0;
+  for (int i = 2; i < argc; i++) {
+    FILE* fp = fopen(argv[i], "r");
+    if (fp == NULL) {
+      perror("fopen");
+      return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    cap += ftell(fp);
+    fclose(fp);
+  }
+  buf = malloc(cap + 1);
+  for (int i = 2; i < argc; i++) {
+    FILE* fp = fopen(argv[i], "r");
+    len += fread(buf + len, 1, cap - len, fp);
+    fclose(fp);
+  }
+  buf[len] = '\0';
+  nlines = tokenize_count_lines(buf, len);
+  views = malloc(nlines * sizeof(struct rowview));
+  printf("%ld bytes, %d lines, %d rounds\n", len, nlines, rounds);
+
+  double secs = 0;
+  for (int i = 0; i < REPEATS; i++) {
+    double t0 = now();
+    for (int r = 0; r < rounds; r++) {
+      split_lines(SplitCols);
+    }
+    secs = best(secs, t0);
+  }
+  report("SplitCols", secs, rounds);
+
+  secs = 0;
+  for (int i = 0; i < REPEATS; i++) {
+    double t0 = now();
+    for (int r = 0; r < rounds; r++) {
+      split_lines(SplitColsFast);
+    }
+    secs = best(secs, t0);
+  }
+  report("SplitColsFast", secs, rounds);
+
+  secs = 0;
+  for (int i = 0; i < REPEATS; i++) {
+    double t0 = now();
+    for (int r = 0; r < rounds; r++) {
+      split_views();
+    }
+    secs = best(secs, t0);
+  }
+  report("SplitColsView", secs, rounds);
+
+  static const char* names[] = {"tokenize scalar", "tokenize sse2", "tokenize avx2"};
+  for (int k = TOKENIZE_SCALAR; k <= TOKENIZE_AVX2; k++) {
+    if (tokenize_set_kernel(k) != (TokenizerKernel)k) {
+      continue;
+    }
+    secs = 0;
+    for (int i = 0; i < REPEATS; i++) {
+      double t0 = now();
+      for (int r = 0; r < rounds; r++) {
+        tokenize_lines(buf, len, TOKENIZE_WHITESPACE, views, nlines);
+      }
+      secs = best(secs, t0);
+    }
+    report(names[k], secs, rounds);
+  }
+  free(views);
+  free(buf);
+  return 0;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "lib.h"
+#include "minispark.h"
+#include "rowview.h"
+
+// compares GetLines+SplitCols against the zero-copy views on a
+// split + partitionBy + count job. every allocation in the process is
+// counted by replacing malloc and friends.
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static unsigned long allocs = 0;
+static unsigned long alloc_bytes = 0;
+
+void* malloc(size_t size) {
+  __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&alloc_bytes, size, __ATOMIC_RELAXED);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+  __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&alloc_bytes, n * size, __ATOMIC_RELAXED);
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&alloc_bytes, size, __ATOMIC_RELAXED);
+  return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+  __libc_free(ptr);
+}
+
+static long file_bytes(char* filenames[], int numfiles) {
+  long total = 0;
+  for (int i = 0; i < numfiles; i++) {
+    FILE* fp = fopen(filenames[i], "r");
+    if (fp == NULL) {
+      perror("fopen");
+      exit(1);
+    }
+    fseek(fp, 0, SEEK_END);
+    total += ftell(fp);
+    fclose(fp);
+  }
+  return total;
+}
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void report(const char* name, int rows, double secs, long bytes, unsigned long nallocs, unsigned long nbytes) {
+  printf("%-8s rows %d, %.3f s, %.1f MB/s, %lu allocations, %lu bytes allocated\n",
+         name, rows, secs, bytes / secs / 1e6, nallocs, nbytes);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: ./viewbench file1 ...\n");
+    return -1;
+  }
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+  long bytes = file_bytes(files, numfiles);
+
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+
+  MS_Run();
+
+  unsigned long a0 = allocs, b0 = alloc_bytes;
+  double t0 = now();
+  RDD* rows = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+  int n = count(partitionBy(rows, ColumnHashPartitioner, 8, &pctx));
+  report("copying", n, now() - t0, bytes, allocs - a0, alloc_bytes - b0);
+
+  a0 = allocs;
+  b0 = alloc_bytes;
+  t0 = now();
+  RDD* views = map(mapPartitions(RDDFromFiles(files, numfiles), GetLineViews, NULL), SplitColsView);
+  n = count(partitionBy(views, ColumnHashPartitionerView, 8, &pctx));
+  report("views", n, now() - t0, bytes, allocs - a0, alloc_bytes - b0);
+
+  MS_TearDown();
+  return 0;
+}
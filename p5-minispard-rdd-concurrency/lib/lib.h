@@ -1,3 +1,6 @@
+#ifndef __lib_h__
+#define __lib_h__
+
 #define MAXCOLS (10)
 #define MAXLEN (32)
 #include <dirent.h>
@@ -63,3 +66,5 @@ unsigned long StringHashPartitioner(void* arg, int numpartitions, void* ctx);
 // arg: thing to print
 void StringPrinter(void* arg);
 void RowPrinter(void* arg);
+
+#endif // __lib_h__
@@ -0,0 +1,69 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "accumulator.h"
+#include "minispark.h"
+
+static long acc_identity(AccumulatorOp op) {
+  return op == ACC_MAX ? LONG_MIN : op == ACC_MIN ? LONG_MAX : 0;
+}
+
+static long acc_combine(AccumulatorOp op, long a, long b) {
+  switch (op) {
+  case ACC_MAX:
+    return a > b ? a : b;
+  case ACC_MIN:
+    return a < b ? a : b;
+  default:
+    return a + b;
+  }
+}
+
+Accumulator* acc_create(AccumulatorOp op) {
+  Accumulator* acc = aligned_alloc(ACC_CACHE_LINE, sizeof(Accumulator));
+  if (acc == NULL) {
+    return NULL;
+  }
+  acc->op = op;
+  acc_reset(acc);
+  return acc;
+}
+
+void acc_free(Accumulator* acc) {
+  free(acc);
+}
+
+void acc_add(Accumulator* acc, long v) {
+  int worker = MS_WorkerId();
+  if (worker >= 0 && worker < ACC_SHARDS) {
+    // only this worker writes its shard: a plain read-modify-write,
+    // published with a relaxed store for acc_value()
+    long* value = &acc->shards[worker].value;
+    __atomic_store_n(value, acc_combine(acc->op, *value, v), __ATOMIC_RELAXED);
+    return;
+  }
+  long* value = &acc->shared.value;
+  if (acc->op == ACC_SUM) {
+    __atomic_fetch_add(value, v, __ATOMIC_RELAXED);
+    return;
+  }
+  long cur = __atomic_load_n(value, __ATOMIC_RELAXED);
+  while (acc_combine(acc->op, cur, v) != cur
+         && !__atomic_compare_exchange_n(value, &cur, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+long acc_value(Accumulator* acc) {
+  long value = __atomic_load_n(&acc->shared.value, __ATOMIC_RELAXED);
+  for (int i = 0; i < ACC_SHARDS; i++) {
+    value = acc_combine(acc->op, value, __atomic_load_n(&acc->shards[i].value, __ATOMIC_RELAXED));
+  }
+  return value;
+}
+
+void acc_reset(Accumulator* acc) {
+  long empty = acc_identity(acc->op);
+  for (int i = 0; i < ACC_SHARDS; i++) {
+    __atomic_store_n(&acc->shards[i].value, empty, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&acc->shared.value, empty, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,45 @@
+// accumulators: job-wide counters updated from user functions
+#ifndef __accumulator_h__
+#define __accumulator_h__
+
+#define ACC_SHARDS (64) // workers with a shard of their own
+#define ACC_CACHE_LINE (64)
+
+typedef enum {
+  ACC_SUM,
+  ACC_MAX,
+  ACC_MIN
+} AccumulatorOp;
+
+// One value per worker, each on its own cache line, so a worker adding
+// to it never touches a line another core writes. Threads outside the
+// pool, and workers beyond ACC_SHARDS, share one more shard, updated
+// atomically.
+typedef struct {
+  long value;
+  char pad[ACC_CACHE_LINE - sizeof(long)];
+} AccumulatorShard;
+
+typedef struct {
+  AccumulatorShard shards[ACC_SHARDS];
+  AccumulatorShard shared;
+  AccumulatorOp op;
+} Accumulator;
+
+// returns NULL if it cannot be allocated. free() it with acc_free()
+Accumulator* acc_create(AccumulatorOp op);
+void acc_free(Accumulator* acc);
+
+// Adds "v" to the sum, or takes it into the max or min. Meant for user
+// functions running in tasks, but callable from any thread.
+void acc_add(Accumulator* acc, long v);
+
+// Merges the shards: the sum, the max (LONG_MIN if nothing was added)
+// or the min (LONG_MAX). Exact once the actions that update "acc"
+// returned; while they run, some of their updates may be missing.
+long acc_value(Accumulator* acc);
+
+// back to the empty value, while no task updates "acc"
+void acc_reset(Accumulator* acc);
+
+#endif // __accumulator_h__
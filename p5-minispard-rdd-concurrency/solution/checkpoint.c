@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "shuffle.h"
+
+static int next_checkpoint = 0; // numbers the files of each checkpoint
+
+// what ReadCheckpoint needs to rebuild the elements of a file
+struct checkpoint_ctx {
+  Decoder decode;
+  ShuffleCodec* codec;
+};
+
+// writes the blocks of "blocks" to "fp": the header of each block
+// followed by its data. returns 0 on success
+static int write_blocks_file(List* blocks, FILE* fp) {
+  for (ListNode* node = blocks->head; node != NULL; node = node->next) {
+    ShuffleBlock* block = (ShuffleBlock*)node->data;
+    if (fwrite(block, sizeof(ShuffleBlock), 1, fp) != 1 || fwrite(block->data, 1, block->len, fp) != block->len) {
+      return -1;
+    }
+  }
+  return fflush(fp) == 0 ? 0 : -1;
+}
+
+// PartitionMapper over a checkpoint file: reads its blocks from the
+// start and decodes them into "output"
+static int ReadCheckpoint(void* input, List* output, void* ctx) {
+  struct checkpoint_ctx* cctx = (struct checkpoint_ctx*)ctx;
+  FILE* fp = (FILE*)input;
+  if (fseek(fp, 0, SEEK_SET) != 0) {
+    return -1;
+  }
+  clearerr(fp);
+  List* blocks = list_init();
+  if (blocks == NULL) {
+    return -1;
+  }
+  int ret = -1;
+  ShuffleBlock header;
+  while (fread(&header, sizeof(ShuffleBlock), 1, fp) == 1) {
+    ShuffleBlock* block = malloc(sizeof(ShuffleBlock) + header.len);
+    if (block == NULL) {
+      goto cleanup;
+    }
+    *block = header;
+    if (fread(block->data, 1, block->len, fp) != block->len || list_add_elem(blocks, block) != 0) {
+      printf("error, truncated checkpoint block\n");
+      free(block);
+      goto cleanup;
+    }
+  }
+  if (ferror(fp)) {
+    goto cleanup;
+  }
+  ret = blocks_read(blocks, cctx->decode, cctx->codec, output);
+
+cleanup:
+  shuffle_blocks_clear(blocks);
+  list_free(blocks);
+  return ret;
+}
+
+// rewinds the file sources below "rdd", so whatever else reads them
+// can still recompute from them
+static void rewind_sources(RDD* rdd) {
+  if (is_file_source(rdd)) {
+    for (ListNode* p = rdd->partitions->head; p != NULL; p = p->next) {
+      fseek((FILE*)p->data, 0, SEEK_SET);
+      clearerr((FILE*)p->data);
+    }
+    return;
+  }
+  for (int i = 0; i < rdd->numdependencies; i++) {
+    rewind_sources(rdd->dependencies[i]);
+  }
+}
+
+// replaces the partitions of "rdd" with copies of the lists. returns 0
+// on success
+static int own_partitions(RDD* rdd) {
+  for (ListNode* p = rdd->partitions->head; p != NULL; p = p->next) {
+    List* copy = list_init();
+    if (copy == NULL) {
+      return -1;
+    }
+    for (ListNode* node = ((List*)p->data)->head; node != NULL; node = node->next) {
+      if (list_add_elem(copy, node->data) != 0) {
+        list_free(copy);
+        return -1;
+      }
+    }
+    p->data = copy;
+  }
+  return 0;
+}
+
+int checkpoint(RDD* rdd, const char* dir, Encoder enc, Decoder dec) {
+  if (rdd->numdependencies == 0) {
+    printf("error, RDD %p is a source, there is nothing to checkpoint\n", rdd);
+    return -1;
+  }
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    perror("mkdir");
+    return -1;
+  }
+  if (count(rdd) < 0) {
+    return -1;
+  }
+
+  int id = __atomic_fetch_add(&next_checkpoint, 1, __ATOMIC_RELAXED);
+  int numpartitions = list_get_size(rdd->partitions);
+  char** names = calloc(numpartitions, sizeof(char*));
+  struct checkpoint_ctx* cctx = malloc(sizeof(struct checkpoint_ctx));
+  List* blocks = list_init();
+  int ret = -1;
+  if (names == NULL || cctx == NULL || blocks == NULL) {
+    printf("error allocating checkpoint of RDD %p\n", rdd);
+    goto cleanup;
+  }
+  int pnum = 0;
+  for (ListNode* p = rdd->partitions->head; p != NULL; p = p->next, pnum++) {
+    names[pnum] = malloc(CHECKPOINT_MAX_PATH);
+    if (names[pnum] == NULL) {
+      goto cleanup;
+    }
+    snprintf(names[pnum], CHECKPOINT_MAX_PATH, "%s/rdd-%d-part-%d.ckpt", dir, id, pnum);
+    FILE* fp = fopen(names[pnum], "w");
+    if (fp == NULL) {
+      perror("fopen");
+      goto cleanup;
+    }
+    int written = blocks_write((List*)p->data, enc, &codec_lz, blocks) == 0 && write_blocks_file(blocks, fp) == 0;
+    shuffle_blocks_clear(blocks);
+    if (fclose(fp) != 0 || !written) {
+      printf("error writing partition %i of RDD %p to %s\n", pnum, rdd, names[pnum]);
+      goto cleanup;
+    }
+  }
+
+  // the files become a source, read back by the checkpointed RDD itself
+  RDD* files = RDDFromFiles(names, numpartitions);
+  if (files == NULL) {
+    goto cleanup;
+  }
+  cctx->decode = dec;
+  cctx->codec = &codec_lz;
+  // a union shares its partitions with the inputs released below
+  if (rdd->trans == UNION && own_partitions(rdd) != 0) {
+    goto cleanup;
+  }
+  for (int i = 0; i < rdd->numdependencies; i++) {
+    rdd_reset(rdd->dependencies[i]);
+    rewind_sources(rdd->dependencies[i]);
+  }
+  pthread_mutex_lock(&rdd->rdd_lock);
+  rdd->trans = MAP_PARTITIONS;
+  rdd->fn = (void*)ReadCheckpoint;
+  rdd->ctx = cctx;
+  rdd->cmp = NULL;
+  rdd->dependencies[0] = files;
+  rdd->numdependencies = 1;
+  rdd->join_key = NULL;
+  rdd->join_key_ctx = NULL;
+  rdd->bloom = NULL;
+  pthread_mutex_unlock(&rdd->rdd_lock);
+  cctx = NULL;
+  ret = 0;
+
+cleanup:
+  for (int i = 0; names != NULL && i < numpartitions; i++) {
+    free(names[i]);
+  }
+  free(names);
+  free(cctx);
+  if (blocks != NULL) {
+    list_free(blocks);
+  }
+  return ret;
+}
@@ -0,0 +1,19 @@
+// checkpoints: materialized RDDs saved to local files
+#ifndef __checkpoint_h__
+#define __checkpoint_h__
+
+#include "minispark.h"
+
+#define CHECKPOINT_MAX_PATH (4096)
+
+// Computes "rdd" and writes each of its partitions to a file in "dir"
+// (created if needed), serialized with "enc" and compressed with
+// codec_lz in the shuffle block format (see shuffle.h). "rdd" then reads
+// its partitions back from those files with "dec" instead of computing
+// them from its dependencies, which are dropped: their materialized
+// partitions are freed and file sources below them are rewound.
+// Elements stay with the application, and "rdd" keeps the partitions it
+// already holds. Returns 0 on success.
+int checkpoint(RDD* rdd, const char* dir, Encoder enc, Decoder dec);
+
+#endif // __checkpoint_h__
@@ -0,0 +1,232 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include "footprint.h"
+#include <string.h>
+#include "list.h"
+#include "lib.h"
+
+int mem_accounting = 0;
+static Sizer elem_sizer = NULL;
+static long tracked = 0; // bytes of all counted RDDs
+static long tracked_peak = 0;
+
+// counted RDDs, in the order their first stage started
+static pthread_mutex_t accounts_lock = PTHREAD_MUTEX_INITIALIZER;
+static RDD** accounted = NULL;
+static int naccounted = 0;
+static int accounted_cap = 0;
+
+void MS_SetMemoryAccounting(int enabled, Sizer elem_size) {
+  elem_sizer = elem_size;
+  mem_accounting = enabled;
+}
+
+size_t HeapSize(void* arg) {
+  return malloc_usable_size(arg);
+}
+
+size_t StringSize(void* arg) {
+  return strlen((char*)arg) + 1;
+}
+
+size_t RowSize(void* arg) {
+  (void)arg;
+  return sizeof(struct row);
+}
+
+// adds "bytes" to the tracked total and returns the new total
+static long track(long bytes) {
+  long total = __atomic_add_fetch(&tracked, bytes, __ATOMIC_RELAXED);
+  long peak = __atomic_load_n(&tracked_peak, __ATOMIC_RELAXED);
+  while (total > peak && !__atomic_compare_exchange_n(&tracked_peak, &peak, total, 1, __ATOMIC_RELAXED,
+                                                      __ATOMIC_RELAXED)) {
+  }
+  return total;
+}
+
+static void max_into(long* dst, long value) {
+  long cur = __atomic_load_n(dst, __ATOMIC_RELAXED);
+  while (value > cur && !__atomic_compare_exchange_n(dst, &cur, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+void mem_stage_start(RDD* rdd) {
+  struct MemAccount* acct = rdd->mem;
+  if (acct != NULL && acct->numpartitions != rdd->numpartitions) {
+    mem_release(rdd); // partition count changed since it was counted
+    free(acct->partitions);
+    acct->partitions = NULL;
+  }
+  if (acct == NULL) {
+    acct = calloc(1, sizeof(struct MemAccount));
+    if (acct == NULL) {
+      return;
+    }
+    pthread_mutex_lock(&accounts_lock);
+    if (naccounted == accounted_cap) {
+      int cap = accounted_cap == 0 ? 64 : accounted_cap * 2;
+      RDD** bigger = realloc(accounted, cap * sizeof(RDD*));
+      if (bigger == NULL) {
+        pthread_mutex_unlock(&accounts_lock);
+        free(acct);
+        return;
+      }
+      accounted = bigger;
+      accounted_cap = cap;
+    }
+    accounted[naccounted++] = rdd;
+    rdd->mem = acct;
+    pthread_mutex_unlock(&accounts_lock);
+  }
+  if (acct->partitions == NULL) {
+    acct->partitions = calloc(rdd->numpartitions, sizeof(long));
+    acct->numpartitions = acct->partitions == NULL ? 0 : rdd->numpartitions;
+  }
+  if (acct->overhead == 0) {
+    acct->overhead = sizeof(List) * (rdd->numpartitions + 1);
+    if (rdd->partition_locks != NULL) {
+      acct->overhead += rdd->numpartitions * sizeof(pthread_mutex_t);
+    }
+    max_into(&acct->peak, track(acct->overhead));
+  }
+}
+
+void mem_charge(RDD* rdd, int pnum, long bytes) {
+  struct MemAccount* acct = rdd->mem;
+  if (acct == NULL || pnum < 0 || pnum >= acct->numpartitions) {
+    return;
+  }
+  __atomic_fetch_add(&acct->partitions[pnum], bytes, __ATOMIC_RELAXED);
+  max_into(&acct->peak, track(bytes));
+}
+
+// RDDs whose output holds elements they allocated
+static int creates_elements(RDD* rdd) {
+  switch (rdd->trans) {
+  case MAP:
+    return rdd->fn != (void*)identity;
+  case JOIN:
+  case SORT_MERGE_JOIN:
+  case MAP_PARTITIONS:
+  case ZIP_PARTITIONS:
+    return 1;
+  case PARTITIONBY:
+    return rdd->codec != NULL; // decoded from shuffle blocks
+  default:
+    return 0;
+  }
+}
+
+long mem_list_bytes(RDD* rdd, List* output) {
+  long bytes = (long)list_get_size(output) * sizeof(ListNode);
+  if (elem_sizer != NULL && creates_elements(rdd)) {
+    for (ListNode* node = output->head; node != NULL; node = node->next) {
+      bytes += elem_sizer(node->data);
+    }
+  }
+  return bytes;
+}
+
+// bytes "rdd" holds now
+static long account_bytes(struct MemAccount* acct, long* largest) {
+  long bytes = acct->overhead;
+  *largest = 0;
+  for (int i = 0; i < acct->numpartitions; i++) {
+    long b = __atomic_load_n(&acct->partitions[i], __ATOMIC_RELAXED);
+    bytes += b;
+    *largest = b > *largest ? b : *largest;
+  }
+  return bytes;
+}
+
+void mem_release(RDD* rdd) {
+  struct MemAccount* acct = rdd->mem;
+  if (acct == NULL) {
+    return;
+  }
+  long largest;
+  track(-account_bytes(acct, &largest));
+  for (int i = 0; i < acct->numpartitions; i++) {
+    acct->partitions[i] = 0;
+  }
+  acct->overhead = 0;
+}
+
+long MS_RDDMemory(RDD* rdd) {
+  long largest;
+  return rdd->mem == NULL ? 0 : account_bytes(rdd->mem, &largest);
+}
+
+long MS_TrackedMemory(long* peak) {
+  if (peak != NULL) {
+    *peak = __atomic_load_n(&tracked_peak, __ATOMIC_RELAXED);
+  }
+  return __atomic_load_n(&tracked, __ATOMIC_RELAXED);
+}
+
+static int by_bytes(const void* a, const void* b) {
+  long x = ((const RDDFootprint*)a)->bytes;
+  long y = ((const RDDFootprint*)b)->bytes;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+int MS_LargestRDDs(RDDFootprint* out, int n) {
+  pthread_mutex_lock(&accounts_lock);
+  RDDFootprint* all = malloc((naccounted + 1) * sizeof(RDDFootprint));
+  if (all == NULL) {
+    pthread_mutex_unlock(&accounts_lock);
+    return 0;
+  }
+  for (int i = 0; i < naccounted; i++) {
+    RDD* rdd = accounted[i];
+    all[i].rdd = rdd;
+    all[i].trans = rdd->trans;
+    all[i].numpartitions = rdd->mem->numpartitions;
+    all[i].bytes = account_bytes(rdd->mem, &all[i].largest_partition);
+    all[i].peak = rdd->mem->peak;
+  }
+  qsort(all, naccounted, sizeof(RDDFootprint), by_bytes);
+  int count = naccounted < n ? naccounted : n;
+  for (int i = 0; i < count; i++) {
+    out[i] = all[i];
+  }
+  free(all);
+  pthread_mutex_unlock(&accounts_lock);
+  return count;
+}
+
+void MS_ResetMemoryAccounting() {
+  pthread_mutex_lock(&accounts_lock);
+  for (int i = 0; i < naccounted; i++) {
+    free(accounted[i]->mem->partitions);
+    free(accounted[i]->mem);
+    accounted[i]->mem = NULL;
+  }
+  free(accounted);
+  accounted = NULL;
+  naccounted = accounted_cap = 0;
+  __atomic_store_n(&tracked, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&tracked_peak, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&accounts_lock);
+}
+
+void mem_report() {
+  if (!mem_accounting) {
+    return;
+  }
+  static const char* names[] = {"Map", "Filter", "Join", "PartitionBy", "Stream", "MapPartitions", "SortMergeJoin",
+                                "Union", "ZipPartitions"};
+  RDDFootprint top[MEM_REPORT_TOP];
+  int n = MS_LargestRDDs(top, MEM_REPORT_TOP);
+  long peak;
+  long total = MS_TrackedMemory(&peak);
+  fprintf(stderr, "memory: %ld KiB held by RDDs, %ld KiB at most\n", total / 1024, peak / 1024);
+  fprintf(stderr, "%-18s %-14s %10s %12s %14s %16s\n", "rdd", "transform", "partitions", "KiB", "largest (KiB)",
+          "stage peak (KiB)");
+  for (int i = 0; i < n; i++) {
+    fprintf(stderr, "%-18p %-14s %10d %12ld %14ld %16ld\n", (void*)top[i].rdd, names[top[i].trans],
+            top[i].numpartitions, top[i].bytes / 1024, top[i].largest_partition / 1024, top[i].peak / 1024);
+  }
+}
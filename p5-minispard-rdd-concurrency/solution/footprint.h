@@ -0,0 +1,76 @@
+// memory accounting: bytes held by each RDD
+#ifndef __footprint_h__
+#define __footprint_h__
+
+#include <stddef.h>
+#include "minispark.h"
+
+#define MEM_REPORT_TOP (10) // RDDs listed by the teardown report
+
+// size in bytes of the allocation behind "elem"
+typedef size_t (*Sizer)(void* elem);
+
+// What one RDD holds, as counted when its tasks finished: list nodes
+// and partition lists for every RDD, plus the elements of RDDs that
+// create them (maps, joins, mapPartitions, zipPartitions and serialized
+// shuffles; filters, partitionBys and unions only point to elements of
+// their inputs).
+typedef struct {
+  RDD* rdd;
+  Transform trans;
+  int numpartitions;
+  long bytes; // held now
+  long largest_partition; // bytes of its largest partition
+  long peak; // tracked bytes of all RDDs at the high point of its stage
+} RDDFootprint;
+
+// per-RDD counters, allocated when a stage starts with accounting on
+struct MemAccount {
+  long* partitions; // bytes per partition
+  int numpartitions;
+  long overhead; // partition lists and locks
+  long peak;
+};
+
+// 0 when accounting is off
+extern int mem_accounting;
+
+// Count the memory of the RDDs executed from now on. "elem_size" gives
+// the size of an element (e.g. HeapSize), or NULL to only count what
+// MiniSpark allocates itself. Counting walks every task's output once,
+// so it is off by default. While on, MS_TearDown() prints the
+// MEM_REPORT_TOP largest RDDs to stderr.
+void MS_SetMemoryAccounting(int enabled, Sizer elem_size);
+
+// bytes "rdd" holds, 0 if it was not counted
+long MS_RDDMemory(RDD* rdd);
+
+// bytes held by all counted RDDs now, and at most at any time (in "*peak")
+long MS_TrackedMemory(long* peak);
+
+// Fills "out" with up to "n" counted RDDs, largest first; returns how many
+int MS_LargestRDDs(RDDFootprint* out, int n);
+
+// forgets every counted RDD
+void MS_ResetMemoryAccounting();
+
+// Sizers
+// arg: a malloc()ed block of any type, as the allocator rounded it
+size_t HeapSize(void* arg);
+// arg: char*, its length with the terminating '\0'
+size_t StringSize(void* arg);
+// arg: `struct row`
+size_t RowSize(void* arg);
+
+// called by execute() once the partitions of "rdd" are allocated
+void mem_stage_start(RDD* rdd);
+// adds "bytes" to partition "pnum" of "rdd"
+void mem_charge(RDD* rdd, int pnum, long bytes);
+// bytes of the nodes of "output" and of the elements "rdd" created in it
+long mem_list_bytes(RDD* rdd, List* output);
+// "rdd" dropped its partitions (rdd_reset())
+void mem_release(RDD* rdd);
+// prints the largest RDDs to stderr, if accounting is on
+void mem_report();
+
+#endif // __footprint_h__
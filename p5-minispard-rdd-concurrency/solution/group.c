@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "group.h"
+#include "sketch.h"
+
+#define KEYTABLE_MIN_BITS (4)
+
+struct group_ctx {
+  KeyFn key;
+  void* ctx;
+};
+
+// The distinct keys of a partition. Slots hold a group index + 1, 0 when
+// empty; the group's key and hash are kept per group.
+typedef struct {
+  int* slots;
+  int bits; // 1 << bits slots, at least twice the elements
+  int ngroups;
+  uint64_t* hashes; // per group
+  const char** keys;
+  size_t* keylens;
+  int* counts[2];
+} KeyTable;
+
+static int keytable_init(KeyTable* kt, int nelems) {
+  kt->bits = KEYTABLE_MIN_BITS;
+  while ((1L << kt->bits) < 2L * nelems) {
+    kt->bits++;
+  }
+  kt->ngroups = 0;
+  kt->slots = calloc(1L << kt->bits, sizeof(int));
+  kt->hashes = malloc((nelems + 1) * sizeof(uint64_t));
+  kt->keys = malloc((nelems + 1) * sizeof(char*));
+  kt->keylens = malloc((nelems + 1) * sizeof(size_t));
+  kt->counts[0] = calloc(nelems + 1, sizeof(int));
+  kt->counts[1] = calloc(nelems + 1, sizeof(int));
+  return kt->slots == NULL || kt->hashes == NULL || kt->keys == NULL || kt->keylens == NULL || kt->counts[0] == NULL
+    || kt->counts[1] == NULL ? -1 : 0;
+}
+
+static void keytable_free(KeyTable* kt) {
+  free(kt->slots);
+  free(kt->hashes);
+  free(kt->keys);
+  free(kt->keylens);
+  free(kt->counts[0]);
+  free(kt->counts[1]);
+}
+
+// group of "key", added if it is new. The slot comes from the high bits
+// of the hash: its low bits picked the partition.
+static int keytable_group(KeyTable* kt, const char* key, size_t len) {
+  uint64_t h = sketch_hash(key, len);
+  size_t mask = (1UL << kt->bits) - 1;
+  size_t i = (h * 0x9e3779b97f4a7c15ULL) >> (64 - kt->bits);
+  while (kt->slots[i] != 0) {
+    int g = kt->slots[i] - 1;
+    if (kt->hashes[g] == h && kt->keylens[g] == len && memcmp(kt->keys[g], key, len) == 0) {
+      return g;
+    }
+    i = (i + 1) & mask;
+  }
+  int g = kt->ngroups++;
+  kt->slots[i] = g + 1;
+  kt->hashes[g] = h;
+  kt->keys[g] = key;
+  kt->keylens[g] = len;
+  return g;
+}
+
+// groups the "ninputs" (1 or 2) List partitions of "inputs" into
+// "output". returns 0 on success
+static int group_partitions(List* inputs[], int ninputs, List* output, struct group_ctx* gctx) {
+  int nelems = 0;
+  for (int i = 0; i < ninputs; i++) {
+    nelems += list_get_size(inputs[i]);
+  }
+  int ret = -1;
+  Group** groups = NULL;
+  int* gids = malloc((nelems + 1) * sizeof(int)); // group of each element, inputs one after the other
+  KeyTable kt;
+  if (keytable_init(&kt, nelems) != 0 || gids == NULL) {
+    goto cleanup;
+  }
+
+  // first pass: the group of every element, and the size of every group
+  int e = 0;
+  for (int i = 0; i < ninputs; i++) {
+    for (ListNode* node = inputs[i]->head; node != NULL; node = node->next, e++) {
+      size_t len;
+      const char* key = gctx->key(node->data, &len, gctx->ctx);
+      gids[e] = keytable_group(&kt, key, len);
+      kt.counts[i][gids[e]]++;
+    }
+  }
+
+  // second pass: every value straight into its place
+  groups = calloc(kt.ngroups + 1, sizeof(Group*));
+  if (groups == NULL) {
+    goto cleanup;
+  }
+  for (int g = 0; g < kt.ngroups; g++) {
+    int total = kt.counts[0][g] + kt.counts[1][g];
+    groups[g] = malloc(sizeof(Group) + total * sizeof(void*));
+    if (groups[g] == NULL) {
+      goto cleanup;
+    }
+    groups[g]->key = kt.keys[g];
+    groups[g]->keylen = kt.keylens[g];
+    groups[g]->values[0] = groups[g]->data;
+    groups[g]->values[1] = groups[g]->data + kt.counts[0][g];
+    groups[g]->count[0] = 0;
+    groups[g]->count[1] = 0;
+  }
+  e = 0;
+  for (int i = 0; i < ninputs; i++) {
+    for (ListNode* node = inputs[i]->head; node != NULL; node = node->next, e++) {
+      Group* group = groups[gids[e]];
+      group->values[i][group->count[i]++] = node->data;
+    }
+  }
+  for (int g = 0; g < kt.ngroups; g++) {
+    if (list_add_elem(output, groups[g]) != 0) {
+      goto cleanup;
+    }
+    groups[g] = NULL; // the output owns it
+  }
+  ret = 0;
+
+cleanup:
+  for (int g = 0; groups != NULL && g < kt.ngroups; g++) {
+    free(groups[g]);
+  }
+  free(groups);
+  free(gids);
+  keytable_free(&kt);
+  return ret;
+}
+
+static int GroupPartition(void* input, List* output, void* ctx) {
+  List* inputs[] = {(List*)input};
+  return group_partitions(inputs, 1, output, (struct group_ctx*)ctx);
+}
+
+static int CoGroupPartitions(void* input1, void* input2, List* output, void* ctx) {
+  List* inputs[] = {(List*)input1, (List*)input2};
+  return group_partitions(inputs, 2, output, (struct group_ctx*)ctx);
+}
+
+static unsigned long KeyPartitioner(void* arg, int numpartitions, void* ctx) {
+  struct group_ctx* gctx = (struct group_ctx*)ctx;
+  size_t len;
+  const char* key = gctx->key(arg, &len, gctx->ctx);
+  return sketch_hash(key, len) % numpartitions;
+}
+
+static struct group_ctx* group_ctx_create(RDD* rdd, KeyFn key, void* ctx, int numpartitions) {
+  if (is_file_source(rdd)) {
+    printf("error, RDD %p holds files, not elements\n", rdd);
+    return NULL;
+  }
+  if (numpartitions <= 0) {
+    printf("error, grouping needs a positive number of partitions, not %i\n", numpartitions);
+    return NULL;
+  }
+  struct group_ctx* gctx = malloc(sizeof(struct group_ctx));
+  if (gctx == NULL) {
+    printf("error allocating grouping of RDD %p\n", rdd);
+    exit(1);
+  }
+  gctx->key = key;
+  gctx->ctx = ctx;
+  return gctx;
+}
+
+RDD* groupByKey(RDD* rdd, KeyFn key, void* ctx, int numpartitions) {
+  struct group_ctx* gctx = group_ctx_create(rdd, key, ctx, numpartitions);
+  if (gctx == NULL) {
+    return NULL;
+  }
+  return mapPartitions(partitionBy(rdd, KeyPartitioner, numpartitions, gctx), GroupPartition, gctx);
+}
+
+RDD* cogroup(RDD* rdd1, RDD* rdd2, KeyFn key, void* ctx, int numpartitions) {
+  struct group_ctx* gctx = group_ctx_create(rdd1, key, ctx, numpartitions);
+  if (gctx == NULL || is_file_source(rdd2)) {
+    printf("error, cannot cogroup RDDs %p and %p\n", rdd1, rdd2);
+    free(gctx);
+    return NULL;
+  }
+  // both sides go through the same Partitioner and ctx, so matching keys
+  // meet in partitions with the same index
+  return zipPartitions(partitionBy(rdd1, KeyPartitioner, numpartitions, gctx),
+                       partitionBy(rdd2, KeyPartitioner, numpartitions, gctx), CoGroupPartitions, gctx);
+}
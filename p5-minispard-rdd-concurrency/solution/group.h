@@ -0,0 +1,31 @@
+// groupByKey and cogroup: the values of every key in one array
+#ifndef __group_h__
+#define __group_h__
+
+#include <stddef.h>
+#include "minispark.h"
+
+// The values of one key, in input order, in a single allocation (free()
+// the Group, not the values). The values themselves are the input
+// elements, not copies.
+typedef struct {
+  const char* key; // as returned by the KeyFn for the first value
+  size_t keylen;
+  int count[2]; // values from each input; groupByKey only has count[0]
+  void** values[2]; // values[i] holds the count[i] values of input i
+  void* data[]; // values[0] and values[1], one after the other
+} Group;
+
+// Create an RDD of Groups, one per distinct key of "rdd", in
+// "numpartitions" partitions. The elements are hash-partitioned by key,
+// then every output partition is grouped with a hash table: a first
+// pass counts the values of each key, a second copies them into the
+// Groups, sized exactly. "ctx" is passed to "key".
+RDD* groupByKey(RDD* rdd, KeyFn key, void* ctx, int numpartitions);
+
+// Like groupByKey() over two RDDs keyed the same way: one Group per key
+// found in either, with the values of "rdd1" in values[0] and those of
+// "rdd2" in values[1] (either may be empty).
+RDD* cogroup(RDD* rdd1, RDD* rdd2, KeyFn key, void* ctx, int numpartitions);
+
+#endif // __group_h__
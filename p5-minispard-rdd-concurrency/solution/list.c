@@ -110,6 +110,20 @@ void list_free(List* l) {
     free(l);
 }
 
+// move all nodes of "src" to the end of "dst" and free "src"
+void list_concat(List* dst, List* src) {
+    if (src->head != NULL) {
+        if (dst->head == NULL || dst->size == 0) {
+            dst->head = src->head;
+        } else {
+            dst->tail->next = src->head;
+        }
+        dst->tail = src->tail;
+        dst->size += src->size;
+    }
+    free(src);
+}
+
 ListIterator* list_iterator_begin(List* l) {
     if (l == NULL) {
         return NULL;
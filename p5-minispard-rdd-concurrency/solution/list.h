@@ -26,6 +26,7 @@ void* list_remove_elem(List *l);
 void* list_get(List *l, int idx);
 int list_get_size(List* l);
 void list_free(List* l);
+void list_concat(List* dst, List* src); // moves src's nodes to the end of dst, frees src
 ListIterator* list_iterator_begin(List* l);
 int list_iterator_has_next(ListIterator* iter); // returns 1 to show that there is next
 void* list_iterator_next(ListIterator* iter); // returns pointer of curr head, advances iterator
@@ -7,13 +7,37 @@
 #include <sched.h>
 #include <time.h>
 #include <string.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "footprint.h"
 #include "keyvalue.h"
+#include "profile.h"
+#include "optimizer.h"
+#include "prefetch.h"
+#include "scheduler.h"
+#include "shuffle.h"
+#include "simulator.h"
+#include "sorted.h"
 
 
 ThreadPool* global_thread_pool = NULL;
 MetricQueue* global_metrics_queue = NULL;
 pthread_t monitor_thread;
 volatile int global_shutdown_requested = 0;
+static __thread int current_worker = -1; // id of the calling worker thread, -1 outside the pool
+static __thread int task_failed = 0; // set by MS_FailTask() in user code
+// what the running attempt allocated around user code, freed by
+// run_task_sandboxed() if that code crashes before the helper frees it
+static __thread struct {
+  FILE* fp; // map_helper() input stream and its buffer
+  char* buf;
+  List** targets; // partition_helper() lists, shuffle blocks in [0, encoded)
+  int ntargets;
+  int encoded;
+  List* decoded; // shuffle_fetch_helper() output
+} scratch;
 
 
 // Working with metrics...
@@ -22,14 +46,21 @@ volatile int global_shutdown_requested = 0;
 // Getting the elapsed time in microseconds between two timespecs:
 //    duration = TIME_DIFF_MICROS(metric->created, metric->scheduled);
 // Use `print_formatted_metric(...)` to write a metric to the logfile. 
-void print_formatted_metric(TaskMetric* metric, FILE* fp) {
-  fprintf(fp, "RDD %p Part %d Trans %d -- creation %10jd.%06ld, scheduled %10jd.%06ld, execution (usec) %ld\n",
+// The monitor formats whole batches with format_metric() instead.
+static int format_metric(TaskMetric* metric, char* buf, size_t len) {
+  return snprintf(buf, len, "RDD %p Part %d Trans %d -- creation %10jd.%06ld, scheduled %10jd.%06ld, execution (usec) %ld\n",
 	  metric->rdd, metric->pnum, metric->rdd->trans,
 	  metric->created.tv_sec, metric->created.tv_nsec / 1000,
 	  metric->scheduled.tv_sec, metric->scheduled.tv_nsec / 1000,
 	  metric->duration);
 }
 
+void print_formatted_metric(TaskMetric* metric, FILE* fp) {
+  char line[256];
+  format_metric(metric, line, sizeof(line));
+  fputs(line, fp);
+}
+
 int max(int a, int b)
 {
   return a > b ? a : b;
@@ -47,21 +78,33 @@ RDD *create_rdd(int numdeps, Transform t, void *fn, ...)
   va_list args;
   va_start(args, fn);
 
-  int maxpartitions = 0;
+  // dependencies are usually not materialized yet, so only record them here
   for (int i = 0; i < numdeps; i++)
   {
-    RDD *dep = va_arg(args, RDD *);
-    rdd->dependencies[i] = dep;
-    maxpartitions = max(maxpartitions, dep->partitions->size);
+    rdd->dependencies[i] = va_arg(args, RDD *);
   }
   va_end(args);
 
   rdd->numdependencies = numdeps;
   rdd->trans = t;
   rdd->fn = fn;
+  rdd->ctx = NULL;
+  rdd->cmp = NULL;
   rdd->partitions = NULL;
+  rdd->numpartitions = 0; // set in execute() unless the transform fixes it
+  rdd->partition_locks = NULL;
   rdd->complete = 0;
   rdd->completed_partitions = 0;
+  rdd->failed = 0;
+  rdd->encode = NULL;
+  rdd->decode = NULL;
+  rdd->codec = NULL;
+  rdd->blocks = NULL;
+  rdd->shuffle_pending = 0;
+  rdd->join_key = NULL;
+  rdd->join_key_ctx = NULL;
+  rdd->bloom = NULL;
+  rdd->mem = NULL;
   if (pthread_mutex_init(&rdd->rdd_lock, NULL) != 0) {
     exit(1);
   }
@@ -71,6 +114,14 @@ RDD *create_rdd(int numdeps, Transform t, void *fn, ...)
   return rdd;
 }
 
+RDD *create_source_rdd(Transform t, void *fn, List *partitions, int numpartitions)
+{
+  RDD *rdd = create_rdd(0, t, fn);
+  rdd->partitions = partitions;
+  rdd->numpartitions = numpartitions;
+  return rdd;
+}
+
 /* RDD constructors */
 RDD *map(RDD *dep, Mapper fn)
 {
@@ -99,6 +150,69 @@ RDD *join(RDD *dep1, RDD *dep2, Joiner fn, void *ctx)
   return rdd;
 }
 
+RDD *sortMergeJoin(RDD *dep1, RDD *dep2, Comparator cmp, Joiner fn, void *ctx)
+{
+  RDD *rdd = create_rdd(2, SORT_MERGE_JOIN, fn, dep1, dep2);
+  rdd->cmp = cmp;
+  rdd->ctx = ctx;
+  return rdd;
+}
+
+RDD *zipPartitions(RDD *dep1, RDD *dep2, PartitionZipper fn, void *ctx)
+{
+  RDD *rdd = create_rdd(2, ZIP_PARTITIONS, fn, dep1, dep2);
+  rdd->ctx = ctx;
+  return rdd;
+}
+
+RDD *unionAll(RDD *dep1, RDD *dep2)
+{
+  return create_rdd(2, UNION, NULL, dep1, dep2);
+}
+
+RDD *mapPartitions(RDD *dep, PartitionMapper fn, void *ctx)
+{
+  RDD *rdd = create_rdd(1, MAP_PARTITIONS, fn, dep);
+  rdd->ctx = ctx;
+  return rdd;
+}
+
+// RDDFromFiles() partitions are FILE*s that the mapper reads from;
+// FILE_BACKED sources (streams) already hold Lists of elements
+int is_file_source(RDD *rdd)
+{
+  return rdd->numdependencies == 0 && rdd->trans != FILE_BACKED;
+}
+
+// drop the materialized partitions of "rdd" and everything it depends on,
+// down to (but not including) the sources, so it can be executed again
+void rdd_reset(RDD *rdd)
+{
+  if (rdd == NULL || rdd->numdependencies == 0) {
+    return;
+  }
+  for (int i = 0; i < rdd->numdependencies; i++) {
+    rdd_reset(rdd->dependencies[i]);
+  }
+  pthread_mutex_lock(&rdd->rdd_lock);
+  if (rdd->partitions != NULL) {
+    while (list_get_size(rdd->partitions) > 0) {
+      List* inner_list = (List*)list_remove_elem(rdd->partitions);
+      // a union's partitions belong to its inputs
+      if (inner_list != NULL && rdd->trans != UNION) {
+        list_free(inner_list);
+      }
+    }
+    list_free(rdd->partitions);
+    rdd->partitions = NULL;
+  }
+  mem_release(rdd);
+  rdd->complete = 0;
+  rdd->completed_partitions = 0;
+  rdd->failed = 0;
+  pthread_mutex_unlock(&rdd->rdd_lock);
+}
+
 /* A special mapper */
 void *identity(void *arg)
 {
@@ -114,12 +228,11 @@ RDD *RDDFromFiles(char **filenames, int numfiles)
     MS_Run();
   }
 
-  RDD *rdd = malloc(sizeof(RDD));
-  if (!rdd) {
-    free(rdd);
+  List* partitions = list_init();
+  if (partitions == NULL) {
+    printf("error creating partitions for file source rdd\n");
     exit(1);
   }
-  rdd->partitions = list_init();
 
   for (int i = 0; i < numfiles; i++)
   {
@@ -129,35 +242,26 @@ RDD *RDDFromFiles(char **filenames, int numfiles)
       perror("fopen");
       exit(1);
     }
-    list_add_elem(rdd->partitions, fp);
+    list_add_elem(partitions, fp);
   }
 
-  rdd->numdependencies = 0;
-  rdd->trans = MAP;
-  rdd->fn = (void *)identity;
-  rdd->numpartitions = numfiles;
-  rdd->complete = 0;
-  rdd->completed_partitions = 0;
-  if (pthread_mutex_init(&rdd->rdd_lock, NULL) != 0) {
-    return NULL;
-  }
-  if (pthread_cond_init(&rdd->completed_cv, NULL) != 0) {
-    return NULL;
-  }
-  return rdd;
+  return create_source_rdd(MAP, (void *)identity, partitions, numfiles);
 }
 
 //////// Worker Queue methods ///////////////
 
-WorkQueue* work_queue_init() {
+WorkQueue* work_queue_init(struct SchedPolicy* policy, int nworkers) {
   WorkQueue* wq = (WorkQueue*) malloc(sizeof(WorkQueue));
   if (wq == NULL) {
     return NULL;
   }
-  wq->tasks = list_init();
-  if (wq->tasks == NULL) {
+  wq->policy = policy;
+  wq->sched = policy->create(nworkers);
+  if (wq->sched == NULL) {
     return NULL;
   }
+  wq->pending = 0;
+  wq->parked = 0;
   if (pthread_mutex_init(&wq->lock, NULL) != 0) {
     return NULL;
   }
@@ -170,26 +274,56 @@ WorkQueue* work_queue_init() {
 
 int work_queue_enqueue(WorkQueue* wq, Task* task) {
   pthread_mutex_lock(&wq->lock);
-  if (list_add_elem(wq->tasks, task) != 0) {
-    return -1;
+  wq->policy->push(wq->sched, task, current_worker);
+  __atomic_store_n(&wq->pending, wq->pending + 1, __ATOMIC_RELEASE);
+  // signal one waiting worker thread to handle this task; spinning
+  // workers see "pending" change by themselves
+  if (wq->parked > 0) {
+    pthread_cond_signal(&wq->available);
   }
-  // signal one waiting worker thread to handle this task
-  pthread_cond_signal(&wq->available);
   pthread_mutex_unlock(&wq->lock); 
   return 0;
 }
 
-Task* work_queue_dequeue(WorkQueue* wq) {
+// queues the "n" tasks chained from "first" under one lock and wakes
+// as many parked workers as there are new tasks, at most
+int work_queue_enqueue_batch(WorkQueue* wq, Task* first, int n) {
+  pthread_mutex_lock(&wq->lock);
+  for (Task *task = first, *next; task != NULL; task = next) {
+    next = task->next; // push() relinks the task
+    wq->policy->push(wq->sched, task, current_worker);
+  }
+  __atomic_store_n(&wq->pending, wq->pending + n, __ATOMIC_RELEASE);
+  if (n >= wq->parked) {
+    if (wq->parked > 0) {
+      pthread_cond_broadcast(&wq->available);
+    }
+  } else {
+    for (int i = 0; i < n; i++) {
+      pthread_cond_signal(&wq->available);
+    }
+  }
+  pthread_mutex_unlock(&wq->lock);
+  return 0;
+}
+
+// next task for "worker", called with wq->lock held and pending > 0
+static Task* work_queue_take(WorkQueue* wq, int worker) {
+  Task* task = wq->policy->pop(wq->sched, worker);
+  if (task != NULL) {
+    __atomic_store_n(&wq->pending, wq->pending - 1, __ATOMIC_RELAXED);
+  }
+  return task;
+}
+
+Task* work_queue_dequeue(WorkQueue* wq, int worker) {
   pthread_mutex_lock(&wq->lock);
   // checking task for now
   // add shut down logic
-  while(list_get_size(wq->tasks) == 0) {
+  while(wq->pending == 0) {
     pthread_cond_wait(&wq->available, &wq->lock);
   }
-  Task* task = NULL;
-  if (list_get_size(wq->tasks) > 0) {
-    task = list_remove_elem(wq->tasks);
-  }
+  Task* task = work_queue_take(wq, worker);
   pthread_mutex_unlock(&wq->lock);
   return task;
 };
@@ -199,7 +333,7 @@ Task* work_queue_dequeue(WorkQueue* wq) {
 void work_queue_destroy(WorkQueue* wq) {
   pthread_mutex_destroy(&wq->lock);
   pthread_cond_destroy(&wq->available);
-  list_free(wq->tasks);
+  wq->policy->destroy(wq->sched);
   free(wq);
 }
 
@@ -211,10 +345,16 @@ MetricQueue* metric_queue_init() {
   if (mq == NULL) {
     return NULL;
   }
-  mq->metrics = list_init();
-  if (mq->metrics == NULL) {
+  mq->slots = malloc(METRIC_RING_SIZE * sizeof(MetricSlot));
+  if (mq->slots == NULL) {
     return NULL;
   }
+  for (unsigned long i = 0; i < METRIC_RING_SIZE; i++) {
+    mq->slots[i].seq = i;
+  }
+  mq->tail = 0;
+  mq->head = 0;
+  mq->sleeping = 0;
   if (pthread_mutex_init(&mq->lock, NULL) != 0) {
     return NULL;
   }
@@ -226,43 +366,375 @@ MetricQueue* metric_queue_init() {
 }
 
 int metric_queue_enqueue(MetricQueue* mq, TaskMetric* metric) {
-  pthread_mutex_lock(&mq->lock);
-  if (list_add_elem(mq->metrics, metric) != 0) {
-    return -1;
+  unsigned long pos = __atomic_fetch_add(&mq->tail, 1, __ATOMIC_RELAXED);
+  MetricSlot* slot = &mq->slots[pos & (METRIC_RING_SIZE - 1)];
+  // the slot is still in use by the previous round: the monitor is behind
+  while (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos) {
+    sched_yield();
+  }
+  slot->metric = *metric;
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+  // pairs with the sleeping flag set in monitor_function(): either the
+  // monitor sees this metric before it waits, or we see it sleeping
+  if (__atomic_load_n(&mq->sleeping, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&mq->lock);
+    pthread_cond_signal(&mq->available);
+    pthread_mutex_unlock(&mq->lock);
   }
-  pthread_cond_signal(&mq->available);
-  pthread_mutex_unlock(&mq->lock);
   return 0;
 }
 
-TaskMetric* metric_queue_dequeue(MetricQueue* mq) {
-  pthread_mutex_lock(&mq->lock);
-  while(list_get_size(mq->metrics) == 0) {
-    pthread_cond_wait(&mq->available, &mq->lock);
+int metric_queue_dequeue(MetricQueue* mq, TaskMetric* metric) {
+  MetricSlot* slot = &mq->slots[mq->head & (METRIC_RING_SIZE - 1)];
+  if (__atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) != mq->head + 1) {
+    return 0;
   }
-  TaskMetric* metric = NULL;
-  if (list_get_size(mq->metrics) > 0) {
-    metric = list_remove_elem(mq->metrics);
-  }
-  pthread_mutex_unlock(&mq->lock);
-  return metric;
+  *metric = slot->metric;
+  __atomic_store_n(&slot->seq, mq->head + METRIC_RING_SIZE, __ATOMIC_RELEASE);
+  mq->head++;
+  return 1;
 }
 
 void metric_queue_destroy(MetricQueue* mq) {
   pthread_mutex_destroy(&mq->lock);
   pthread_cond_destroy(&mq->available);
-  list_free(mq->metrics);
+  free(mq->slots);
   free(mq);
 }
 
+//////// Morsels ///////////////
+
+int morsel_elems = DEFAULT_MORSEL_ELEMS;
+long morsel_bytes = 0;
+
+void MS_SetMorselSize(int elements, long bytes) {
+  morsel_elems = elements < 0 ? 0 : elements;
+  morsel_bytes = bytes < 0 ? 0 : bytes;
+}
+
+//////// Task Pool ///////////////////
+
+// A task and its metric are allocated together and recycled. Workers
+// push finished tasks onto "returned_tasks" with one CAS; allocation
+// takes that whole stack at once when its own free list runs dry, so a
+// pop never races with a push.
+typedef struct {
+  Task task;
+  TaskMetric metric;
+} TaskSlot;
+
+static Task* returned_tasks = NULL;
+static pthread_mutex_t task_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static Task* free_tasks = NULL; // under task_pool_lock
+static TaskPoolStats task_pool_stats; // under task_pool_lock
+
+static Task* task_alloc() {
+  pthread_mutex_lock(&task_pool_lock);
+  if (free_tasks == NULL) {
+    free_tasks = __atomic_exchange_n(&returned_tasks, NULL, __ATOMIC_ACQUIRE);
+  }
+  Task* task = free_tasks;
+  if (task != NULL) {
+    free_tasks = task->next;
+    task_pool_stats.recycled++;
+  } else {
+    task_pool_stats.allocated++;
+  }
+  pthread_mutex_unlock(&task_pool_lock);
+  if (task == NULL) {
+    TaskSlot* slot = malloc(sizeof(TaskSlot));
+    if (slot == NULL) {
+      return NULL;
+    }
+    task = &slot->task;
+  }
+  task->metric = &((TaskSlot*)task)->metric;
+  return task;
+}
+
+void task_free(Task* task) {
+  if (task == NULL) {
+    return;
+  }
+  Task* head = __atomic_load_n(&returned_tasks, __ATOMIC_RELAXED);
+  do {
+    task->next = head;
+  } while (!__atomic_compare_exchange_n(&returned_tasks, &head, task, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// frees the recycled tasks, once no task is in flight
+static void task_pool_clear() {
+  pthread_mutex_lock(&task_pool_lock);
+  Task* task = free_tasks;
+  free_tasks = NULL;
+  while (task != NULL || (task = __atomic_exchange_n(&returned_tasks, NULL, __ATOMIC_ACQUIRE)) != NULL) {
+    Task* next = task->next;
+    free((TaskSlot*)task);
+    task = next;
+  }
+  pthread_mutex_unlock(&task_pool_lock);
+}
+
+TaskPoolStats MS_GetTaskPoolStats() {
+  pthread_mutex_lock(&task_pool_lock);
+  TaskPoolStats stats = task_pool_stats;
+  pthread_mutex_unlock(&task_pool_lock);
+  return stats;
+}
+
+// a task covering the whole partition "pnum" of "rdd"
+Task* create_task(RDD* rdd, int pnum) {
+  Task *task = task_alloc();
+  if (!task) {
+    printf("task malloc error");
+    return NULL;
+  }
+  task->rdd = rdd;
+  task->pnum = pnum;
+  task->pool = current_pool();
+  task->next = NULL;
+  task->fetch = 0;
+  task->group = NULL;
+  task->morsel = -1;
+  task->first = NULL;
+  task->start = 0;
+  task->end = -1;
+  task->input = NULL;
+  task->input_begin = 0;
+  task->input_end = 0;
+  task->home = -1;
+  clock_gettime(CLOCK_MONOTONIC, &task->metric->created);
+  task->metric->pnum = pnum;
+  task->metric->rdd = rdd;
+  return task;
+}
+
+static MorselGroup* morsel_group_init(int nmorsels) {
+  MorselGroup* group = malloc(sizeof(MorselGroup));
+  if (group == NULL) {
+    return NULL;
+  }
+  group->outputs = malloc(nmorsels * sizeof(List*));
+  if (group->outputs == NULL) {
+    free(group);
+    return NULL;
+  }
+  for (int i = 0; i < nmorsels; i++) {
+    group->outputs[i] = list_init();
+  }
+  group->nmorsels = nmorsels;
+  group->remaining = nmorsels;
+  return group;
+}
+
+// size of the file behind a source partition, or -1
+static long source_size(FILE* fp) {
+  struct stat st;
+  if (fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode)) {
+    return -1;
+  }
+  return st.st_size;
+}
+
+// tasks linked through Task::next, in the order they were added
+typedef struct {
+  Task* head;
+  Task* tail;
+  int size;
+} TaskChain;
+
+static void chain_add(TaskChain* chain, Task* task) {
+  task->next = NULL;
+  if (chain->tail == NULL) {
+    chain->head = task;
+  } else {
+    chain->tail->next = task;
+  }
+  chain->tail = task;
+  chain->size++;
+}
+
+// frees a morsel group whose tasks never ran
+static void morsel_group_free(MorselGroup* group) {
+  if (group == NULL) {
+    return;
+  }
+  for (int i = 0; i < group->nmorsels; i++) {
+    if (group->outputs[i] != NULL) {
+      list_free(group->outputs[i]);
+    }
+  }
+  free(group->outputs);
+  free(group);
+}
+
+// frees the tasks chained after "last" (all of them if NULL), which were
+// never submitted, with their morsel groups; "size" tasks are left
+static void chain_discard(TaskChain* chain, Task* last, int size) {
+  for (Task *task = last == NULL ? chain->head : last->next, *next; task != NULL; task = next) {
+    next = task->next;
+    if (task->morsel == 0) {
+      morsel_group_free(task->group);
+    }
+    task_free(task);
+  }
+  if (last == NULL) {
+    chain->head = NULL;
+  } else {
+    last->next = NULL;
+  }
+  chain->tail = last;
+  chain->size = size;
+}
+
+// Append the tasks computing partition "pnum" of "rdd" to "tasks".
+// Large partitions are split into morsels any worker can pick up:
+// ranges of morsel_elems elements of a List partition, or ranges of
+// morsel_bytes bytes of a file partition (whole lines each). Map and
+// filter morsels write to their own list and the last one to finish
+// appends them to the partition in order; partitionBy morsels publish
+// to the target partitions directly.
+// returns the number of tasks added, 0 on failure (adding none)
+static int add_partition_tasks(RDD* rdd, int pnum, void* input, TaskChain* tasks) {
+  RDD* prev_rdd = rdd->dependencies[0];
+  long size = 0;
+  long step = 0;
+  if (rdd->trans == MAP && is_file_source(prev_rdd)) {
+    if (morsel_bytes > 0) {
+      size = source_size((FILE*)input);
+      step = morsel_bytes;
+    }
+  } else if (rdd->trans == MAP || rdd->trans == FILTER || rdd->trans == PARTITIONBY) {
+    if (morsel_elems > 0) {
+      size = list_get_size((List*)input);
+      step = morsel_elems;
+    }
+  }
+
+  if (step == 0 || size <= step) {
+    Task* task = create_task(rdd, pnum);
+    if (task == NULL) {
+      return 0;
+    }
+    chain_add(tasks, task);
+    return 1;
+  }
+
+  int nmorsels = (size + step - 1) / step;
+  MorselGroup* group = NULL;
+  if (rdd->trans != PARTITIONBY && (group = morsel_group_init(nmorsels)) == NULL) {
+    printf("error creating morsels for RDD %p partition %i\n", rdd, pnum);
+    return 0;
+  }
+  ListNode* node = is_file_source(prev_rdd) ? NULL : ((List*)input)->head;
+  Task* last = tasks->tail;
+  int size_before = tasks->size;
+  for (int m = 0; m < nmorsels; m++) {
+    Task* task = create_task(rdd, pnum);
+    if (task == NULL) {
+      // every morsel has to run before the merge, so none of them can
+      printf("error creating morsel %i for RDD %p partition %i\n", m, rdd, pnum);
+      if (m == 0) {
+        morsel_group_free(group);
+      }
+      chain_discard(tasks, last, size_before);
+      return 0;
+    }
+    task->group = group;
+    task->morsel = m;
+    task->start = m * step;
+    task->end = task->start + step < size ? task->start + step : size;
+    task->first = node;
+    for (long i = task->start; node != NULL && i < task->end; i++) {
+      node = node->next;
+    }
+    chain_add(tasks, task);
+  }
+  return nmorsels;
+}
+
+// called once a morsel task is done; the last morsel of its partition
+// moves all morsel outputs into the partition, in morsel order
+static void morsel_done(Task* task) {
+  MorselGroup* group = task->group;
+  if (group == NULL || __atomic_sub_fetch(&group->remaining, 1, __ATOMIC_ACQ_REL) != 0) {
+    return;
+  }
+  pthread_mutex_lock(&task->rdd->rdd_lock);
+  List* output_partition = (List*)list_get(task->rdd->partitions, task->pnum);
+  pthread_mutex_unlock(&task->rdd->rdd_lock);
+  for (int i = 0; i < group->nmorsels; i++) {
+    if (output_partition != NULL) {
+      list_concat(output_partition, group->outputs[i]);
+    } else {
+      list_free(group->outputs[i]);
+    }
+  }
+  free(group->outputs);
+  free(group);
+}
+
+// first element of the task's range of a List input; "*n" is set to the
+// number of elements in the range, or -1 for the whole partition
+static ListNode* task_input(Task* task, List* input, long* n) {
+  if (task->morsel < 0) {
+    *n = -1;
+    return input->head;
+  }
+  *n = task->end - task->start;
+  return task->first;
+}
+
+// the list a map or filter task appends its results to
+static List* task_output(Task* task) {
+  if (task->group != NULL) {
+    return task->group->outputs[task->morsel];
+  }
+  return (List*)list_get(task->rdd->partitions, task->pnum);
+}
+
+// The FILE* a map over a file source reads, in "*in": a memory stream
+// over the lines read ahead by the I/O threads or over the task's byte
+// morsel, or else the partition's FILE* "fp" itself. "*stream" and
+// "*buf" are set to what the caller closes and frees. "*in" is NULL if
+// no line starts in the morsel. Returns 0 on success.
+static int open_source_input(Task* task, FILE* fp, FILE** in, FILE** stream, char** buf) {
+  *in = fp;
+  *stream = NULL;
+  *buf = NULL;
+  char* data = task->input;
+  long begin = task->input_begin;
+  long stop = task->input_end;
+  if (data == NULL) {
+    if (task->morsel < 0) {
+      return 0;
+    }
+    if (read_line_range(fileno(fp), task->start, task->end, buf, &begin, &stop) != 0) {
+      return -1;
+    }
+    data = *buf;
+  }
+  if (begin >= stop) {
+    *in = NULL;
+    return 0;
+  }
+  *in = *stream = fmemopen(data + begin, stop - begin, "r");
+  return *stream == NULL ? -1 : 0;
+}
+
 //////// Helper Functions //////////////////
-void map_helper(Task* task){
+int map_helper(Task* task) {
+  int ret = -1;
   RDD *rdd = task->rdd;
+  ProfileScope ps; // flushed in cleanup, so failed attempts count too
+  profile_begin(&ps, rdd->fn);
   int pnum = task->pnum;
   Mapper mapper = (Mapper)rdd->fn;
   RDD *prev_rdd = rdd->dependencies[0];
+  char* morsel_buf = NULL;
+  FILE* morsel_fp = NULL;
 
-  List* output_partition = (List*)list_get(rdd->partitions, pnum);
+  List* output_partition = task_output(task);
   if (output_partition == NULL) {
     printf("error, output partition %i for RDD %p is null(map output).\n", pnum, rdd);
     goto cleanup;
@@ -277,11 +749,24 @@ void map_helper(Task* task){
   struct timespec start;
   clock_gettime(CLOCK_MONOTONIC, &start);
 
-  if (prev_rdd->numdependencies == 0) { // source RDD
-    FILE* fp = (FILE*)input_data;
+  if (is_file_source(prev_rdd)) { // source RDD
+    FILE* fp = NULL;
+    if (open_source_input(task, (FILE*)input_data, &fp, &morsel_fp, &morsel_buf) != 0) {
+      printf("error reading bytes %li-%li of RDD %p partition %i\n", task->start, task->end, prev_rdd, pnum);
+      goto cleanup;
+    }
+    scratch.fp = morsel_fp;
+    scratch.buf = morsel_buf;
     void* item = NULL;
     // call mapper with FILE*
-    while ((item = mapper(fp)) != NULL) {
+    while (fp != NULL) {
+      profile_before(&ps);
+      item = mapper(fp);
+      if (item == NULL) {
+        profile_discard(&ps); // end of input, not a call that produced nothing
+        break;
+      }
+      profile_after(&ps, 1);
       if (list_add_elem(output_partition, item) != 0) {
         printf("error adding element to output partition %i RDD %p", pnum, rdd);
         free(item);
@@ -290,36 +775,42 @@ void map_helper(Task* task){
     }
   } else {
     // input is a list of items from previous transformation
-    List* input_partition = (List*)input_data;
-    ListIterator* iter = list_iterator_begin(input_partition);
-    if (iter != NULL) {
-      while(list_iterator_has_next(iter)){
-        void* element = list_iterator_next(iter);
-        void* result = mapper(element);
-        if (result != NULL) {
-          if (list_add_elem(output_partition, result) != 0) {
-            printf("error adding mapped element to output partition %i RDD %p\n", pnum, rdd);
-            goto cleanup;
-          }
+    long n;
+    for (ListNode* node = task_input(task, (List*)input_data, &n); node != NULL && n != 0; node = node->next, n--) {
+      profile_before(&ps);
+      void* result = mapper(node->data);
+      profile_after(&ps, result != NULL);
+      if (result != NULL) {
+        if (list_add_elem(output_partition, result) != 0) {
+          printf("error adding mapped element to output partition %i RDD %p\n", pnum, rdd);
+          goto cleanup;
         }
       }
-      list_iterator_destroy(iter);
-    } else {
-      printf("error creating iterator\n");
-      goto cleanup;
     }
   }
 
+
   struct timespec end;
   clock_gettime(CLOCK_MONOTONIC, &end);
   task->metric->duration = TIME_DIFF_MICROS(start, end);
+  ret = 0;
 
-  cleanup: 
-    return;
+  cleanup:
+    profile_flush(&ps);
+    scratch.fp = NULL;
+    scratch.buf = NULL;
+    if (morsel_fp != NULL) {
+      fclose(morsel_fp);
+    }
+    free(morsel_buf);
+    return ret;
 }
 
-void filter_helper(Task* task){
+int filter_helper(Task* task) {
+  int ret = -1;
   RDD *rdd = task->rdd;
+  ProfileScope ps; // flushed in cleanup, so failed attempts count too
+  profile_begin(&ps, rdd->fn);
   if (rdd->numdependencies != 1) {
     printf("incorrect # of dependencies for a Filter function!\n");
     goto cleanup;
@@ -328,7 +819,7 @@ void filter_helper(Task* task){
   Filter filter = (Filter)rdd->fn;
   RDD *prev_rdd = rdd->dependencies[0];
 
-  List *output_partition = (List*)list_get(rdd->partitions, pnum);
+  List *output_partition = task_output(task);
   if(output_partition == NULL){
     printf("error, output partition %i partition %p is null(filter output).\n", pnum, rdd);
     goto cleanup;
@@ -345,35 +836,36 @@ void filter_helper(Task* task){
 
   // filter will ever deal with FILE* objects, only mapper does
   // so no need to check for case where numdependencies == 0, like in map_helper
-  List *input_partition = (List*)input_data;
-  ListIterator* iter = list_iterator_begin(input_partition);
-  if(iter != NULL){
-    while(list_iterator_has_next(iter)){
-      void *element = list_iterator_next(iter);
-      int result = filter(element, rdd->ctx); // filter returns 0 or 1, if 1, then keep element, if 0, don't keep element
-      if (result == 1) {
-        if(list_add_elem(output_partition, element) != 0){
-          printf("error adding filtered element to output partition %i RDD %p.\n", pnum, rdd);
-          goto cleanup;
-        }
+  long n;
+  for (ListNode* node = task_input(task, (List*)input_data, &n); node != NULL && n != 0; node = node->next, n--) {
+    void *element = node->data;
+    profile_before(&ps);
+    int result = filter(element, rdd->ctx); // filter returns 0 or 1, if 1, then keep element, if 0, don't keep element
+    profile_after(&ps, result == 1);
+    if (result == 1) {
+      if(list_add_elem(output_partition, element) != 0){
+        printf("error adding filtered element to output partition %i RDD %p.\n", pnum, rdd);
+        goto cleanup;
       }
     }
-    list_iterator_destroy(iter);
-  }else{
-    printf("error creating iterator.\n");
-    goto cleanup;
   }
 
+
   struct timespec end;
   clock_gettime(CLOCK_MONOTONIC, &end);
   task->metric->duration = TIME_DIFF_MICROS(start,end);
+  ret = 0;
 
   cleanup:
-    return;
+    profile_flush(&ps);
+    return ret;
 }
 
-void join_helper(Task* task){
+int join_helper(Task* task) {
+  int ret = -1;
   RDD *rdd = task->rdd;
+  ProfileScope ps; // flushed in cleanup, so failed attempts count too
+  profile_begin(&ps, rdd->fn);
   int pnum = task->pnum;
   Joiner joiner = (Joiner)rdd->fn;
   void *ctx = rdd->ctx;
@@ -427,7 +919,9 @@ void join_helper(Task* task){
       }
 
       void *result;
+      profile_before(&ps);
       result = joiner(row1, row2, ctx);
+      profile_after(&ps, result != NULL);
       if(result != NULL){
         list_add_elem(output_partition, result);
       }
@@ -436,15 +930,218 @@ void join_helper(Task* task){
   }
   list_iterator_destroy(iter1);
 
+
   struct timespec end;
   clock_gettime(CLOCK_MONOTONIC, &end);
   task->metric->duration = TIME_DIFF_MICROS(start,end);
+  ret = 0;
+
   cleanup:
-    return;
+    profile_flush(&ps);
+    return ret;
 }
 
-void partition_helper(Task* task) {
+// next element of a sorted partition; sets "*unsorted" if it is out of order
+static ListNode* merge_next(ListNode* node, Comparator cmp, void* ctx, int* unsorted) {
+  ListNode* next = node->next;
+  if (next != NULL && cmp(node->data, next->data, ctx) > 0) {
+    *unsorted = 1;
+  }
+  return next;
+}
+
+// merges two partitions sorted by key. For a run of equal keys, every
+// element of the left run is paired with every element of the right
+// run by walking the right run again, so nothing is buffered.
+int sort_merge_join_helper(Task* task) {
+  int ret = -1;
   RDD *rdd = task->rdd;
+  ProfileScope ps; // flushed in cleanup, so failed attempts count too
+  profile_begin(&ps, rdd->fn);
+  int pnum = task->pnum;
+  Joiner joiner = (Joiner)rdd->fn;
+  Comparator cmp = rdd->cmp;
+  void *ctx = rdd->ctx;
+  RDD *prev_rdd1 = rdd->dependencies[0];
+  RDD *prev_rdd2 = rdd->dependencies[1];
+
+  List *output_partition = (List*)list_get(rdd->partitions, pnum);
+  if (output_partition == NULL) {
+    printf("error, output partition %i for RDD %p is null(merge join output).\n", pnum, rdd);
+    goto cleanup;
+  }
+  List *input_data1 = list_get(prev_rdd1->partitions, pnum);
+  List *input_data2 = list_get(prev_rdd2->partitions, pnum);
+  if (input_data1 == NULL || input_data2 == NULL) {
+    printf("error, input partition %i for RDD %p is null(merge join input).\n", pnum, rdd);
+    goto cleanup;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &task->metric->scheduled);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  int unsorted = 0;
+  ListNode* left = input_data1->head;
+  ListNode* right = input_data2->head;
+  while (left != NULL && right != NULL && !unsorted) {
+    int c = cmp(left->data, right->data, ctx);
+    if (c < 0) {
+      left = merge_next(left, cmp, ctx, &unsorted);
+    } else if (c > 0) {
+      right = merge_next(right, cmp, ctx, &unsorted);
+    } else {
+      // the right run ends at the first element with a bigger key
+      ListNode* right_end = right;
+      while (right_end != NULL && cmp(left->data, right_end->data, ctx) == 0) {
+        right_end = merge_next(right_end, cmp, ctx, &unsorted);
+      }
+      while (left != NULL && cmp(left->data, right->data, ctx) == 0) {
+        for (ListNode* r = right; r != right_end; r = r->next) {
+          profile_before(&ps);
+          void* result = joiner(left->data, r->data, ctx);
+          profile_after(&ps, result != NULL);
+          if (result != NULL && list_add_elem(output_partition, result) != 0) {
+            printf("error adding joined element to output partition %i RDD %p\n", pnum, rdd);
+            goto cleanup;
+          }
+        }
+        left = merge_next(left, cmp, ctx, &unsorted);
+      }
+      right = right_end;
+    }
+  }
+
+  if (unsorted) {
+    printf("error, input partition %i of merge join RDD %p is not sorted\n", pnum, rdd);
+    goto cleanup;
+  }
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  task->metric->duration = TIME_DIFF_MICROS(start,end);
+  ret = 0;
+
+  cleanup:
+    profile_flush(&ps);
+    return ret;
+}
+
+// runs the partition function once over the whole input partition, so a
+// typed pipeline (see typed.h) can process it in a single loop
+int map_partitions_helper(Task* task) {
+  int ret = -1;
+  RDD *rdd = task->rdd;
+  ProfileScope ps; // flushed in cleanup, so failed attempts count too
+  profile_begin(&ps, rdd->fn);
+  int pnum = task->pnum;
+  PartitionMapper fn = (PartitionMapper)rdd->fn;
+  RDD *prev_rdd = rdd->dependencies[0];
+
+  List* output_partition = (List*)list_get(rdd->partitions, pnum);
+  if (output_partition == NULL) {
+    printf("error, output partition %i for RDD %p is null(mapPartitions output).\n", pnum, rdd);
+    goto cleanup;
+  }
+  // FILE* for source RDDs, List* otherwise
+  void* input_data = list_get(prev_rdd->partitions, pnum);
+  if (input_data == NULL) {
+    printf("error, input data for RDD %p partition %i is null(mapPartitions input).\n", prev_rdd, pnum);
+    goto cleanup;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &task->metric->scheduled);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  int before = list_get_size(output_partition);
+  profile_before(&ps);
+  int fn_ret = fn(input_data, output_partition, rdd->ctx);
+  profile_after(&ps, list_get_size(output_partition) - before);
+  if (fn_ret != 0) {
+    printf("error, partition function failed on partition %i RDD %p\n", pnum, rdd);
+    goto cleanup;
+  }
+
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  task->metric->duration = TIME_DIFF_MICROS(start, end);
+  ret = 0;
+
+  cleanup:
+    profile_flush(&ps);
+    return ret;
+}
+
+// like map_partitions_helper(), with the matching partition of the
+// second input
+int zip_partitions_helper(Task* task) {
+  int ret = -1;
+  RDD *rdd = task->rdd;
+  ProfileScope ps; // flushed in cleanup, so failed attempts count too
+  profile_begin(&ps, rdd->fn);
+  int pnum = task->pnum;
+  PartitionZipper fn = (PartitionZipper)rdd->fn;
+
+  List* output_partition = (List*)list_get(rdd->partitions, pnum);
+  if (output_partition == NULL) {
+    printf("error, output partition %i for RDD %p is null(zipPartitions output).\n", pnum, rdd);
+    goto cleanup;
+  }
+  void* input_data[2];
+  for (int i = 0; i < 2; i++) {
+    input_data[i] = list_get(rdd->dependencies[i]->partitions, pnum);
+    if (input_data[i] == NULL) {
+      printf("error, input data for RDD %p partition %i is null(zipPartitions input %i).\n", rdd->dependencies[i],
+             pnum, i + 1);
+      goto cleanup;
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &task->metric->scheduled);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  int before = list_get_size(output_partition);
+  profile_before(&ps);
+  int fn_ret = fn(input_data[0], input_data[1], output_partition, rdd->ctx);
+  profile_after(&ps, list_get_size(output_partition) - before);
+  if (fn_ret != 0) {
+    printf("error, partition function failed on partition %i RDD %p\n", pnum, rdd);
+    goto cleanup;
+  }
+
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  task->metric->duration = TIME_DIFF_MICROS(start, end);
+  ret = 0;
+
+  cleanup:
+    profile_flush(&ps);
+    return ret;
+}
+
+// frees the per-target lists of a partitionBy task that publishes
+// nothing; targets[0, encoded) hold shuffle blocks
+static void free_targets(List** targets, int numpartitions, int encoded) {
+  for (int i = 0; i < numpartitions; i++) {
+    if (targets[i] != NULL) {
+      if (i < encoded) {
+        shuffle_blocks_clear(targets[i]);
+      }
+      list_free(targets[i]);
+    }
+  }
+  free(targets);
+}
+
+int partition_helper(Task* task) {
+  int ret = -1;
+  RDD *rdd = task->rdd;
+  ProfileScope ps; // flushed in cleanup, so failed attempts count too
+  profile_begin(&ps, rdd->fn);
   if (rdd->numdependencies != 1) {
     printf("incorrect # of dependencies for a Partition function!\n");
     goto cleanup;
@@ -460,151 +1157,543 @@ void partition_helper(Task* task) {
     printf("error, output partition list %p is null(partition output).\n", rdd); 
     goto cleanup;
   }
-  List *input_partition = (List*)list_get(prev_rdd->partitions, pnum);
-  if (input_partition == NULL) {
-    printf("error, output partition for RDD %p partition %i is null(partition input).\n", prev_rdd, pnum); 
-    goto cleanup;
+  List *input_partition = (List*)list_get(prev_rdd->partitions, pnum);
+  if (input_partition == NULL) {
+    printf("error, output partition for RDD %p partition %i is null(partition input).\n", prev_rdd, pnum); 
+    goto cleanup;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &task->metric->scheduled);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // elements are collected per target first and only published once the
+  // whole input partition went through, so a failed attempt leaves the
+  // output partitions untouched and can simply be retried
+  int encoded = 0; // targets[0, encoded) hold blocks
+  List** targets = calloc(numpartitions, sizeof(List*));
+  if (targets == NULL) {
+    printf("error allocating target lists for RDD %p partition %i\n", rdd, pnum);
+    goto cleanup;
+  }
+  scratch.targets = targets;
+  scratch.ntargets = numpartitions;
+  scratch.encoded = 0;
+  long n;
+  for (ListNode* node = task_input(task, input_partition, &n); node != NULL && n != 0; node = node->next, n--) {
+    void *element = node->data;
+    profile_before(&ps);
+    unsigned long target = partitioner(element, numpartitions, ctx);
+    profile_after(&ps, 1);
+    if (target >= (unsigned long)numpartitions) {
+      printf("error, partitioner returned invalid index %lu for RDD %p\n", target, rdd);
+      continue;
+    }
+    if (targets[target] == NULL && (targets[target] = list_init()) == NULL) {
+      printf("error creating target list %lu for RDD %p\n", target, rdd);
+      goto discard;
+    }
+    if (list_add_elem(targets[target], element) != 0) {
+      printf("error, failed to add element to target list %lu for RDD %p\n", target, rdd);
+      goto discard;
+    }
+  }
+  if (task_failed) {
+    goto discard; // the Partitioner called MS_FailTask()
+  }
+
+  // serialized shuffles publish blocks instead, fetch tasks decode them
+  for (encoded = 0; rdd->codec != NULL && encoded < numpartitions; encoded++) {
+    scratch.encoded = encoded;
+    if (targets[encoded] == NULL) {
+      continue;
+    }
+    List* blocks = list_init();
+    if (blocks == NULL || shuffle_write(targets[encoded], rdd->encode, rdd->codec, blocks) != 0) {
+      printf("error writing shuffle blocks of RDD %p partition %i\n", rdd, encoded);
+      if (blocks != NULL) {
+        shuffle_blocks_clear(blocks);
+        list_free(blocks);
+      }
+      goto discard;
+    }
+    list_free(targets[encoded]);
+    targets[encoded] = blocks;
+  }
+  scratch.targets = NULL;
+
+  for (int i = 0; i < numpartitions; i++) {
+    if (targets[i] == NULL) {
+      continue;
+    }
+    pthread_mutex_lock(&rdd->rdd_lock);
+    List* output_partition = rdd->codec != NULL ? rdd->blocks[i] : (List*)list_get(output_partitions_list, i);
+    pthread_mutex_unlock(&rdd->rdd_lock);
+    if (output_partition == NULL) {
+      printf("error, target output partition %i is NULL for RDD %p\n", i, rdd);
+      list_free(targets[i]);
+      continue;
+    }
+    if (mem_accounting && rdd->codec == NULL) {
+      mem_charge(rdd, i, mem_list_bytes(rdd, targets[i]));
+    }
+    pthread_mutex_lock(&rdd->partition_locks[i]);
+    list_concat(output_partition, targets[i]); // frees targets[i]
+    pthread_mutex_unlock(&rdd->partition_locks[i]);
+  }
+  free(targets);
+
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  task->metric->duration = TIME_DIFF_MICROS(start,end);
+  ret = 0;
+
+  cleanup:
+    profile_flush(&ps);
+    return ret;
+
+  discard:
+    profile_flush(&ps);
+    scratch.targets = NULL;
+    free_targets(targets, numpartitions, encoded);
+    return ret;
+}
+
+// decodes the shuffle blocks every partitionBy task wrote for partition
+// "pnum" into that partition
+int shuffle_fetch_helper(Task* task) {
+  int ret = -1;
+  RDD *rdd = task->rdd;
+  int pnum = task->pnum;
+  clock_gettime(CLOCK_MONOTONIC, &task->metric->scheduled);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  pthread_mutex_lock(&rdd->rdd_lock);
+  List* output_partition = (List*)list_get(rdd->partitions, pnum);
+  pthread_mutex_unlock(&rdd->rdd_lock);
+  if (output_partition == NULL) {
+    printf("error, output partition %i is NULL for RDD %p\n", pnum, rdd);
+    goto cleanup;
+  }
+  // the blocks are only dropped once all of them decoded, so a failed
+  // attempt can start over
+  List* decoded = list_init();
+  if (decoded == NULL) {
+    printf("error creating shuffle output for RDD %p partition %i\n", rdd, pnum);
+    goto cleanup;
+  }
+  scratch.decoded = decoded;
+  int read = shuffle_read(rdd->blocks[pnum], rdd->decode, rdd->codec, decoded);
+  scratch.decoded = NULL;
+  if (read != 0) {
+    printf("error reading shuffle blocks of RDD %p partition %i\n", rdd, pnum);
+    list_free(decoded);
+    goto cleanup;
+  }
+  shuffle_blocks_clear(rdd->blocks[pnum]);
+  if (mem_accounting) {
+    mem_charge(rdd, pnum, mem_list_bytes(rdd, decoded));
+  }
+  pthread_mutex_lock(&rdd->partition_locks[pnum]);
+  list_concat(output_partition, decoded);
+  pthread_mutex_unlock(&rdd->partition_locks[pnum]);
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  task->metric->duration = TIME_DIFF_MICROS(start,end);
+  ret = 0;
+
+  cleanup:
+    return ret;
+}
+
+// void file_backed_helper(Task* task){
+//   (void)task;
+//   return;
+// }
+
+//////// Task Failures ///////////////////
+
+int max_task_retries = DEFAULT_TASK_RETRIES;
+int sandbox_enabled = 0;
+static __thread sigjmp_buf* task_jmp = NULL; // where a crashing task resumes
+static __thread int task_pnum = -1; // partition of the running task, -1 outside tasks
+
+void MS_FailTask() {
+  task_failed = 1;
+}
+
+int MS_TaskPartition() {
+  return task_pnum;
+}
+
+int MS_WorkerId() {
+  return current_worker;
+}
+
+void MS_SetProfiling(int sample_every) {
+  profile_enable(sample_every);
+}
+
+void MS_SetTaskRetries(int retries) {
+  max_task_retries = retries < 0 ? 0 : retries;
+}
+
+// a fault inside a sandboxed task jumps back into run_task_attempt();
+// anything else still kills the process
+static void sandbox_handler(int sig) {
+  if (task_jmp != NULL) {
+    siglongjmp(*task_jmp, sig);
+  }
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+void MS_SetSandbox(int enabled) {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = enabled ? sandbox_handler : SIG_DFL;
+  sa.sa_flags = SA_ONSTACK | SA_NODEFER;
+  sigemptyset(&sa.sa_mask);
+  int sigs[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL};
+  for (int i = 0; i < (int)(sizeof(sigs) / sizeof(sigs[0])); i++) {
+    if (sigaction(sigs[i], &sa, NULL) != 0) {
+      perror("sigaction");
+    }
+  }
+  sandbox_enabled = enabled;
+}
+
+// workers get their own signal stack so that a stack overflow in user
+// code can still be caught by the sandbox
+static void sandbox_thread_init() {
+  stack_t ss;
+  ss.ss_sp = malloc(SIGSTKSZ);
+  if (ss.ss_sp == NULL) {
+    return;
+  }
+  ss.ss_size = SIGSTKSZ;
+  ss.ss_flags = 0;
+  if (sigaltstack(&ss, NULL) != 0) {
+    free(ss.ss_sp);
+  }
+}
+
+static void sandbox_thread_destroy() {
+  stack_t ss;
+  if (sigaltstack(NULL, &ss) == 0 && !(ss.ss_flags & SS_DISABLE)) {
+    stack_t disable;
+    disable.ss_sp = NULL;
+    disable.ss_size = 0;
+    disable.ss_flags = SS_DISABLE;
+    sigaltstack(&disable, NULL);
+    free(ss.ss_sp);
+  }
+}
+
+// one attempt at computing the task's partition, returns 0 on success
+static int run_task_attempt(Task* task) {
+  switch (task->rdd->trans)
+  {
+  case MAP:
+    return map_helper(task);
+  case FILTER:
+    return filter_helper(task);
+  case JOIN:
+    return join_helper(task);
+  case SORT_MERGE_JOIN:
+    return sort_merge_join_helper(task);
+  case PARTITIONBY:
+    return task->fetch ? shuffle_fetch_helper(task) : partition_helper(task);
+  case MAP_PARTITIONS:
+    return map_partitions_helper(task);
+  case ZIP_PARTITIONS:
+    return zip_partitions_helper(task);
+  default:
+    printf("unknown worker type encountered %d\n", task->rdd->trans);
+    return -1;
+  }
+}
+
+// empties the output a failed attempt appended to. The elements are
+// dropped, not freed: they may still be shared with the input partition.
+// returns -1 if the task has no output partition
+static int drop_output(Task* task) {
+  if (task->rdd->trans == PARTITIONBY) {
+    return 0;
+  }
+  List* output_partition = task_output(task);
+  if (output_partition == NULL) {
+    return -1;
+  }
+  while (list_get_size(output_partition) > 0) {
+    list_remove_elem(output_partition);
+  }
+  return 0;
+}
+
+// throw away what a failed attempt produced and rewind its input, so the
+// partition can be recomputed from its dependency. partition_helper()
+// publishes nothing when an attempt fails (including MS_FailTask() from
+// the Partitioner), so there is nothing to undo for partitionBy.
+// returns -1 if the partition cannot be recomputed.
+static int reset_task(Task* task) {
+  RDD* prev_rdd = task->rdd->dependencies[0];
+  if (drop_output(task) != 0) {
+    return -1;
+  }
+  // byte morsels and inputs read ahead reopen their range
+  if (is_file_source(prev_rdd) && task->morsel < 0 && task->input == NULL) {
+    FILE* fp = (FILE*)list_get(prev_rdd->partitions, task->pnum);
+    if (fp == NULL || fseek(fp, 0, SEEK_SET) != 0) {
+      return -1;
+    }
+    clearerr(fp);
+  }
+  return 0;
+}
+
+// frees what a crashed attempt left in "scratch"
+static void release_scratch() {
+  if (scratch.fp != NULL) {
+    fclose(scratch.fp);
+  }
+  free(scratch.buf);
+  if (scratch.targets != NULL) {
+    free_targets(scratch.targets, scratch.ntargets, scratch.encoded);
+  }
+  if (scratch.decoded != NULL) {
+    list_free(scratch.decoded);
+  }
+  memset(&scratch, 0, sizeof(scratch));
+}
+
+// run_task_attempt() guarded by the sandbox handler. A crash releases
+// the attempt's buffers and its half-built output; the elements it
+// created are leaked.
+static int run_task_sandboxed(Task* task) {
+  sigjmp_buf env;
+  volatile int ret = -1;
+  int sig = sigsetjmp(env, 1);
+  if (sig == 0) {
+    task_jmp = &env;
+    ret = run_task_attempt(task);
+  } else {
+    printf("task for RDD %p partition %i crashed with signal %i\n", task->rdd, task->pnum, sig);
+    release_scratch();
+    drop_output(task);
+  }
+  task_jmp = NULL;
+  return ret;
+}
+
+// runs "task" up to 1 + max_task_retries times, returns 0 on success
+static int run_task(Task* task) {
+  for (int attempt = 0; ; attempt++) {
+    task_failed = 0;
+    task_pnum = task->pnum;
+    int ret = sandbox_enabled ? run_task_sandboxed(task) : run_task_attempt(task);
+    task_pnum = -1;
+    if (ret == 0 && !task_failed) {
+      return 0;
+    }
+    if (attempt >= max_task_retries) {
+      printf("error, task for RDD %p partition %i failed after %i attempts\n", task->rdd, task->pnum, attempt + 1);
+      return -1;
+    }
+    if (reset_task(task) != 0) {
+      printf("error, partition %i of RDD %p cannot be recomputed\n", task->pnum, task->rdd);
+      return -1;
+    }
+  }
+}
+
+//////// Worker Idling ///////////////////
+
+int idle_spins = DEFAULT_IDLE_SPINS;
+int idle_yields = DEFAULT_IDLE_YIELDS;
+int idle_timeout_ms = DEFAULT_IDLE_TIMEOUT_MS;
+int pool_min_threads = 0; // 0 = number of CPUs
+int pool_max_threads = 0;
+
+void MS_SetIdlePolicy(int spins, int yields, int timeout_ms) {
+  idle_spins = spins < 0 ? 0 : spins;
+  idle_yields = yields < 0 ? 0 : yields;
+  idle_timeout_ms = timeout_ms < 0 ? 0 : timeout_ms;
+}
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+// Waits for a task: polls the queue, then yields, then parks on
+// "available". Returns NULL if the pool shuts down, or if this worker
+// parked for idle_timeout_ms and the pool is above its minimum size,
+// in which case the worker is marked retired.
+static Task* worker_next_task(ThreadPool* tp, WorkerSlot* self) {
+  WorkQueue* wq = tp->wq;
+  for (int i = 0; i < idle_spins + idle_yields; i++) {
+    if (__atomic_load_n(&wq->pending, __ATOMIC_ACQUIRE) > 0) {
+      break;
+    }
+    if (i < idle_spins) {
+      cpu_relax();
+    } else {
+      sched_yield();
+    }
   }
 
-  clock_gettime(CLOCK_MONOTONIC, &task->metric->scheduled);
-  struct timespec start;
-  clock_gettime(CLOCK_MONOTONIC, &start);
+  pthread_mutex_lock(&wq->lock);
+  while (wq->pending == 0) {
+    pthread_mutex_lock(&tp->pool_lock);
+    int current_shutdown = tp->shutdown;
+    int may_retire = idle_timeout_ms > 0 && tp->num_threads > tp->min_threads;
+    pthread_mutex_unlock(&tp->pool_lock);
+    if (current_shutdown) {
+      pthread_mutex_unlock(&wq->lock);
+      return NULL;
+    }
 
-  ListIterator* iter = list_iterator_begin(input_partition);
-  if(iter != NULL){
-    while(list_iterator_has_next(iter)){
-      void *element = list_iterator_next(iter);
-      unsigned long target = partitioner(element, numpartitions, ctx);
-      if (target >= (unsigned long)numpartitions) {
-        printf("error, partitioner returned invalid index %lu for RDD %p\n", target, rdd);
-        pthread_mutex_unlock(&rdd->partition_locks[target]);
-        continue;
+    int timed_out = 0;
+    wq->parked++;
+    if (may_retire) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += idle_timeout_ms / 1000;
+      deadline.tv_nsec += (idle_timeout_ms % 1000) * 1000000L;
+      if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
       }
-      // lock specific target pnum's mutex
-      pthread_mutex_lock(&rdd->rdd_lock);
-      List* output_partition = (List*)list_get(output_partitions_list, (int) target);
-      pthread_mutex_unlock(&rdd->rdd_lock);
-      pthread_mutex_lock(&rdd->partition_locks[target]);
-      if (output_partition == NULL) {
-        pthread_mutex_unlock(&rdd->partition_locks[target]);
-        printf("error, target output partition %lu is NULL for RDD %p\n", target, rdd);
-        continue;
+      timed_out = pthread_cond_timedwait(&wq->available, &wq->lock, &deadline) != 0;
+    } else {
+      pthread_cond_wait(&wq->available, &wq->lock);
+    }
+    wq->parked--;
+
+    if (timed_out && wq->pending == 0) {
+      pthread_mutex_lock(&tp->pool_lock);
+      int retire = tp->num_threads > tp->min_threads;
+      if (retire) {
+        tp->num_threads--;
+        self->state = WORKER_RETIRED;
       }
-      if (list_add_elem(output_partition, element) != 0) {
-        pthread_mutex_unlock(&rdd->partition_locks[target]);
-        printf("error, failed to add element to target output partition %lu for RDD %p\n", target, rdd);
-        goto cleanup;
+      pthread_mutex_unlock(&tp->pool_lock);
+      if (retire) {
+        pthread_mutex_unlock(&wq->lock);
+        return NULL;
       }
-      pthread_mutex_unlock(&rdd->partition_locks[target]);
     }
-    list_iterator_destroy(iter);
-  }else{
-    printf("error creating iterator.\n");
-    goto cleanup;
   }
+  Task* task = work_queue_take(wq, self->id);
+  pthread_mutex_unlock(&wq->lock);
+  return task;
+}
 
-  struct timespec end;
-  clock_gettime(CLOCK_MONOTONIC, &end);
-  task->metric->duration = TIME_DIFF_MICROS(start,end);
-  
-  cleanup:
-    return;
+static void fail_rdd(RDD *rdd) {
+  pthread_mutex_lock(&rdd->rdd_lock);
+  rdd->failed = 1;
+  rdd->complete = 1;
+  pthread_cond_broadcast(&rdd->completed_cv);
+  pthread_mutex_unlock(&rdd->rdd_lock);
 }
 
-// void file_backed_helper(Task* task){
-//   (void)task;
-//   return;
-// }
+// once the last partitionBy task of a serialized shuffle wrote its
+// blocks, queue one fetch task per output partition. They are part of
+// the RDD's completion goal, so it completes after they ran.
+static void shuffle_task_done(Task* task) {
+  RDD* rdd = task->rdd;
+  if (rdd->trans != PARTITIONBY || rdd->codec == NULL || task->fetch
+      || __atomic_sub_fetch(&rdd->shuffle_pending, 1, __ATOMIC_ACQ_REL) != 0) {
+    return;
+  }
+  // without its fetch tasks the RDD never reaches its completion goal
+  TaskChain fetches = {NULL, NULL, 0};
+  for (int i = 0; i < rdd->numpartitions; i++) {
+    Task* fetch = create_task(rdd, i);
+    if (fetch == NULL) {
+      printf("error creating fetch task %i for RDD %p\n", i, rdd);
+      chain_discard(&fetches, NULL, 0);
+      fail_rdd(rdd);
+      return;
+    }
+    fetch->fetch = 1;
+    fetch->pool = task->pool;
+    chain_add(&fetches, fetch);
+  }
+  if (thread_pool_submit_batch(fetches.head, fetches.size) != 0) {
+    printf("failed to submit fetch tasks for RDD %p\n", rdd);
+    chain_discard(&fetches, NULL, 0);
+    fail_rdd(rdd);
+  }
+}
 
 //////// Worker Function ///////////////////
 
 // processes tasks from the work queue until shutdown
 // handles task execution and sync between threads
-// 1. dequeues a task
+// 1. dequeues a task (see worker_next_task() for idling)
 // 2. calls appropriate helper function (which performs the actual data processing)
 // 3. updates the completion status of the task's RDD
 // 4. cleans up the task and metric resources.
 // 5. updates thread pool's state.
 void *worker_function(void *arg) {
-  ThreadPool *tp = (ThreadPool *)arg;
-  WorkQueue *wq = tp->wq;
-  pthread_t self_id = pthread_self(); // Get worker's own ID for logging
+  WorkerSlot *self = (WorkerSlot *)arg;
+  ThreadPool *tp = self->tp;
+  current_worker = self->id;
+  sandbox_thread_init();
   while (1) {
-    int current_shutdown = 0; // shutdown status for worker_function
-
-    pthread_mutex_lock(&wq->lock);
-    // sleep til there's tasks available
-    // check shutdown status before waiting to ensure no race condition
-    while (list_get_size(wq->tasks) == 0) {
-      pthread_mutex_lock(&tp->pool_lock);
-      current_shutdown = tp->shutdown;
-      pthread_mutex_unlock(&tp->pool_lock);
-
-      if (current_shutdown) {
-        break;
-      }
-      pthread_cond_wait(&wq->available, &wq->lock);
+    Task *task = worker_next_task(tp, self);
+    if (task == NULL) {
+      break; // shutdown, or this worker retired
     }
-
-    // check if wake up was due to shut down or not
-    if (current_shutdown == 1 && list_get_size(wq->tasks) == 0) {
-      pthread_mutex_unlock(&wq->lock);
-      break; // exit worker loop since shut down
+    // execute task, retrying it from its inputs if it fails
+    int task_ret = run_task(task);
+    // partitionBy tasks charge the partitions they route to themselves
+    if (task_ret == 0 && mem_accounting && task->rdd->trans != PARTITIONBY) {
+      mem_charge(task->rdd, task->pnum, mem_list_bytes(task->rdd, task_output(task)));
     }
-
-    Task *task = NULL; // being safe rn
-    if (list_get_size(wq->tasks) > 0) {
-      task = (Task *)list_remove_elem(wq->tasks);
+    prefetch_release(task);
+    morsel_done(task);
+    shuffle_task_done(task);
+    pool_task_scheduled(task->pool, task->metric);
+    if (tracing) {
+      trace_task_done(task);
     }
-    pthread_mutex_unlock(&wq->lock);
-    if (task != NULL)
-    {
-      // execute task
-      switch (task->rdd->trans)
-      {
-      case MAP:
-        map_helper(task);
-        break;
-      case FILTER:
-        filter_helper(task);
-        break;
-      case JOIN:
-        join_helper(task);
-        break;
-      case PARTITIONBY:
-        partition_helper(task);
-        break;
-      default: 
-        printf("unknown worker type encountered %d\n", task->rdd->trans);
-      }
-
-      pthread_mutex_lock(&task->rdd->rdd_lock);
-      if (!task->rdd->complete) {
-        task->rdd->completed_partitions++;
-        if (task->rdd->completed_partitions == task->rdd->completion_task_goal) {
-          task->rdd->complete = 1;
-          pthread_cond_broadcast(&task->rdd->completed_cv);
-        } else if (task->rdd->completed_partitions > task->rdd->completion_task_goal) {
-        }
-      } else {
-      }
-      pthread_mutex_unlock(&task->rdd->rdd_lock);
 
-      metric_queue_enqueue(global_metrics_queue, task->metric);
-      task->metric = NULL;
-      free(task);
-      task = NULL;
-      pthread_mutex_lock(&tp->pool_lock);
-      tp->running_tasks--;
-      if (tp->shutdown == 0 && tp->running_tasks == 0)
-      {
-        pthread_cond_signal(&tp->pool_idle_cv);
+    pthread_mutex_lock(&task->rdd->rdd_lock);
+    if (task_ret != 0) {
+      task->rdd->failed = 1;
+    }
+    if (!task->rdd->complete) {
+      task->rdd->completed_partitions++;
+      if (task->rdd->completed_partitions == task->rdd->completion_task_goal) {
+        task->rdd->complete = 1;
+        pthread_cond_broadcast(&task->rdd->completed_cv);
+      } else if (task->rdd->completed_partitions > task->rdd->completion_task_goal) {
       }
-      pthread_mutex_unlock(&tp->pool_lock);
     } else {
-      printf("Worker [%lu]: Dequeued NULL task unexpectedly.\n", self_id);
     }
+    pthread_mutex_unlock(&task->rdd->rdd_lock);
+
+    metric_queue_enqueue(global_metrics_queue, task->metric);
+    task_free(task);
+    task = NULL;
+    pthread_mutex_lock(&tp->pool_lock);
+    tp->running_tasks--;
+    if (tp->shutdown == 0 && tp->running_tasks == 0)
+    {
+      pthread_cond_signal(&tp->pool_idle_cv);
+    }
+    pthread_mutex_unlock(&tp->pool_lock);
   }
+  sandbox_thread_destroy();
   return NULL;
 }
 
@@ -616,46 +1705,100 @@ void *monitor_function(void *arg) {
   if (fp == NULL) {
     return NULL;
   }
+  // batches are formatted here and written with a single write()
+  setvbuf(fp, NULL, _IONBF, 0);
+  char* batch = malloc(METRIC_BATCH * 256);
+  if (batch == NULL) {
+    fclose(fp);
+    return NULL;
+  }
   while(1) {
-    pthread_mutex_lock(&mq->lock);
-    while (list_get_size(mq->metrics) == 0 && global_shutdown_requested == 0) {
-      pthread_cond_wait(&mq->available, &mq->lock);
+    size_t len = 0;
+    int n = 0;
+    TaskMetric metric;
+    while (n < METRIC_BATCH && metric_queue_dequeue(mq, &metric)) {
+      len += format_metric(&metric, batch + len, 256);
+      n++;
+    }
+    if (n > 0) {
+      fwrite(batch, 1, len, fp);
+      continue;
     }
-    if (global_shutdown_requested == 1 && list_get_size(mq->metrics) == 0) {
+
+    pthread_mutex_lock(&mq->lock);
+    __atomic_store_n(&mq->sleeping, 1, __ATOMIC_SEQ_CST);
+    MetricSlot* next = &mq->slots[mq->head & (METRIC_RING_SIZE - 1)];
+    int empty = __atomic_load_n(&next->seq, __ATOMIC_SEQ_CST) != mq->head + 1;
+    if (empty && global_shutdown_requested == 1) {
       pthread_mutex_unlock(&mq->lock);
       break;
     }
-
-    TaskMetric *metric = (TaskMetric*) list_remove_elem(mq->metrics);
-    pthread_mutex_unlock(&mq->lock);
-    if (metric != NULL) {
-      print_formatted_metric(metric, fp);
-      free(metric);
-    } else {
-      printf("monitor dequeued NULL metric unexpectedly\n");
+    if (empty) {
+      pthread_cond_wait(&mq->available, &mq->lock);
     }
-    
+    __atomic_store_n(&mq->sleeping, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&mq->lock);
   }
+  free(batch);
   fclose(fp);
   return NULL;
 }
 
 //////// Thread Pool methods ///////////////
 
+// starts a worker in a free slot, growing the slot array if needed.
+// Called with pool_lock held. Returns 0 on success.
+static int spawn_worker(ThreadPool* tp) {
+  WorkerSlot* slot = NULL;
+  for (int i = 0; i < tp->num_slots && slot == NULL; i++) {
+    if (tp->workers[i]->state == WORKER_RETIRED) {
+      pthread_join(tp->workers[i]->thread, NULL);
+      tp->workers[i]->state = WORKER_EMPTY;
+    }
+    if (tp->workers[i]->state == WORKER_EMPTY) {
+      slot = tp->workers[i];
+    }
+  }
+  if (slot == NULL) {
+    WorkerSlot** workers = realloc(tp->workers, (tp->num_slots + 1) * sizeof(WorkerSlot*));
+    if (workers == NULL) {
+      return -1;
+    }
+    tp->workers = workers;
+    slot = malloc(sizeof(WorkerSlot));
+    if (slot == NULL) {
+      return -1;
+    }
+    slot->tp = tp;
+    slot->id = tp->num_slots;
+    slot->state = WORKER_EMPTY;
+    tp->workers[tp->num_slots++] = slot;
+  }
+  if (pthread_create(&slot->thread, NULL, worker_function, slot) != 0) {
+    return -1;
+  }
+  slot->state = WORKER_RUNNING;
+  tp->num_threads++;
+  return 0;
+}
+
 ThreadPool* thread_pool_init(int num_threads){
   ThreadPool *tp = malloc(sizeof(ThreadPool));
   if (tp == NULL) {
     return NULL;
   }
-  tp->num_threads = num_threads;
-  tp->wq = work_queue_init();
-  if (tp->wq == NULL) {
-    return NULL;
+  tp->num_threads = 0;
+  tp->min_threads = pool_min_threads > 0 ? pool_min_threads : num_threads;
+  tp->max_threads = pool_max_threads > 0 ? pool_max_threads : num_threads;
+  if (tp->max_threads < tp->min_threads) {
+    tp->max_threads = tp->min_threads;
   }
-  tp->threads = malloc(num_threads * sizeof(pthread_t));
-  if (tp->threads == NULL) {
+  tp->wq = work_queue_init(sched_policy(), tp->max_threads);
+  if (tp->wq == NULL) {
     return NULL;
   }
+  tp->workers = NULL;
+  tp->num_slots = 0;
   if (pthread_mutex_init(&tp->pool_lock, NULL) != 0) {
     return NULL;
   }
@@ -664,15 +1807,43 @@ ThreadPool* thread_pool_init(int num_threads){
   }
   tp->shutdown = 0;
   tp->running_tasks = 0;
-  for (int i = 0; i < num_threads; i++) {
-    if (pthread_create(&tp->threads[i], NULL, worker_function, tp) != 0) {
+  pthread_mutex_lock(&tp->pool_lock);
+  for (int i = 0; i < tp->min_threads; i++) {
+    if (spawn_worker(tp) != 0) {
+      pthread_mutex_unlock(&tp->pool_lock);
       return NULL; // error creating thread
     }
   }
+  pthread_mutex_unlock(&tp->pool_lock);
   global_thread_pool = tp;
   return tp;
 }
 
+void MS_SetPoolSize(int min_threads, int max_threads) {
+  pool_min_threads = min_threads < 0 ? 0 : min_threads;
+  pool_max_threads = max_threads < 0 ? 0 : max_threads;
+  ThreadPool* tp = global_thread_pool;
+  if (tp == NULL) {
+    return; // used by MS_Run()
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  int cpus = sched_getaffinity(0, sizeof(set), &set) == 0 ? CPU_COUNT(&set) : 1;
+  pthread_mutex_lock(&tp->pool_lock);
+  tp->min_threads = pool_min_threads > 0 ? pool_min_threads : cpus;
+  tp->max_threads = pool_max_threads > 0 ? pool_max_threads : cpus;
+  if (tp->max_threads < tp->min_threads) {
+    tp->max_threads = tp->min_threads;
+  }
+  while (tp->num_threads < tp->min_threads && spawn_worker(tp) == 0) {
+  }
+  pthread_mutex_unlock(&tp->pool_lock);
+  // parked workers above the new minimum may now retire
+  pthread_mutex_lock(&tp->wq->lock);
+  pthread_cond_broadcast(&tp->wq->available);
+  pthread_mutex_unlock(&tp->wq->lock);
+}
+
 
 void thread_pool_destroy() {
   ThreadPool* tp = global_thread_pool;
@@ -690,30 +1861,28 @@ void thread_pool_destroy() {
   pthread_mutex_lock(&tp->wq->lock);
   pthread_cond_broadcast(&tp->wq->available);
   pthread_mutex_unlock(&tp->wq->lock);
-  for (int i = 0; i < tp->num_threads; i++) {
-    int ret = pthread_join(tp->threads[i], NULL);
-    if (ret != 0) {
-      fprintf(stderr, "Error joining worker thread %d: %s\n", i, strerror(ret));
-    } else {
-    }
- if (ret != 0) {
+  // no worker is spawned or retired once shutdown is set
+  for (int i = 0; i < tp->num_slots; i++) {
+    if (tp->workers[i]->state != WORKER_EMPTY) {
+      int ret = pthread_join(tp->workers[i]->thread, NULL);
+      if (ret != 0) {
         fprintf(stderr, "Error joining worker thread %d: %s\n", i, strerror(ret));
-    } else {
-    }  }
+      }
+    }
+    free(tp->workers[i]);
+  }
   // cleanup remaining tasks in the queue first
   pthread_mutex_lock(&tp->wq->lock);
-  while(list_get_size(tp->wq->tasks) > 0) {
-    Task* task = (Task*)list_remove_elem(tp->wq->tasks);
+  while(tp->wq->pending > 0) {
+    Task* task = work_queue_take(tp->wq, -1);
     if (task != NULL) {
-      if (task->metric != NULL) {
-        free(task->metric);
-      }
+      prefetch_release(task);
     }
-    free(task);
+    task_free(task);
   }
   pthread_mutex_unlock(&tp->wq->lock);
   // rest of cleanup
-  free(tp->threads);
+  free(tp->workers);
   pthread_mutex_destroy(&tp->pool_lock);
   pthread_cond_destroy(&tp->pool_idle_cv);
   work_queue_destroy(tp->wq);
@@ -744,9 +1913,82 @@ int thread_pool_submit(Task* task) {
   if (work_queue_enqueue(tp->wq, task) != 0) {
     return -1;
   }; // add given task to worker queue!
+
+  // the queue backs up: add a worker if the pool may grow
+  pthread_mutex_lock(&tp->pool_lock);
+  if (tp->num_threads < tp->max_threads && !tp->shutdown
+      && __atomic_load_n(&tp->wq->pending, __ATOMIC_RELAXED) > tp->num_threads) {
+    spawn_worker(tp);
+  }
+  pthread_mutex_unlock(&tp->pool_lock);
+  return 0;
+}
+
+int thread_pool_submit_batch(Task* first, int n) {
+  ThreadPool* tp = global_thread_pool;
+  if (tp == NULL) {
+    return -1;
+  }
+  pthread_mutex_lock(&tp->pool_lock);
+  tp->running_tasks += n;
+  pthread_mutex_unlock(&tp->pool_lock);
+  if (work_queue_enqueue_batch(tp->wq, first, n) != 0) {
+    return -1;
+  }
+
+  // add workers for the backlog, as far as the pool may grow
+  pthread_mutex_lock(&tp->pool_lock);
+  while (tp->num_threads < tp->max_threads && !tp->shutdown
+         && __atomic_load_n(&tp->wq->pending, __ATOMIC_RELAXED) > tp->num_threads) {
+    if (spawn_worker(tp) != 0) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&tp->pool_lock);
   return 0;
 }
 
+// marks "rdd" done without result, so nobody waits for it forever
+// a union is complete as soon as its inputs are: it lists their
+// partitions, in order, without running any task
+static void union_partitions(RDD *rdd) {
+  for (int i = 0; i < rdd->numdependencies; i++) {
+    if (is_file_source(rdd->dependencies[i])) {
+      printf("error, union input RDD %p holds files, not elements\n", rdd->dependencies[i]);
+      fail_rdd(rdd);
+      return;
+    }
+  }
+  pthread_mutex_lock(&rdd->rdd_lock);
+  if (rdd->partitions == NULL) {
+    rdd->partitions = list_init();
+    if (rdd->partitions == NULL) {
+      pthread_mutex_unlock(&rdd->rdd_lock);
+      printf("fatal error, failed to initialize partitions list for RDD %p\n", rdd);
+      fail_rdd(rdd);
+      return;
+    }
+    for (int i = 0; i < rdd->numdependencies; i++) {
+      for (ListNode* p = rdd->dependencies[i]->partitions->head; p != NULL; p = p->next) {
+        list_add_elem(rdd->partitions, p->data);
+      }
+    }
+    rdd->numpartitions = list_get_size(rdd->partitions);
+  }
+  rdd->complete = 1;
+  pthread_cond_broadcast(&rdd->completed_cv);
+  pthread_mutex_unlock(&rdd->rdd_lock);
+}
+
+// waits for the tasks of "rdd" only, so actions of other threads
+// keep running
+void wait_rdd(RDD *rdd) {
+  pthread_mutex_lock(&rdd->rdd_lock);
+  while (!rdd->complete) {
+    pthread_cond_wait(&rdd->completed_cv, &rdd->rdd_lock);
+  }
+  pthread_mutex_unlock(&rdd->rdd_lock);
+}
 
 void execute(RDD *rdd) {
   if(rdd == NULL || rdd->complete){
@@ -762,6 +2004,10 @@ void execute(RDD *rdd) {
     pthread_mutex_unlock(&rdd->rdd_lock);
     return;
   }
+  // may swap the larger join input for a Bloom-filtered one
+  if (rdd->trans == JOIN) {
+    bloom_pushdown(rdd);
+  }
   // execute dependencies
   for (int i = 0; i < rdd->numdependencies; i++){
     execute(rdd->dependencies[i]);
@@ -773,19 +2019,44 @@ void execute(RDD *rdd) {
     while (dep->complete == 0) {
       pthread_cond_wait(&dep->completed_cv, &dep->rdd_lock);
     }
+    int dep_failed = dep->failed;
     pthread_mutex_unlock(&dep->rdd_lock);
+    // nothing correct can be computed on top of a failed dependency
+    if (dep_failed) {
+      pthread_mutex_lock(&rdd->rdd_lock);
+      rdd->failed = 1;
+      rdd->complete = 1;
+      pthread_cond_broadcast(&rdd->completed_cv);
+      pthread_mutex_unlock(&rdd->rdd_lock);
+      return;
+    }
+  }
+  if (rdd->trans == UNION) {
+    union_partitions(rdd);
+    return;
   }
   // dependencies should now be complete
   // set numpartitions
   pthread_mutex_lock(&rdd->rdd_lock);
   if (rdd->numpartitions == 0) {
-    if (rdd->trans == MAP || rdd->trans == FILTER || rdd->trans == JOIN) {
+    if (rdd->trans == MAP || rdd->trans == FILTER || rdd->trans == JOIN || rdd->trans == MAP_PARTITIONS
+        || rdd->trans == SORT_MERGE_JOIN || rdd->trans == ZIP_PARTITIONS) {
       rdd->numpartitions = rdd->dependencies[0]->numpartitions;
     }
   }
+  if (rdd->trans == ZIP_PARTITIONS && (rdd->dependencies[1]->numpartitions != rdd->numpartitions
+                                       || is_file_source(rdd->dependencies[0])
+                                       || is_file_source(rdd->dependencies[1]))) {
+    printf("error, RDD %p zips RDDs %p and %p with %i and %i partitions\n", rdd, rdd->dependencies[0],
+           rdd->dependencies[1], rdd->numpartitions, rdd->dependencies[1]->numpartitions);
+    pthread_mutex_unlock(&rdd->rdd_lock);
+    fail_rdd(rdd);
+    return;
+  }
   if (rdd->numpartitions <= 0) {
     printf("error, rdd %p has invalid number of partitions (%i) before init.\n", rdd, rdd->numpartitions);
     pthread_mutex_unlock(&rdd->rdd_lock);
+    fail_rdd(rdd);
     return;
 }
   if(rdd->partitions == NULL) {
@@ -793,6 +2064,7 @@ void execute(RDD *rdd) {
     if (rdd->partitions == NULL) { // list init failure
       pthread_mutex_unlock(&rdd->rdd_lock);
       printf("fatal error, failed to initialize partitions list for RDD %p\n", rdd);
+      fail_rdd(rdd);
       return;
     }
     int init_failed = 0;
@@ -825,6 +2097,7 @@ void execute(RDD *rdd) {
       list_free(rdd->partitions);
       rdd->partitions = NULL;
       pthread_mutex_unlock(&rdd->rdd_lock);
+      fail_rdd(rdd);
       return;
     }
   }
@@ -834,6 +2107,7 @@ void execute(RDD *rdd) {
     if (rdd->partition_locks == NULL) {
       printf("error creating list of partition locks for RDD %p\n", rdd);
       pthread_mutex_unlock(&rdd->rdd_lock);
+      fail_rdd(rdd);
       return;
     }
     int init_failed = 0; // needed for cleanup
@@ -856,79 +2130,121 @@ void execute(RDD *rdd) {
       free(rdd->partition_locks);
       rdd->partition_locks = NULL; // need to try again
       pthread_mutex_unlock(&rdd->rdd_lock);
+      fail_rdd(rdd);
       return;
     }
   }
 
 
+  // the codec is picked per action, by the thread running it
+  if (rdd->trans == PARTITIONBY) {
+    rdd->codec = rdd->encode != NULL && rdd->decode != NULL ? shuffle_codec() : NULL;
+    if (rdd->codec != NULL && rdd->blocks == NULL) {
+      rdd->blocks = malloc(rdd->numpartitions * sizeof(List*));
+      for (int i = 0; rdd->blocks != NULL && i < rdd->numpartitions; i++) {
+        if ((rdd->blocks[i] = list_init()) == NULL) {
+          printf("error creating shuffle block list %i for RDD %p\n", i, rdd);
+          exit(1);
+        }
+      }
+      if (rdd->blocks == NULL) {
+        printf("error creating shuffle block lists for RDD %p\n", rdd);
+        pthread_mutex_unlock(&rdd->rdd_lock);
+        fail_rdd(rdd);
+        return;
+      }
+    }
+  }
+
   bool already_complete = (rdd->complete == 1);
   pthread_mutex_unlock(&rdd->rdd_lock);
 
   if (already_complete) {
     return;
   }
+  if (mem_accounting) {
+    mem_stage_start(rdd);
+  }
 
   if(global_thread_pool == NULL){
     printf("error, thread pool not initalized before submitting task\n");
+    fail_rdd(rdd);
     return;
   }
 
-  int num_tasks_to_submit = 0;
-  int task_goal_for_completion = 0;
-  RDD* source_rdd = NULL;
-
-  if (rdd->trans == MAP || rdd->trans == FILTER || rdd->trans == PARTITIONBY) {
+  if (rdd->trans == MAP || rdd->trans == FILTER || rdd->trans == PARTITIONBY || rdd->trans == MAP_PARTITIONS) {
     if (rdd->numdependencies != 1) {
       printf("error, incorrect dependency count (%i) for RDD %p transform %i\n", rdd->numdependencies, rdd, rdd->trans);
+      fail_rdd(rdd);
       return;
     }
-    source_rdd = rdd->dependencies[0];
-    num_tasks_to_submit = source_rdd->numpartitions;
-    task_goal_for_completion = num_tasks_to_submit;
-  } else if (rdd->trans == JOIN) {
+  } else if (rdd->trans == JOIN || rdd->trans == SORT_MERGE_JOIN || rdd->trans == ZIP_PARTITIONS) {
     if (rdd->numdependencies != 2) {
       printf("incorrect dependency count (%i) for JOIN rdd %p\n", rdd->numdependencies, rdd);
+      fail_rdd(rdd);
       return;
     }
-    num_tasks_to_submit = rdd->numpartitions;
-    task_goal_for_completion = num_tasks_to_submit;
   } else {
     printf("error, unexpected transform type %i in execute task submission\n", rdd->trans);
+    fail_rdd(rdd);
     return;
   }
 
+  // all tasks are created up front: the completion goal has to be known
+  // before the first of them can finish
+  TaskChain tasks = {NULL, NULL, 0};
+  if (rdd->trans == JOIN || rdd->trans == SORT_MERGE_JOIN || rdd->trans == ZIP_PARTITIONS) {
+    for (int i = 0; i < rdd->numpartitions; i++) {
+      Task* task = create_task(rdd, i);
+      if (task == NULL) {
+        chain_discard(&tasks, NULL, 0);
+        fail_rdd(rdd);
+        return;
+      }
+      chain_add(&tasks, task);
+    }
+  } else {
+    RDD* source_rdd = rdd->dependencies[0];
+    int i = 0;
+    for (ListNode* node = source_rdd->partitions->head; node != NULL; node = node->next, i++) {
+      if (add_partition_tasks(rdd, i, node->data, &tasks) == 0) {
+        chain_discard(&tasks, NULL, 0);
+        fail_rdd(rdd);
+        return;
+      }
+    }
+  }
+
+  int num_tasks_to_submit = tasks.size;
   if (num_tasks_to_submit <= 0) {
     printf("error, RDD %p calculated %i tasks to submit. Check if dependencies are initialized", rdd, num_tasks_to_submit);
+    fail_rdd(rdd);
     return;
   }
 
   pthread_mutex_lock(&rdd->rdd_lock);
-  rdd->completion_task_goal = task_goal_for_completion; // store the goal count
+  rdd->completion_task_goal = num_tasks_to_submit; // store the goal count
+  if (rdd->trans == PARTITIONBY && rdd->codec != NULL) {
+    // plus the fetch tasks, see shuffle_task_done()
+    rdd->shuffle_pending = num_tasks_to_submit;
+    rdd->completion_task_goal += rdd->numpartitions;
+  }
   pthread_mutex_unlock(&rdd->rdd_lock);
 
-
-  for(int i = 0; i < num_tasks_to_submit; i++){//create task and task metric for each partition
-    Task *task = malloc(sizeof(Task));
-    if (!task) {
-      printf("task malloc error");
-      continue;
-    }
-    task->rdd = rdd;
-    task->pnum = i;
-    task->metric = malloc(sizeof(TaskMetric));
-    if (!task->metric) {
-      free(task);
-      printf("task metric malloc error");
-      continue;
+  // maps over files are submitted once their input is read ahead, the
+  // rest of the stage at once
+  TaskChain ready = {NULL, NULL, 0};
+  for (Task *task = tasks.head, *next; task != NULL; task = next) {
+    next = task->next;
+    if (prefetch_submit(task) != 0) {
+      chain_add(&ready, task);
     }
-    clock_gettime(CLOCK_MONOTONIC, &task->metric->created);
-    task->metric->pnum = i;
-    task->metric->rdd = rdd;
-
-    if (thread_pool_submit(task) != 0) {
-      printf("failed to submit task for RDD %p, partition %i\n", rdd, i);
-      free(task->metric);
-      free(task);
+  }
+  if (ready.size > 0 && thread_pool_submit_batch(ready.head, ready.size) != 0) {
+    printf("failed to submit %i tasks for RDD %p\n", ready.size, rdd);
+    for (Task *task = ready.head, *next; task != NULL; task = next) {
+      next = task->next;
+      task_free(task);
     }
   }
 }
@@ -944,12 +2260,20 @@ void MS_Run() {
 
   int num_threads = CPU_COUNT(&set);
 
+  // MS_PROFILE=N profiles user functions, timing 1 out of every N calls
+  char* profile = getenv("MS_PROFILE");
+  if (profile != NULL) {
+    profile_enable(atoi(profile));
+  }
+
   global_thread_pool = thread_pool_init(num_threads);
   if (global_thread_pool == NULL) {
     printf("Failed to initialize thread pool\n");
     exit(1);
   }
+  prefetch_start();
 
+  global_shutdown_requested = 0; // MS_TearDown() may have run before
   global_metrics_queue = metric_queue_init();
   if (global_metrics_queue == NULL) {
     printf("failed to initialize metrics queue\n");
@@ -968,6 +2292,8 @@ void MS_Run() {
 }
 
 void MS_TearDown() {
+  // queued reads still submit their tasks
+  prefetch_stop();
   if (global_thread_pool != NULL) {
     thread_pool_destroy();
   }
@@ -988,13 +2314,23 @@ void MS_TearDown() {
     metric_queue_destroy(global_metrics_queue);
     global_metrics_queue = NULL;
   }
-    
+
+  // workers are gone, so every task has been flushed
+  profile_report();
+  mem_report();
+  task_pool_clear();
   return;
 }
 
 int count(RDD *rdd) {
+  pool_job_started(current_pool());
+  optimize(rdd, NULL);
   execute(rdd);
-  thread_pool_wait(); // need to wait for rdd + dependencies to fully materialize
+  wait_rdd(rdd); // need to wait for rdd + dependencies to fully materialize
+  if (rdd->failed) {
+    printf("error, RDD %p could not be computed\n", rdd);
+    return -1;
+  }
 
   int total_count = 0;
   if (rdd->partitions != NULL) {
@@ -1014,8 +2350,14 @@ int count(RDD *rdd) {
 }
 
 void print(RDD *rdd, Printer p) {
+  pool_job_started(current_pool());
+  optimize(rdd, NULL);
   execute(rdd);
-  thread_pool_wait();
+  wait_rdd(rdd);
+  if (rdd->failed) {
+    printf("error, RDD %p could not be computed\n", rdd);
+    return;
+  }
   // print all the items in rdd
   // aka... `p(item)` for all items in rdd
   if (rdd->partitions != NULL) {
@@ -1039,3 +2381,139 @@ void print(RDD *rdd, Printer p) {
   }
 
 }
+
+// source RDD over partitions [from, to) of "rdd", a source or a
+// materialized RDD. FILE*s and Lists are shared, not copied.
+static RDD* partition_view(RDD* rdd, int from, int to) {
+  RDD* view = create_rdd(0, is_file_source(rdd) ? MAP : FILE_BACKED, (void*)identity);
+  view->partitions = list_init();
+  if (view->partitions == NULL) {
+    printf("error creating partition view of RDD %p\n", rdd);
+    exit(1);
+  }
+  for (int i = from; i < to; i++) {
+    list_add_elem(view->partitions, list_get(rdd->partitions, i));
+  }
+  view->numpartitions = to - from;
+  return view;
+}
+
+// the narrow chain from "rdd" down to (not including) "base", rebuilt
+// on top of "view"
+static RDD* clone_chain(RDD* rdd, RDD* base, RDD* view) {
+  if (rdd == base) {
+    return view;
+  }
+  RDD* copy = create_rdd(1, rdd->trans, rdd->fn, clone_chain(rdd->dependencies[0], base, view));
+  copy->ctx = rdd->ctx;
+  return copy;
+}
+
+// copies up to "n" elements of the materialized "rdd" to "out", in
+// partition order, starting at out[got]. returns the new total
+static int collect(RDD* rdd, void** out, int got, int n) {
+  for (ListNode* p = rdd->partitions->head; p != NULL && got < n; p = p->next) {
+    for (ListNode* node = ((List*)p->data)->head; node != NULL && got < n; node = node->next) {
+      out[got++] = node->data;
+    }
+  }
+  return got;
+}
+
+int take(RDD *rdd, int n, void **out) {
+  if (is_file_source(rdd)) {
+    printf("error, RDD %p holds files, not elements\n", rdd);
+    return -1;
+  }
+  pool_job_started(current_pool());
+  optimize(rdd, NULL);
+
+  // partitions of a chain of maps and filters only depend on the same
+  // partition of the chain's base, so they can be computed a few at a time
+  RDD* base = rdd;
+  while (!base->complete && (base->trans == MAP || base->trans == FILTER || base->trans == MAP_PARTITIONS)
+         && base->numdependencies == 1) {
+    base = base->dependencies[0];
+  }
+  if (!is_file_source(base)) {
+    execute(base);
+    wait_rdd(base);
+    if (base->failed) {
+      printf("error, RDD %p could not be computed\n", base);
+      return -1;
+    }
+  }
+  if (base == rdd) {
+    return collect(rdd, out, 0, n);
+  }
+
+  int got = 0;
+  int numpartitions = list_get_size(base->partitions);
+  int batch = 1;
+  for (int from = 0; from < numpartitions && got < n; from += batch, batch *= TAKE_SCALE_UP) {
+    int to = from + batch < numpartitions ? from + batch : numpartitions;
+    long* offsets = NULL;
+    if (is_file_source(base)) {
+      // the files stay where they were for the next job reading them
+      offsets = malloc((to - from) * sizeof(long));
+      for (int i = from; offsets != NULL && i < to; i++) {
+        offsets[i - from] = ftell((FILE*)list_get(base->partitions, i));
+      }
+    }
+    RDD* part = clone_chain(rdd, base, partition_view(base, from, to));
+    execute(part);
+    wait_rdd(part);
+    if (offsets != NULL) {
+      for (int i = from; i < to; i++) {
+        FILE* fp = (FILE*)list_get(base->partitions, i);
+        fseek(fp, offsets[i - from], SEEK_SET);
+        clearerr(fp);
+      }
+      free(offsets);
+    }
+    if (part->failed) {
+      printf("error, partitions %i-%i of RDD %p could not be computed\n", from, to - 1, rdd);
+      return -1;
+    }
+    got = collect(part, out, got, n);
+  }
+  return got;
+}
+
+int top(RDD *rdd, int k, Comparator cmp, void *ctx, void **out) {
+  if (is_file_source(rdd)) {
+    printf("error, RDD %p holds files, not elements\n", rdd);
+    return -1;
+  }
+  // the heaps RDD keeps its ctx
+  struct top_ctx* tctx = malloc(sizeof(struct top_ctx));
+  if (tctx == NULL) {
+    printf("error allocating top of RDD %p\n", rdd);
+    exit(1);
+  }
+  tctx->order.cmp = cmp;
+  tctx->order.ctx = ctx;
+  tctx->k = k;
+  // only the k largest of each partition are kept and merged here
+  RDD* heaps = mapPartitions(rdd, TopPartition, tctx);
+  pool_job_started(current_pool());
+  optimize(heaps, NULL);
+  execute(heaps);
+  wait_rdd(heaps);
+  if (heaps->failed) {
+    printf("error, RDD %p could not be computed\n", rdd);
+    return -1;
+  }
+
+  TopHeap heap;
+  if (top_init(&heap, tctx) != 0) {
+    printf("error allocating a heap of %i elements\n", k);
+    return -1;
+  }
+  for (ListNode* p = heaps->partitions->head; p != NULL; p = p->next) {
+    for (ListNode* node = ((List*)p->data)->head; node != NULL; node = node->next) {
+      top_offer(&heap, node->data);
+    }
+  }
+  return top_drain(&heap, out);
+}
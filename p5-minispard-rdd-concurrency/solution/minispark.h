@@ -2,14 +2,26 @@
 #define __minispark_h__
 
 #include <pthread.h>
+#include <stddef.h>
 #include "list.h"
 
 #define MAXDEPS (2)
+#define DEFAULT_TASK_RETRIES (2)
+#define DEFAULT_MORSEL_ELEMS (4096)
+#define DEFAULT_IDLE_SPINS (1000) // busy polls of an empty queue before yielding
+#define DEFAULT_IDLE_YIELDS (8) // sched_yield()s before parking
+#define DEFAULT_IDLE_TIMEOUT_MS (200) // parked time after which extra workers retire
+#define METRIC_RING_SIZE (1024) // power of two
+#define METRIC_BATCH (256) // metrics the monitor writes at once
+#define TAKE_SCALE_UP (4) // take() computes 1, 4, 16, ... partitions at a time
 #define TIME_DIFF_MICROS(start, end) \
   (((end.tv_sec - start.tv_sec) * 1000000L) + ((end.tv_nsec - start.tv_nsec) / 1000L))
 
 struct RDD;
 struct List;
+struct ShuffleCodec;
+struct BloomJoin;
+struct MemAccount;
 
 typedef struct RDD RDD; // fo`rward decl. of struct RDD
 // typedef struct List List;  // forward decl. of List.
@@ -21,19 +33,48 @@ typedef int (*Filter)(void* arg, void* pred);
 typedef void* (*Joiner)(void* arg1, void* arg2, void* arg);
 typedef unsigned long (*Partitioner)(void *arg, int numpartitions, void* ctx);
 typedef void (*Printer)(void* arg);
+// called once per partition with the whole input partition (a FILE* for
+// RDDFromFiles sources, a List* otherwise); appends results to "output".
+// returns 0 on success
+typedef int (*PartitionMapper)(void* input, List* output, void* ctx);
+// called once per pair of partitions with the same index in two RDDs,
+// both Lists; appends results to "output". returns 0 on success
+typedef int (*PartitionZipper)(void* input1, void* input2, List* output, void* ctx);
+// orders two elements by key: <0, 0 or >0, like strcmp()
+typedef int (*Comparator)(void* a, void* b, void* ctx);
+// writes "elem" to "buf" if it fits in "cap" bytes; returns the number
+// of bytes it takes either way
+typedef size_t (*Encoder)(void* elem, char* buf, size_t cap);
+// rebuilds an element from the "len" bytes an Encoder wrote
+typedef void* (*Decoder)(const char* buf, size_t len);
+// returns the key of "elem" and sets "*len" to its length in bytes.
+// Elements with the same key bytes have the same key.
+typedef const char* (*KeyFn)(void* elem, size_t* len, void* ctx);
+// writes the text of "elem" to "buf" if it fits in "cap" bytes, like
+// snprintf() without the '\0'; returns the number of bytes it takes
+typedef size_t (*Formatter)(void* elem, char* buf, size_t cap);
+// hash of "elem"; elements that are Equal must have the same hash
+typedef unsigned long (*Hasher)(void* elem);
+// returns nonzero if "a" and "b" are the same element
+typedef int (*Equals)(void* a, void* b);
 
 typedef enum {
   MAP,
   FILTER,
   JOIN,
   PARTITIONBY,
-  FILE_BACKED
+  FILE_BACKED,
+  MAP_PARTITIONS,
+  SORT_MERGE_JOIN,
+  UNION,
+  ZIP_PARTITIONS
 } Transform;
 
 struct RDD {    
   Transform trans; // transform type, see enum
   void* fn; // transformation function
   void* ctx; // used by minispark lib functions
+  Comparator cmp; // key order of SORT_MERGE_JOIN inputs
   List* partitions; // list of partitions
   
   RDD* dependencies[MAXDEPS];
@@ -51,6 +92,22 @@ struct RDD {
   // thus, wakes up the dependent RDD and it can now continue.
   pthread_cond_t completed_cv; 
   int completion_task_goal; // num of tasks that need to be completed for this RDD stage (test 19)
+  int failed; // set to 1 when a partition could not be computed, even after retries
+
+  // serialized shuffles, see shuffle.h
+  Encoder encode; // element format of a partitionBy, NULL if it has none
+  Decoder decode;
+  struct ShuffleCodec* codec; // codec of the running partitionBy, NULL to move pointers
+  List** blocks; // per output partition, the ShuffleBlocks written so far
+  int shuffle_pending; // partitionBy tasks that still write blocks
+
+  // Bloom filter semi-joins, see optimizer.h
+  KeyFn join_key; // join key of both inputs of a join, NULL if unknown
+  void* join_key_ctx;
+  struct BloomJoin* bloom; // set once the join's larger input is filtered
+
+  // memory accounting, see footprint.h
+  struct MemAccount* mem; // NULL until a stage of it is counted
  };
 
 typedef struct {
@@ -62,35 +119,93 @@ typedef struct {
 } TaskMetric;
 
 typedef struct {
-  List* metrics;
+  // the slot holds the metric of position "seq - 1" once it is published,
+  // and is free for position "seq" (round i: seq == i * METRIC_RING_SIZE + index)
+  unsigned long seq;
+  TaskMetric metric;
+} MetricSlot;
+
+// Bounded multi-producer, single-consumer ring of metrics. Workers claim
+// a position with one atomic increment and copy their metric into the
+// preallocated slot; only the monitor reads. "lock" and "available" are
+// only used to put the monitor to sleep when the ring is empty.
+typedef struct {
+  MetricSlot* slots; // METRIC_RING_SIZE
+  unsigned long tail __attribute__((aligned(64))); // next position a worker claims
+  unsigned long head __attribute__((aligned(64))); // next position the monitor reads
+  int sleeping; // the monitor waits on "available"
   pthread_mutex_t lock;
   pthread_cond_t available;
 } MetricQueue;
 
+// outputs of the morsels of one partition, merged by the last one to finish
 typedef struct {
+  List** outputs; // one list per morsel
+  int nmorsels;
+  int remaining; // morsels not done yet
+} MorselGroup;
+
+typedef struct JobPool JobPool; // see scheduler.h
+struct SchedPolicy;
+
+typedef struct Task {
   RDD* rdd;
   int pnum;
   TaskMetric* metric;
+  JobPool* pool; // pool of the action that created the task
+  struct Task* next; // link in the scheduler's queues
+  int fetch; // reads the shuffle blocks of output partition "pnum"
+  // morsel of the partition this task computes; morsel == -1 for the whole partition
+  int morsel;
+  MorselGroup* group; // NULL when morsels publish directly (partitionBy)
+  ListNode* first; // List input: first element of the morsel
+  long start; // element (List input) or byte (file input) range [start, end)
+  long end;
+  char* input; // file input read ahead by the I/O threads (see prefetch.h), or NULL
+  long input_begin; // its lines are input[input_begin, input_end)
+  long input_end;
+  int home; // worker whose cache holds the task's input, -1 if unknown (see sched_locality)
 } Task;
 
 // CHANGE BELOW AS NEEDED
 typedef struct {
-  List* tasks;  // list of Task* pointers
+  struct SchedPolicy* policy; // decides which task runs next
+  void* sched; // queued tasks, owned by "policy"
+  int pending; // number of queued tasks, read without the lock by spinning workers
+  int parked; // workers waiting on "available"; enqueue only signals if > 0
   pthread_mutex_t lock;
   pthread_cond_t available;
   // pthread_cond_t completed; not used right now.
 } WorkQueue;
 
+typedef enum {
+  WORKER_EMPTY, // no thread
+  WORKER_RUNNING,
+  WORKER_RETIRED // thread exited, not joined yet
+} WorkerState;
+
+struct ThreadPool;
+
 typedef struct {
-  pthread_t* threads; // array storing [numthreads] thread IDs
-  int num_threads; // # of worker threads
+  pthread_t thread;
+  int id; // index in ThreadPool::workers
+  WorkerState state; // under pool_lock
+  struct ThreadPool* tp;
+} WorkerSlot;
+
+typedef struct ThreadPool {
+  WorkerSlot** workers; // [num_slots], RUNNING ones have a live thread
+  int num_slots;
+  int num_threads; // # of running worker threads
+  int min_threads; // workers never retire below this
+  int max_threads; // workers are only spawned up to this
   WorkQueue* wq; // pointer to shared work queue 
   int shutdown; // flag to signal threads to exit, 0 = running, 1 = shutting down
 
   // count of tasks currently being processed by workers plus tasks still in the queue   
   int running_tasks; // thread_pool_submit increments, workers decrement after finishing a task.
 
-  pthread_mutex_t pool_lock; // meant to protect shutdown and running_tasks
+  pthread_mutex_t pool_lock; // meant to protect shutdown, running_tasks and the workers
   pthread_cond_t  pool_idle_cv; // signaled when potentially idle
 
 } ThreadPool;
@@ -101,13 +216,32 @@ typedef struct {
 
 //////// actions ////////
 
-// Return the total number of elements in "dataset"
+// Return the total number of elements in "dataset", or -1 if it
+// could not be computed
 int count(RDD* dataset);
 
 // Print each element in "dataset" using "p".
-// For example, p(element) for all elements.
+// For example, p(element) for all elements. Nothing is printed if
+// "dataset" could not be computed.
 void print(RDD* dataset, Printer p);
 
+// Copy the first "n" elements of "dataset", in partition order, to
+// "out" and return how many there were (fewer if "dataset" is smaller),
+// or -1 on failure. Maps and filters over a source or a shuffle are only
+// computed for the first partition, then for TAKE_SCALE_UP times more
+// partitions per round, until "n" elements were found.
+int take(RDD* dataset, int n, void** out);
+
+// Copy the "k" largest elements of "dataset" by "cmp" to "out", largest
+// first, and return how many there were, or -1 on failure. Each
+// partition only keeps its own k largest, which are merged at the end.
+// "ctx" is passed to "cmp".
+int top(RDD* dataset, int k, Comparator cmp, void* ctx, void** out);
+
+// Optimize "dataset" (see MS_SetOptimizer()) and print the plan
+// that count() or print() would run, with the rules that fired.
+void explain(RDD* dataset);
+
 //////// transformations ////////
 
 // Create an RDD with "rdd" as its dependency and "fn"
@@ -119,26 +253,163 @@ RDD* map(RDD* rdd, Mapper fn);
 // when it is called as a Filter
 RDD* filter(RDD* rdd, Filter fn, void* ctx);
 
+// Create an RDD with "rdd" as its dependency. "fn" is called
+// once per partition instead of once per element, and "ctx"
+// is passed to it. See typed.h for building "fn" out of a
+// statically known chain of maps and filters.
+RDD* mapPartitions(RDD* rdd, PartitionMapper fn, void* ctx);
+
 // Create an RDD with two dependencies, "rdd1" and "rdd2"
 // "ctx" should be passed to "fn" when it is called as a
 // Joiner.
 RDD* join(RDD* rdd1, RDD* rdd2, Joiner fn, void* ctx);
 
+// Like join(), but every partition of "rdd1" and "rdd2" must already be
+// sorted by "cmp" (see sorted.h for range partitioning and sorting).
+// Matching partitions are merged in one pass, calling "fn" on every pair
+// of elements with equal keys; only the current run of equal keys is
+// revisited. "ctx" is passed to both "cmp" and "fn". A partition that
+// turns out not to be sorted fails its task.
+RDD* sortMergeJoin(RDD* rdd1, RDD* rdd2, Comparator cmp, Joiner fn, void* ctx);
+
 // Create an RDD with "rdd" as a dependency. The new RDD
 // will have "numpartitions" number of partitions, which
 // may be different than its dependency. "ctx" should be
 // passed to "fn" when it is called as a Partitioner.
 RDD* partitionBy(RDD* rdd, Partitioner fn, int numpartitions, void* ctx);
 
+// Create an RDD with two dependencies, which must have the same number
+// of partitions. "fn" is called once per partition index with the
+// partitions of both, and "ctx" is passed to it. Neither input can be
+// an RDDFromFiles() source.
+RDD* zipPartitions(RDD* rdd1, RDD* rdd2, PartitionZipper fn, void* ctx);
+
+// Create an RDD with the partitions of "rdd1" followed by those of
+// "rdd2", duplicates included. The partitions are shared with the
+// inputs, not copied. Neither input can be an RDDFromFiles() source.
+// (union is a C keyword.)
+RDD* unionAll(RDD* rdd1, RDD* rdd2);
+
 // Create an RDD which opens a list of files, one per
 // partition. The number of partitions in the RDD will be
-// equivalent to "numfiles."
+// equivalent to "numfiles." A map() over it calls its Mapper with the
+// partition's FILE*, except for byte morsels (see MS_SetMorselSize())
+// and inputs read ahead (see MS_SetPrefetch()): those get a read-only
+// memory stream over their lines, on which fileno(), fstat() and file
+// offsets do not refer to the file.
 RDD* RDDFromFiles(char* filenames[], int numfiles);
 
+//////// Task failures ////////
+
+// Called from inside a user function (Mapper, Filter, ...) to report
+// that the current task cannot produce a correct partition. The task's
+// output is discarded and the partition is recomputed from its inputs.
+void MS_FailTask();
+
+// Called from inside a user function, returns the partition the current
+// task computes (e.g. to name its output file), or -1 outside a task.
+int MS_TaskPartition();
+
+// Index of the calling worker thread in the pool, or -1 if it is not a
+// worker. Indexes are reused by workers spawned after others retired.
+int MS_WorkerId();
+
+// Number of times a failed task is recomputed before the RDD is
+// marked failed. Defaults to DEFAULT_TASK_RETRIES.
+void MS_SetTaskRetries(int retries);
+
+// If enabled, a crash (SIGSEGV, SIGBUS, SIGFPE, SIGILL) inside a task
+// fails that task instead of the whole process. This is best-effort:
+// the worker jumps out of the faulting code, so it is only safe for
+// faults in user code itself. A fault inside libc (e.g. in malloc() or
+// stdio, whose locks stay held) or under an engine lock can deadlock or
+// corrupt the process later. The engine frees the task's input buffers
+// and drops its partial output; memory the user code allocated is
+// leaked, and a crash that corrupted shared state (e.g. the heap) is
+// not recoverable.
+void MS_SetSandbox(int enabled);
+
+//////// Profiling ////////
+
+// Time 1 out of every "sample_every" calls of each user function and
+// print CPU time, call counts and fan-out per function at
+// MS_TearDown(). 0 (the default) disables profiling. Can also be set
+// with the MS_PROFILE environment variable.
+void MS_SetProfiling(int sample_every);
+
+//////// Morsels ////////
+
+// Split large partitions into morsels that idle workers can pick up:
+// map, filter and partitionBy over List partitions run as tasks of
+// "elements" elements each, and maps over RDDFromFiles() as tasks of
+// "bytes" bytes of the file, rounded to whole lines. Results keep the
+// partition order. 0 disables a kind of morsel. Byte morsels assume the
+// source Mapper reads one line per call, so they are off by default;
+// elements default to DEFAULT_MORSEL_ELEMS.
+void MS_SetMorselSize(int elements, long bytes);
+
+//////// Worker pool ////////
+
+// Workers that find the queue empty poll it "spins" times, then call
+// sched_yield() "yields" times, and only then sleep, so the next stage's
+// tasks are picked up without a wake-up. Workers beyond the minimum pool
+// size retire after sleeping "idle_timeout_ms" without work (0 keeps
+// them). Defaults: DEFAULT_IDLE_SPINS, DEFAULT_IDLE_YIELDS,
+// DEFAULT_IDLE_TIMEOUT_MS.
+void MS_SetIdlePolicy(int spins, int yields, int idle_timeout_ms);
+
+// Keep between "min_threads" and "max_threads" workers: a worker is
+// added whenever more tasks are queued than there are workers, up to
+// "max_threads", and idle ones retire down to "min_threads". 0 stands
+// for the number of CPUs, which is also the default for both.
+void MS_SetPoolSize(int min_threads, int max_threads);
+
+// Tasks and their metrics are recycled instead of freed: "allocated"
+// counts the ones malloc()ed, "recycled" the ones reused.
+typedef struct {
+  long allocated;
+  long recycled;
+} TaskPoolStats;
+
+TaskPoolStats MS_GetTaskPoolStats();
+
+// returns a finished (or never submitted) task to the pool
+void task_free(Task* task);
+
+//////// Optimizer ////////
+
+// Before an action runs, the graph below its RDD is rewritten: filters
+// after a partitionBy run before it, identity maps are skipped,
+// consecutive partitionBys become one, and a partitionBy of data
+// already partitioned with the same Partitioner, partition count and
+// ctx (e.g. a join input) is dropped. Enabled by default.
+void MS_SetOptimizer(int enabled);
+
 //////// MiniSpark ////////
 // Submits work to the thread pool to materialize "rdd".
 void execute(RDD* rdd);
 
+// RDD without dependencies whose partitions are already in place
+// ("partitions" holds "numpartitions" FILE*s or Lists), e.g. file and
+// stream sources.
+RDD* create_source_rdd(Transform t, void* fn, List* partitions, int numpartitions);
+
+// Waits until "rdd" was materialized, or failed.
+void wait_rdd(RDD* rdd);
+
+// Drops the materialized partitions of "rdd" and of all its
+// non-source dependencies so that the next execute() recomputes
+// them (used by streams between micro-batches). Elements are not
+// freed; they belong to the application.
+void rdd_reset(RDD* rdd);
+
+// Returns 1 if "rdd" was created by RDDFromFiles(), i.e. its
+// partitions are FILE*s rather than Lists of elements.
+int is_file_source(RDD* rdd);
+
+// The Mapper of RDDFromFiles() sources, returns its argument.
+void* identity(void* arg);
+
 // Creates the thread pool and monitoring thread.
 void MS_Run();
 
@@ -152,7 +423,7 @@ void MS_TearDown();
 //////// Work Queue methods   ////////////
 
 // create the work queue
-WorkQueue* work_queue_init();
+WorkQueue* work_queue_init(struct SchedPolicy* policy, int nworkers);
 
 // get rid of all the worker queues and free the memory
 void work_queue_destroy(WorkQueue* wq);
@@ -163,7 +434,8 @@ int work_queue_enqueue(WorkQueue* wq, Task* task);
 
 // remove task from the end of work queue and return task
 // must handle waiting if empty
-Task* work_queue_dequeue(WorkQueue* wq);
+// "worker" is the calling worker's id, or -1
+Task* work_queue_dequeue(WorkQueue* wq, int worker);
 
 //////// Metric Queue methods   ////////////
 
@@ -173,13 +445,15 @@ MetricQueue* metric_queue_init();
 // get rid of all the metrics in queue and free the memory
 void metric_queue_destroy(MetricQueue* mq);
 
-// add metric to the start of metric queue
+// copy "metric" into the queue, the caller keeps it. Waits for the
+// monitor if the queue is full.
 // returns 0 on success
 int metric_queue_enqueue(MetricQueue* mq, TaskMetric* metric);
 
-// remove metric from the end of metric queue and return TaskMetric
-// must handle waiting if empty
-TaskMetric* metric_queue_dequeue(MetricQueue* mq);
+// copy the oldest metric into "metric" without waiting. Only called by
+// the monitor.
+// returns 1 if there was one, 0 if the queue is empty
+int metric_queue_dequeue(MetricQueue* mq, TaskMetric* metric);
 
 //////// Worker Function ///////////////////
 void *worker_function(void *arg);
@@ -191,6 +465,7 @@ void *monitor_function(void *arg);
 
 // create the pool with
 // numthreads threads. Do any necessary allocations.
+// The pool may later grow up to the size set with MS_SetPoolSize().
 ThreadPool* thread_pool_init(int numthreads);
 
 // join all the threads and deallocate any
@@ -207,4 +482,9 @@ void thread_pool_wait();
 // returns 0 on success
 int thread_pool_submit(Task* task);
 
+// adds the "n" tasks chained from "first" through Task::next, e.g. a
+// whole stage, with one lock round trip and wakes no more workers than
+// there are tasks. returns 0 on success
+int thread_pool_submit_batch(Task* first, int n);
+
 #endif // __minispark_h__
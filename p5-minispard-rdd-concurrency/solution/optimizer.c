@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "optimizer.h"
+#include "profile.h"
+
+int optimizer_enabled = 1;
+
+void MS_SetOptimizer(int enabled) {
+  optimizer_enabled = enabled;
+}
+
+// a map that passes its elements through unchanged. Maps over
+// RDDFromFiles() turn FILE*s into elements, so they always stay.
+static int is_identity_map(RDD* rdd) {
+  return rdd->trans == MAP && rdd->fn == (void*)identity && rdd->numdependencies == 1
+    && !is_file_source(rdd->dependencies[0]);
+}
+
+// partitionBy output, possibly filtered, is still partitioned by the
+// same function; returns the partitionBy it comes from, or NULL
+static RDD* partitioned_by(RDD* rdd) {
+  while (rdd->trans == FILTER) {
+    rdd = rdd->dependencies[0];
+  }
+  return rdd->trans == PARTITIONBY ? rdd : NULL;
+}
+
+static void rewrite(RDD* rdd, PlanStats* stats) {
+  // consumers read through identity maps
+  for (int i = 0; i < rdd->numdependencies; i++) {
+    RDD* dep = rdd->dependencies[i];
+    while (!dep->complete && is_identity_map(dep)) {
+      dep = dep->dependencies[0];
+      stats->maps_removed++;
+    }
+    rdd->dependencies[i] = dep;
+  }
+
+  // filter(partitionBy(x)) -> partitionBy(filter(x)): filters work on
+  // single elements, so the dropped ones need not go through the shuffle.
+  // The partitionBy node is left alone since it may have other users.
+  if (rdd->trans == FILTER && !rdd->dependencies[0]->complete
+      && rdd->dependencies[0]->trans == PARTITIONBY) {
+    RDD* shuffle = rdd->dependencies[0];
+    RDD* pushed = filter(shuffle->dependencies[0], (Filter)rdd->fn, rdd->ctx);
+    rdd->trans = PARTITIONBY;
+    rdd->fn = shuffle->fn;
+    rdd->ctx = shuffle->ctx;
+    rdd->numpartitions = shuffle->numpartitions;
+    rdd->encode = shuffle->encode;
+    rdd->decode = shuffle->decode;
+    rdd->dependencies[0] = pushed;
+    stats->filters_pushed++;
+  }
+
+  if (rdd->trans == PARTITIONBY) {
+    RDD* dep = rdd->dependencies[0];
+    RDD* current = partitioned_by(dep);
+    if (current != NULL && current->fn == rdd->fn && current->ctx == rdd->ctx
+        && current->numpartitions == rdd->numpartitions) {
+      // every element already is in the partition it would be sent to,
+      // e.g. both sides of a join partitioned by the same key earlier
+      rdd->trans = MAP;
+      rdd->fn = (void*)identity;
+      rdd->ctx = NULL;
+      stats->shuffles_reused++;
+    } else if (!dep->complete && dep->trans == PARTITIONBY) {
+      // the second shuffle places every element on its own
+      rdd->dependencies[0] = dep->dependencies[0];
+      stats->shuffles_collapsed++;
+    }
+  }
+}
+
+static void optimize_rdd(RDD* rdd, PlanStats* stats) {
+  if (rdd->complete || rdd->numdependencies == 0) {
+    return;
+  }
+  for (int i = 0; i < rdd->numdependencies; i++) {
+    optimize_rdd(rdd->dependencies[i], stats);
+  }
+  rewrite(rdd, stats);
+}
+
+void optimize(RDD* rdd, PlanStats* stats) {
+  PlanStats ignored = {0};
+  if (!optimizer_enabled || rdd == NULL) {
+    return;
+  }
+  optimize_rdd(rdd, stats != NULL ? stats : &ignored);
+}
+
+//////// Semi-join filters ///////////////
+
+int bloom_join_enabled = 0;
+static BloomJoinStats bloom_stats;
+
+RDD* withJoinKey(RDD* join, KeyFn key, void* ctx) {
+  if (join->trans != JOIN) {
+    printf("error, RDD %p is not a join, key ignored\n", join);
+    return join;
+  }
+  join->join_key = key;
+  join->join_key_ctx = ctx;
+  return join;
+}
+
+void MS_SetBloomJoin(int enabled) {
+  bloom_join_enabled = enabled;
+}
+
+BloomJoinStats MS_GetBloomJoinStats() {
+  BloomJoinStats s;
+  s.joins = __atomic_load_n(&bloom_stats.joins, __ATOMIC_RELAXED);
+  s.keys = __atomic_load_n(&bloom_stats.keys, __ATOMIC_RELAXED);
+  s.probed = __atomic_load_n(&bloom_stats.probed, __ATOMIC_RELAXED);
+  s.passed = __atomic_load_n(&bloom_stats.passed, __ATOMIC_RELAXED);
+  return s;
+}
+
+void MS_ResetBloomJoinStats() {
+  __atomic_store_n(&bloom_stats.joins, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&bloom_stats.keys, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&bloom_stats.probed, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&bloom_stats.passed, 0, __ATOMIC_RELAXED);
+}
+
+// Filter on the larger input, ctx: `struct BloomJoin`
+static int BloomProbe(void* arg, void* ctx) {
+  struct BloomJoin* bj = (struct BloomJoin*)ctx;
+  size_t len;
+  const char* key = bj->key(arg, &len, bj->ctx);
+  int pass = bloom_contains(&bj->filter, sketch_hash(key, len));
+  __atomic_fetch_add(&bloom_stats.probed, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&bloom_stats.passed, pass, __ATOMIC_RELAXED);
+  return pass;
+}
+
+// what a join input is computed from before its shuffle
+static RDD* join_input(RDD* dep) {
+  return dep->trans == PARTITIONBY && !dep->complete ? dep->dependencies[0] : dep;
+}
+
+static long rdd_size(RDD* rdd) {
+  long n = 0;
+  for (ListNode* p = rdd->partitions->head; p != NULL; p = p->next) {
+    n += list_get_size((List*)p->data);
+  }
+  return n;
+}
+
+// computes "rdd", returns 0 unless it failed
+static int materialize(RDD* rdd) {
+  execute(rdd);
+  wait_rdd(rdd);
+  return rdd->failed ? -1 : 0;
+}
+
+// fills bj->filter with the keys of bj->source, which is materialized
+static int bloom_build(struct BloomJoin* bj) {
+  bloom_free(&bj->filter);
+  if (bloom_init(&bj->filter, rdd_size(bj->source), BLOOM_JOIN_FPP) != 0) {
+    return -1;
+  }
+  long keys = 0;
+  for (ListNode* p = bj->source->partitions->head; p != NULL; p = p->next) {
+    for (ListNode* node = ((List*)p->data)->head; node != NULL; node = node->next) {
+      size_t len;
+      const char* key = bj->key(node->data, &len, bj->ctx);
+      bloom_add(&bj->filter, sketch_hash(key, len));
+      keys++;
+    }
+  }
+  __atomic_fetch_add(&bloom_stats.keys, keys, __ATOMIC_RELAXED);
+  return 0;
+}
+
+void bloom_pushdown(RDD* join) {
+  if (!bloom_join_enabled || join->join_key == NULL || join->complete) {
+    return;
+  }
+  struct BloomJoin* bj = join->bloom;
+  if (bj != NULL) {
+    // the larger input already reads through the filter, refresh it
+    if (materialize(bj->source) != 0 || bloom_build(bj) != 0) {
+      printf("error rebuilding the semi-join filter of RDD %p\n", join);
+    }
+    return;
+  }
+
+  RDD* in[2] = {join_input(join->dependencies[0]), join_input(join->dependencies[1])};
+  if (is_file_source(in[0]) || is_file_source(in[1])
+      || materialize(in[0]) != 0 || materialize(in[1]) != 0) {
+    return; // the join fails or runs unfiltered
+  }
+  int small = rdd_size(in[0]) <= rdd_size(in[1]) ? 0 : 1;
+  bj = calloc(1, sizeof(struct BloomJoin));
+  if (bj == NULL) {
+    return;
+  }
+  bj->source = in[small];
+  bj->key = join->join_key;
+  bj->ctx = join->join_key_ctx;
+  if (bloom_build(bj) != 0) {
+    printf("error building the semi-join filter of RDD %p\n", join);
+    free(bj);
+    return;
+  }
+
+  // a new partitionBy over the filtered input, since the old one may
+  // have other users
+  RDD* large = join->dependencies[1 - small];
+  RDD* probe = filter(in[1 - small], BloomProbe, bj);
+  if (large != in[1 - small]) {
+    RDD* shuffle = partitionBy(probe, (Partitioner)large->fn, large->numpartitions, large->ctx);
+    shuffle->encode = large->encode;
+    shuffle->decode = large->decode;
+    probe = shuffle;
+  }
+  join->dependencies[1 - small] = probe;
+  join->bloom = bj;
+  __atomic_fetch_add(&bloom_stats.joins, 1, __ATOMIC_RELAXED);
+}
+
+// partitions "rdd" will have once executed
+static int planned_partitions(RDD* rdd) {
+  if (rdd->numpartitions > 0 || rdd->numdependencies == 0) {
+    return rdd->numpartitions;
+  }
+  if (rdd->trans == UNION) {
+    return planned_partitions(rdd->dependencies[0]) + planned_partitions(rdd->dependencies[1]);
+  }
+  return planned_partitions(rdd->dependencies[0]);
+}
+
+static void explain_rdd(RDD* rdd, int depth) {
+  static const char* names[] = {"Map", "Filter", "Join", "PartitionBy", "Stream", "MapPartitions", "SortMergeJoin", "Union", "ZipPartitions"};
+  char fn[128];
+  profile_symbol(rdd->fn, fn, sizeof(fn));
+
+  printf("%*s%s", 2 * depth, "", depth > 0 ? "+- " : "");
+  if (is_file_source(rdd)) {
+    printf("Files %p", rdd);
+  } else if (rdd->numdependencies == 0) {
+    printf("%s %p", names[rdd->trans], rdd);
+  } else if (rdd->trans == MAP && rdd->fn == (void*)identity) {
+    printf("Identity %p", rdd);
+  } else if (rdd->trans == UNION) {
+    printf("Union %p", rdd);
+  } else {
+    printf("%s %p %s", names[rdd->trans], rdd, fn);
+  }
+  printf(" [%d partitions]%s\n", planned_partitions(rdd), rdd->complete ? " (materialized)" : "");
+  for (int i = 0; i < rdd->numdependencies; i++) {
+    explain_rdd(rdd->dependencies[i], depth + 1);
+  }
+}
+
+void explain(RDD* rdd) {
+  PlanStats stats = {0};
+  optimize(rdd, &stats);
+  printf("== plan for RDD %p ==\n", rdd);
+  explain_rdd(rdd, 0);
+  if (optimizer_enabled) {
+    printf("filters pushed: %d, identity maps removed: %d, shuffles collapsed: %d, shuffles reused: %d\n",
+           stats.filters_pushed, stats.maps_removed, stats.shuffles_collapsed, stats.shuffles_reused);
+  } else {
+    printf("optimizer disabled\n");
+  }
+}
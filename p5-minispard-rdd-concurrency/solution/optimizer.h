@@ -0,0 +1,65 @@
+// rule-based rewrites of the RDD graph before it is executed
+#ifndef __optimizer_h__
+#define __optimizer_h__
+
+#include "minispark.h"
+#include "sketch.h"
+
+#define BLOOM_JOIN_FPP (0.01) // false positive rate of semi-join filters
+
+// number of times each rule fired
+typedef struct {
+  int filters_pushed; // filter moved below the partitionBy it followed
+  int maps_removed; // identity map skipped by its consumer
+  int shuffles_collapsed; // partitionBy of a partitionBy reads the input of the first one
+  int shuffles_reused; // partitionBy of data already partitioned the same way
+} PlanStats;
+
+// 0 when the optimizer is off
+extern int optimizer_enabled;
+
+// Rewrite the unmaterialized part of the graph below "rdd" in place,
+// adding the rules that fired to "stats" (may be NULL). Nodes are
+// never freed or changed into something computing different elements,
+// so RDDs the application still holds stay valid. Does nothing if the
+// optimizer is off.
+void optimize(RDD* rdd, PlanStats* stats);
+
+// A join whose larger input goes through a filter keeping only elements
+// whose key may be in the smaller input. "filter" is rebuilt from
+// "source" whenever the join runs again (e.g. after rdd_reset()).
+struct BloomJoin {
+  BloomFilter filter;
+  RDD* source; // pre-shuffle smaller input the filter is built from
+  KeyFn key;
+  void* ctx;
+};
+
+typedef struct {
+  long joins; // joins that got a filter
+  long keys; // keys added to filters
+  long probed; // elements of the larger inputs checked
+  long passed; // ... that may have a match, and went on to the shuffle
+} BloomJoinStats;
+
+// 0 when semi-join filters are off
+extern int bloom_join_enabled;
+
+// Sets the key both inputs of "join" are joined on, which lets it use
+// a semi-join filter (see MS_SetBloomJoin()). Returns "join".
+RDD* withJoinKey(RDD* join, KeyFn key, void* ctx);
+
+// With semi-join filters enabled, a join with a key (see withJoinKey())
+// computes its inputs up to their shuffles first, builds a Bloom filter
+// of the keys of the smaller one, and filters the larger one with it
+// before its partitionBy, so elements without a match are neither
+// shuffled nor scanned by the join. Off by default.
+void MS_SetBloomJoin(int enabled);
+
+BloomJoinStats MS_GetBloomJoinStats();
+void MS_ResetBloomJoinStats();
+
+// called by execute() before the inputs of "join" run
+void bloom_pushdown(RDD* join);
+
+#endif // __optimizer_h__
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "output.h"
+#include "lib.h"
+
+// formatted text of a partition, or the part of it not written yet
+typedef struct {
+  char* data;
+  size_t len;
+  size_t cap;
+} TextBuffer;
+
+struct output_ctx {
+  Formatter fmt;
+  const char* dir; // saveAsTextFile() only
+  long written; // elements saveAsTextFile() wrote
+};
+
+// writes the buffered text to "fp" and empties the buffer
+static int flush_text(TextBuffer* tb, FILE* fp) {
+  if (tb->len > 0 && fwrite(tb->data, 1, tb->len, fp) != tb->len) {
+    return -1;
+  }
+  tb->len = 0;
+  return 0;
+}
+
+// appends the text of "elem" to "tb". If it does not fit, the buffer is
+// flushed to "fp" first, or grown when "fp" is NULL. returns 0 on success
+static int append_text(TextBuffer* tb, void* elem, Formatter fmt, FILE* fp) {
+  size_t n = fmt(elem, tb->data + tb->len, tb->cap - tb->len);
+  if (n <= tb->cap - tb->len) {
+    tb->len += n;
+    return 0;
+  }
+  if (fp != NULL && flush_text(tb, fp) != 0) {
+    return -1;
+  }
+  if (n > tb->cap - tb->len) {
+    size_t cap = tb->cap * 2 > tb->len + n ? tb->cap * 2 : tb->len + n;
+    char* data = realloc(tb->data, cap);
+    if (data == NULL) {
+      return -1;
+    }
+    tb->data = data;
+    tb->cap = cap;
+  }
+  tb->len += fmt(elem, tb->data + tb->len, tb->cap - tb->len);
+  return 0;
+}
+
+// PartitionMapper of printFormatted(): one TextBuffer per partition
+static int FormatPartition(void* input, List* output, void* ctx) {
+  struct output_ctx* octx = (struct output_ctx*)ctx;
+  TextBuffer* tb = malloc(sizeof(TextBuffer));
+  if (tb == NULL) {
+    return -1;
+  }
+  tb->len = 0;
+  tb->cap = OUTPUT_BUFFER_BYTES;
+  tb->data = malloc(tb->cap);
+  if (tb->data == NULL) {
+    free(tb);
+    return -1;
+  }
+  for (ListNode* node = ((List*)input)->head; node != NULL; node = node->next) {
+    if (append_text(tb, node->data, octx->fmt, NULL) != 0) {
+      goto fail;
+    }
+  }
+  if (list_add_elem(output, tb) == 0) {
+    return 0;
+  }
+
+fail:
+  free(tb->data);
+  free(tb);
+  return -1;
+}
+
+// PartitionMapper of saveAsTextFile(): writes the partition to its file
+static int WritePartition(void* input, List* output, void* ctx) {
+  (void)output;
+  struct output_ctx* octx = (struct output_ctx*)ctx;
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/part-%05d", octx->dir, MS_TaskPartition());
+  FILE* fp = fopen(path, "w");
+  if (fp == NULL) {
+    perror("fopen");
+    return -1;
+  }
+  // the buffer already batches the writes
+  setvbuf(fp, NULL, _IONBF, 0);
+  int ret = -1;
+  TextBuffer tb = {malloc(OUTPUT_BUFFER_BYTES), 0, OUTPUT_BUFFER_BYTES};
+  if (tb.data == NULL) {
+    goto cleanup;
+  }
+  for (ListNode* node = ((List*)input)->head; node != NULL; node = node->next) {
+    if (append_text(&tb, node->data, octx->fmt, fp) != 0) {
+      goto cleanup;
+    }
+  }
+  ret = flush_text(&tb, fp);
+  if (ret == 0) {
+    __atomic_fetch_add(&octx->written, list_get_size((List*)input), __ATOMIC_RELAXED);
+  }
+
+cleanup:
+  if (fclose(fp) != 0) {
+    ret = -1;
+  }
+  if (ret != 0) {
+    printf("error writing %s\n", path);
+  }
+  free(tb.data);
+  return ret;
+}
+
+// runs "fn" over every partition of "rdd"; returns the RDD holding its
+// outputs, or NULL
+static RDD* output_partitions(RDD* rdd, PartitionMapper fn, struct output_ctx* octx) {
+  if (is_file_source(rdd)) {
+    printf("error, RDD %p holds files, not elements\n", rdd);
+    return NULL;
+  }
+  RDD* out = mapPartitions(rdd, fn, octx);
+  return count(out) < 0 ? NULL : out;
+}
+
+long saveAsTextFile(RDD* dataset, const char* dir, Formatter fmt) {
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    perror("mkdir");
+    return -1;
+  }
+  struct output_ctx octx = {fmt, dir, 0};
+  if (output_partitions(dataset, WritePartition, &octx) == NULL) {
+    return -1;
+  }
+  return octx.written;
+}
+
+void printFormatted(RDD* dataset, Formatter fmt) {
+  struct output_ctx octx = {fmt, NULL, 0};
+  RDD* texts = output_partitions(dataset, FormatPartition, &octx);
+  if (texts == NULL) {
+    return;
+  }
+  for (ListNode* p = texts->partitions->head; p != NULL; p = p->next) {
+    for (ListNode* node = ((List*)p->data)->head; node != NULL; node = node->next) {
+      TextBuffer* tb = (TextBuffer*)node->data;
+      flush_text(tb, stdout);
+      free(tb->data);
+      free(tb);
+    }
+  }
+}
+
+//////// Formatters ///////////////
+
+size_t StringFormatter(void* arg, char* buf, size_t cap) {
+  const char* str = (const char*)arg;
+  size_t len = strlen(str);
+  if (len <= cap) {
+    memcpy(buf, str, len);
+  }
+  return len;
+}
+
+size_t RowFormatter(void* arg, char* buf, size_t cap) {
+  struct row* row = (struct row*)arg;
+  size_t len = 0;
+  for (int i = 0; i < row->ncols; i++) {
+    size_t n = strlen(row->cols[i]);
+    if (len + n + 1 <= cap) {
+      memcpy(buf + len, row->cols[i], n);
+      buf[len + n] = i + 1 < row->ncols ? '\t' : '\n';
+    }
+    len += n + 1;
+  }
+  if (row->ncols == 0) {
+    if (cap > 0) {
+      buf[0] = '\n';
+    }
+    len = 1;
+  }
+  return len;
+}
@@ -0,0 +1,27 @@
+// text output formatted by the workers: saveAsTextFile and printFormatted
+#ifndef __output_h__
+#define __output_h__
+
+#include "minispark.h"
+
+#define OUTPUT_BUFFER_BYTES (1 << 20) // formatted bytes a writer collects before each write
+
+// Write "dataset" as text to "dir" (created if needed), one file per
+// partition named part-00000, part-00001, ... Every partition is
+// formatted with "fmt" and written by the worker that computes it, in
+// writes of about OUTPUT_BUFFER_BYTES. Returns the number of elements
+// written, or -1 on failure.
+long saveAsTextFile(RDD* dataset, const char* dir, Formatter fmt);
+
+// Like print(), but the workers format the partitions into buffers in
+// parallel; the calling thread only writes the buffers to stdout in
+// partition order.
+void printFormatted(RDD* dataset, Formatter fmt);
+
+// Formatters
+// arg: char*, written as it is (like StringPrinter)
+size_t StringFormatter(void* arg, char* buf, size_t cap);
+// arg: `struct row`, tab-separated columns and a '\n' (like RowPrinter)
+size_t RowFormatter(void* arg, char* buf, size_t cap);
+
+#endif // __output_h__
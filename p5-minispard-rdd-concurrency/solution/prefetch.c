@@ -0,0 +1,231 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "prefetch.h"
+
+static int prefetch_threads = DEFAULT_PREFETCH_THREADS;
+static PrefetchStats stats;
+
+// queued reads and the I/O threads working on them
+static struct {
+  pthread_t* threads;
+  int nthreads; // 0 when stopped
+  Task* head; // FIFO of tasks waiting for their input
+  Task* tail;
+  long buffered; // bytes read ahead and not released yet
+  int shutdown;
+  pthread_mutex_t lock;
+  pthread_cond_t queued; // a task was queued, or shutdown
+  pthread_cond_t released; // "buffered" went down
+} io = {NULL, 0, NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+void MS_SetPrefetch(int threads) {
+  prefetch_threads = threads < 0 ? 0 : threads;
+}
+
+PrefetchStats MS_GetPrefetchStats() {
+  PrefetchStats s;
+  s.ranges = __atomic_load_n(&stats.ranges, __ATOMIC_RELAXED);
+  s.bytes = __atomic_load_n(&stats.bytes, __ATOMIC_RELAXED);
+  s.stalls = __atomic_load_n(&stats.stalls, __ATOMIC_RELAXED);
+  return s;
+}
+
+void MS_ResetPrefetchStats() {
+  __atomic_store_n(&stats.ranges, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats.bytes, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats.stalls, 0, __ATOMIC_RELAXED);
+}
+
+int read_line_range(int fd, long start, long end, char** buf, long* begin, long* stop) {
+  long from = start > 0 ? start - 1 : 0; // one byte back to see if a line starts at "start"
+  size_t cap = end - from + 4096;
+  size_t len = 0;
+  *buf = malloc(cap);
+  if (*buf == NULL) {
+    return -1;
+  }
+  *stop = -1; // one past the '\n' ending the line that contains byte end - 1
+  while (*stop < 0) {
+    if (len == cap) {
+      char* bigger = realloc(*buf, cap * 2);
+      if (bigger == NULL) {
+        return -1;
+      }
+      *buf = bigger;
+      cap *= 2;
+    }
+    ssize_t n = pread(fd, *buf + len, cap - len, from + len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return -1;
+    }
+    long scan_from = (long)len > end - 1 - from ? (long)len : end - 1 - from;
+    len += n;
+    char* nl = (long)len > scan_from ? memchr(*buf + scan_from, '\n', len - scan_from) : NULL;
+    if (nl != NULL) {
+      *stop = nl - *buf + 1;
+    } else if (n == 0) {
+      *stop = len; // last line without '\n'
+    }
+  }
+
+  *begin = 0;
+  if (start > 0) {
+    char* nl = memchr(*buf, '\n', *stop);
+    *begin = nl == NULL ? *stop : nl - *buf + 1;
+  }
+  return 0;
+}
+
+// reads the input of "task" into task->input. A whole partition leaves
+// its FILE* where the Mapper would have, at the end of the file.
+// returns 0 on success
+static int read_task_input(Task* task) {
+  FILE* fp = (FILE*)list_get(task->rdd->dependencies[0]->partitions, task->pnum);
+  long begin, stop;
+  if (read_line_range(fileno(fp), task->start, task->end, &task->input, &begin, &stop) != 0) {
+    free(task->input);
+    task->input = NULL;
+    return -1;
+  }
+  if (task->morsel < 0 && fseek(fp, stop, SEEK_SET) != 0) {
+    free(task->input);
+    task->input = NULL;
+    return -1;
+  }
+  task->input_begin = begin;
+  task->input_end = stop;
+  return 0;
+}
+
+static void* io_function(void* arg) {
+  (void)arg;
+  pthread_mutex_lock(&io.lock);
+  while (1) {
+    while (io.head == NULL && !io.shutdown) {
+      pthread_cond_wait(&io.queued, &io.lock);
+    }
+    if (io.head == NULL) {
+      break;
+    }
+    Task* task = io.head;
+    io.head = task->next;
+    if (io.head == NULL) {
+      io.tail = NULL;
+    }
+    task->next = NULL;
+    long want = task->end - task->start;
+    if (io.buffered > 0 && io.buffered + want > PREFETCH_MAX_BYTES) {
+      __atomic_fetch_add(&stats.stalls, 1, __ATOMIC_RELAXED);
+      while (io.buffered > 0 && io.buffered + want > PREFETCH_MAX_BYTES) {
+        pthread_cond_wait(&io.released, &io.lock);
+      }
+    }
+    io.buffered += want;
+    pthread_mutex_unlock(&io.lock);
+
+    // on failure the worker reads the input itself
+    int ret = read_task_input(task);
+    pthread_mutex_lock(&io.lock);
+    io.buffered += (ret == 0 ? task->input_end : 0) - want;
+    pthread_mutex_unlock(&io.lock);
+    if (ret == 0) {
+      __atomic_fetch_add(&stats.ranges, 1, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&stats.bytes, task->input_end - task->input_begin, __ATOMIC_RELAXED);
+    }
+    if (thread_pool_submit(task) != 0) {
+      printf("failed to submit task for RDD %p, partition %i\n", task->rdd, task->pnum);
+      prefetch_release(task);
+      task_free(task);
+    }
+    pthread_mutex_lock(&io.lock);
+  }
+  pthread_mutex_unlock(&io.lock);
+  return NULL;
+}
+
+void prefetch_start() {
+  pthread_mutex_lock(&io.lock);
+  if (io.nthreads == 0 && prefetch_threads > 0) {
+    io.threads = malloc(prefetch_threads * sizeof(pthread_t));
+    io.shutdown = 0;
+    for (int i = 0; io.threads != NULL && i < prefetch_threads; i++) {
+      if (pthread_create(&io.threads[i], NULL, io_function, NULL) != 0) {
+        printf("error creating I/O thread %i\n", i);
+        break;
+      }
+      io.nthreads++;
+    }
+  }
+  pthread_mutex_unlock(&io.lock);
+}
+
+void prefetch_stop() {
+  pthread_mutex_lock(&io.lock);
+  io.shutdown = 1;
+  pthread_cond_broadcast(&io.queued);
+  int nthreads = io.nthreads;
+  pthread_mutex_unlock(&io.lock);
+  for (int i = 0; i < nthreads; i++) {
+    pthread_join(io.threads[i], NULL);
+  }
+  pthread_mutex_lock(&io.lock);
+  free(io.threads);
+  io.threads = NULL;
+  io.nthreads = 0;
+  pthread_mutex_unlock(&io.lock);
+}
+
+int prefetch_submit(Task* task) {
+  RDD* source = task->rdd->dependencies[0];
+  if (task->rdd->trans != MAP || !is_file_source(source)) {
+    return -1;
+  }
+  FILE* fp = (FILE*)list_get(source->partitions, task->pnum);
+  if (task->morsel < 0) {
+    // the Mapper would start wherever the FILE* is
+    struct stat st;
+    if (fp == NULL || ftell(fp) != 0 || fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode)) {
+      return -1;
+    }
+    task->start = 0;
+    task->end = st.st_size;
+  }
+  if (task->end - task->start > PREFETCH_MAX_BYTES) {
+    return -1; // the worker reads it, not held in memory beside other ranges
+  }
+  pthread_mutex_lock(&io.lock);
+  if (io.nthreads == 0 || io.shutdown) {
+    pthread_mutex_unlock(&io.lock);
+    return -1;
+  }
+  task->next = NULL;
+  if (io.tail == NULL) {
+    io.head = task;
+  } else {
+    io.tail->next = task;
+  }
+  io.tail = task;
+  pthread_cond_signal(&io.queued);
+  pthread_mutex_unlock(&io.lock);
+  return 0;
+}
+
+void prefetch_release(Task* task) {
+  if (task->input == NULL) {
+    return;
+  }
+  free(task->input);
+  task->input = NULL;
+  pthread_mutex_lock(&io.lock);
+  io.buffered -= task->input_end;
+  pthread_cond_broadcast(&io.released);
+  pthread_mutex_unlock(&io.lock);
+}
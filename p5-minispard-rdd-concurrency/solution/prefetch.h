@@ -0,0 +1,50 @@
+// read-ahead of RDDFromFiles() inputs by dedicated I/O threads
+#ifndef __prefetch_h__
+#define __prefetch_h__
+
+#include "minispark.h"
+
+#define DEFAULT_PREFETCH_THREADS (0)
+#define PREFETCH_MAX_BYTES (64L << 20) // read ahead but not parsed yet
+
+typedef struct {
+  long ranges; // partitions and byte morsels read ahead
+  long bytes;
+  long stalls; // reads that waited for PREFETCH_MAX_BYTES to free up
+} PrefetchStats;
+
+// Maps over RDDFromFiles() sources read their input ahead on "threads"
+// I/O threads instead of on the compute workers: a task is only queued
+// for the workers once the lines it parses are in memory, and its
+// Mapper reads them from a memory stream. Whole partitions are read
+// ahead when their FILE* is at the start of a regular file, byte
+// morsels (see MS_SetMorselSize()) always; anything else is read by the
+// worker as before, and so are ranges over PREFETCH_MAX_BYTES. The
+// Mapper gets a memory stream instead of the partition's FILE* (see
+// RDDFromFiles()), so read-ahead is off unless asked for: 0 threads
+// disables it. Takes effect at the next MS_Run(); defaults to
+// DEFAULT_PREFETCH_THREADS.
+void MS_SetPrefetch(int threads);
+
+PrefetchStats MS_GetPrefetchStats();
+void MS_ResetPrefetchStats();
+
+// Reads the lines of "fd" that start in [start, end) into "*buf", whose
+// bytes [*begin, *stop) hold them; "*buf" has to be freed. Returns 0 on
+// success.
+int read_line_range(int fd, long start, long end, char** buf, long* begin, long* stop);
+
+// starts and stops the I/O threads, called by MS_Run() and MS_TearDown().
+// Stopping finishes the reads already queued.
+void prefetch_start();
+void prefetch_stop();
+
+// Queues the read of the input of "task", a map over a file source,
+// and submits the task to the thread pool once it is done. Returns -1
+// if the input is not read ahead, and the caller submits the task.
+int prefetch_submit(Task* task);
+
+// frees the input read ahead for "task", if any
+void prefetch_release(Task* task);
+
+#endif // __prefetch_h__
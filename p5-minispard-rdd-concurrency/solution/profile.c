@@ -0,0 +1,84 @@
+#define _GNU_SOURCE
+#include "profile.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <dlfcn.h>
+
+int profile_every = 0;
+__thread unsigned long profile_tick = 0;
+
+typedef struct {
+  void* fn;
+  long calls;
+  long outputs;
+  long samples;
+  long sampled_ns;
+} ProfileEntry;
+
+// open addressing on the function pointer
+static ProfileEntry profile_table[MAXPROFILED];
+static int profile_entries = 0;
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void profile_enable(int sample_every) {
+  profile_every = sample_every < 0 ? 0 : sample_every;
+}
+
+void profile_flush(ProfileScope* ps) {
+  if (profile_every == 0 || ps->calls == 0) {
+    return;
+  }
+  pthread_mutex_lock(&profile_lock);
+  unsigned long h = ((uintptr_t)ps->fn >> 4) % MAXPROFILED;
+  for (int i = 0; i < MAXPROFILED; i++) {
+    ProfileEntry* e = &profile_table[(h + i) % MAXPROFILED];
+    if (e->fn == NULL) {
+      e->fn = ps->fn;
+      profile_entries++;
+    }
+    if (e->fn == ps->fn) {
+      e->calls += ps->calls;
+      e->outputs += ps->outputs;
+      e->samples += ps->samples;
+      e->sampled_ns += ps->sampled_ns;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&profile_lock);
+}
+
+// name of "fn" from the dynamic symbol table (needs -rdynamic for
+// functions in the executable), or its address
+void profile_symbol(void* fn, char* buf, size_t len) {
+  Dl_info info;
+  if (dladdr(fn, &info) != 0 && info.dli_sname != NULL) {
+    snprintf(buf, len, "%s", info.dli_sname);
+  } else {
+    snprintf(buf, len, "%p", fn);
+  }
+}
+
+void profile_report() {
+  pthread_mutex_lock(&profile_lock);
+  if (profile_entries > 0) {
+    fprintf(stderr, "%-28s %12s %10s %14s %12s %12s %8s\n",
+            "function", "calls", "samples", "est. cpu (ms)", "usec/call", "outputs", "fan-out");
+    for (int i = 0; i < MAXPROFILED; i++) {
+      ProfileEntry* e = &profile_table[i];
+      if (e->fn == NULL) {
+        continue;
+      }
+      char name[64];
+      profile_symbol(e->fn, name, sizeof(name));
+      double per_call_us = e->samples ? (double)e->sampled_ns / e->samples / 1000.0 : 0;
+      fprintf(stderr, "%-28s %12ld %10ld %14.3f %12.3f %12ld %8.3f\n",
+              name, e->calls, e->samples, per_call_us * e->calls / 1000.0,
+              per_call_us, e->outputs, (double)e->outputs / e->calls);
+      e->fn = NULL;
+      e->calls = e->outputs = e->samples = e->sampled_ns = 0;
+    }
+    profile_entries = 0;
+  }
+  pthread_mutex_unlock(&profile_lock);
+}
@@ -0,0 +1,78 @@
+// sampling profiler for user functions
+#ifndef __profile_h__
+#define __profile_h__
+
+#include <time.h>
+
+#define MAXPROFILED (256) // distinct user functions tracked
+
+// Per-task counters for one user function. Helpers keep one of these on
+// the stack and flush it once when the task is done, so the hot path
+// only touches thread-local memory. Every "profile_every"th call is
+// timed with the thread's CPU clock and the total is extrapolated from
+// those samples.
+typedef struct {
+  void* fn;
+  long calls;
+  long outputs; // elements produced, for fan-out
+  long samples;
+  long sampled_ns;
+  struct timespec start;
+  int sampling;
+} ProfileScope;
+
+// 0 when profiling is off
+extern int profile_every;
+// calls seen by this thread, so sampling stays uniform across short tasks
+extern __thread unsigned long profile_tick;
+
+// time 1 out of every "sample_every" calls of each user function;
+// 0 disables profiling
+void profile_enable(int sample_every);
+
+static inline void profile_begin(ProfileScope* ps, void* fn) {
+  ps->fn = fn;
+  ps->calls = 0;
+  ps->outputs = 0;
+  ps->samples = 0;
+  ps->sampled_ns = 0;
+  ps->sampling = 0;
+}
+
+// call right before invoking the user function
+static inline void profile_before(ProfileScope* ps) {
+  if (profile_every > 0 && profile_tick++ % profile_every == 0) {
+    ps->sampling = 1;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ps->start);
+  }
+}
+
+// call right after it returned, with the number of elements it produced
+static inline void profile_after(ProfileScope* ps, long outputs) {
+  if (ps->sampling) {
+    struct timespec end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    ps->sampled_ns += (end.tv_sec - ps->start.tv_sec) * 1000000000L + (end.tv_nsec - ps->start.tv_nsec);
+    ps->samples++;
+    ps->sampling = 0;
+  }
+  ps->calls++;
+  ps->outputs += outputs;
+}
+
+// call instead of profile_after() when the call does not count
+static inline void profile_discard(ProfileScope* ps) {
+  ps->sampling = 0;
+}
+
+// add the task's counters to the process-wide table
+void profile_flush(ProfileScope* ps);
+
+// name of "fn" from the dynamic symbol table (needs -rdynamic for
+// functions in the executable), or its address
+void profile_symbol(void* fn, char* buf, size_t len);
+
+// print the per-function summary to stderr and clear the table
+void profile_report();
+
+#endif // __profile_h__
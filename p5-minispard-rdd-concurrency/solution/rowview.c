@@ -0,0 +1,226 @@
+#define _GNU_SOURCE
+#include "rowview.h"
+#include "tokenize.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// read all of "fp" into one buffer, returns its length or -1
+static long read_all(FILE* fp, char** out) {
+  struct stat st;
+  size_t cap = 1 << 16;
+  if (fstat(fileno(fp), &st) == 0 && st.st_size > 0) {
+    cap = st.st_size + 1;
+  }
+  char* buf = malloc(cap);
+  if (buf == NULL) {
+    return -1;
+  }
+  size_t len = 0;
+  size_t n;
+  while ((n = fread(buf + len, 1, cap - len, fp)) > 0) {
+    len += n;
+    if (len == cap) { // file grew or size unknown
+      char* bigger = realloc(buf, cap * 2);
+      if (bigger == NULL) {
+        free(buf);
+        return -1;
+      }
+      buf = bigger;
+      cap *= 2;
+    }
+  }
+  buf[len] = '\0'; // lets atoi() run off the end of the last column
+  *out = buf;
+  return len;
+}
+
+// appends views[0, n) to "output". On error nothing is added and the
+// views and "buf" are freed. returns 0 on success
+static int add_views(List* output, struct rowview* views, int n, char* buf) {
+  List* added = list_init();
+  for (int i = 0; added != NULL && i < n; i++) {
+    if (list_add_elem(added, &views[i]) != 0) {
+      list_free(added);
+      added = NULL;
+    }
+  }
+  if (added == NULL) {
+    free(views);
+    free(buf);
+    return -1;
+  }
+  list_concat(output, added); // frees "added"
+  return 0;
+}
+
+int GetLineViews(void* input, List* output, void* ctx) {
+  (void)ctx;
+  char* buf;
+  long len = read_all((FILE*)input, &buf);
+  if (len < 0) {
+    return -1;
+  }
+
+  int nlines = 0;
+  for (const char* p = buf; p < buf + len; nlines++) {
+    const char* nl = memchr(p, '\n', buf + len - p);
+    p = nl ? nl + 1 : buf + len;
+  }
+  if (nlines == 0) {
+    free(buf);
+    return 0;
+  }
+
+  // the buffer and the view array live as long as the views do
+  struct rowview* views = malloc(nlines * sizeof(struct rowview));
+  if (views == NULL) {
+    free(buf);
+    return -1;
+  }
+  const char* p = buf;
+  for (int i = 0; i < nlines; i++) {
+    const char* nl = memchr(p, '\n', buf + len - p);
+    const char* end = nl ? nl + 1 : buf + len;
+    views[i].line = p;
+    views[i].len = end - p;
+    views[i].ncols = 0;
+    p = end;
+  }
+  return add_views(output, views, nlines, buf);
+}
+
+int GetRowViews(void* input, List* output, void* ctx) {
+  TokenFormat fmt = ctx != NULL ? *(TokenFormat*)ctx : TOKENIZE_WHITESPACE;
+  char* buf;
+  long len = read_all((FILE*)input, &buf);
+  if (len < 0) {
+    return -1;
+  }
+  int maxlines = tokenize_count_lines(buf, len);
+  if (maxlines == 0) {
+    free(buf);
+    return 0;
+  }
+  // the buffer and the view array live as long as the views do
+  struct rowview* views = malloc(maxlines * sizeof(struct rowview));
+  if (views == NULL) {
+    free(buf);
+    return -1;
+  }
+  int nlines = tokenize_lines(buf, len, fmt, views, maxlines);
+  if (nlines < 0) {
+    free(views);
+    free(buf);
+    return -1;
+  }
+  return add_views(output, views, nlines, buf);
+}
+
+void FreeRowViews(void* first) {
+  struct rowview* views = (struct rowview*)first;
+  if (views == NULL) {
+    return;
+  }
+  free((char*)views->line);
+  free(views);
+}
+
+static int is_delim(char c) {
+  return c == ' ' || c == '\t' || c == '\n';
+}
+
+void* SplitColsView(void* arg) {
+  struct rowview* row = (struct rowview*)arg;
+  int nc = 0;
+  int i = 0;
+  while (i < row->len && nc < MAXCOLS) {
+    while (i < row->len && is_delim(row->line[i])) {
+      i++;
+    }
+    if (i == row->len) {
+      break;
+    }
+    int start = i;
+    while (i < row->len && !is_delim(row->line[i])) {
+      i++;
+    }
+    row->offs[nc] = start;
+    row->lens[nc++] = i - start;
+  }
+  row->ncols = nc;
+  return row;
+}
+
+int StringContainsView(void* arg, void* needle) {
+  struct rowview* row = (struct rowview*)arg;
+  return memmem(row->line, row->len, needle, strlen((char*)needle)) != NULL;
+}
+
+void* SumJoinView(void* row1, void* row2, void* ctx) {
+  struct sumjoin_ctx* c = (struct sumjoin_ctx*)ctx;
+  struct rowview* data1 = (struct rowview*)row1;
+  struct rowview* data2 = (struct rowview*)row2;
+  int k = c->keynum;
+  int t = c->target;
+  // short or blank lines have no such columns
+  if (k >= data1->ncols || k >= data2->ncols || t >= data1->ncols || t >= data2->ncols) {
+    return NULL;
+  }
+
+  int keylen = data1->lens[k] < MAXLEN - 1 ? data1->lens[k] : MAXLEN - 1;
+  int keylen2 = data2->lens[k] < MAXLEN - 1 ? data2->lens[k] : MAXLEN - 1;
+  if (keylen != keylen2 || memcmp(data1->line + data1->offs[k], data2->line + data2->offs[k], keylen) != 0) {
+    return NULL;
+  }
+
+  // the sum is new data, so the result is a regular row
+  struct row* row = malloc(sizeof(struct row));
+  if (row == NULL) {
+    return NULL;
+  }
+  int res = atoi(data1->line + data1->offs[t]) + atoi(data2->line + data2->offs[t]);
+  memcpy(row->cols[0], data1->line + data1->offs[k], keylen);
+  row->cols[0][keylen] = '\0';
+  snprintf(row->cols[1], MAXLEN, "%d", res);
+  row->ncols = 2;
+  return row;
+}
+
+unsigned long ColumnHashPartitionerView(void* arg, int numpartitions, void* ctx) {
+  struct colpart_ctx* c = (struct colpart_ctx*)ctx;
+  struct rowview* row = (struct rowview*)arg;
+
+  // hash only what SplitCols() would have kept of the column; rows
+  // without it hash like an empty key
+  unsigned long hash = 5381;
+  if (c->keynum >= row->ncols) {
+    return hash % numpartitions;
+  }
+  const char* key = row->line + row->offs[c->keynum];
+  int len = row->lens[c->keynum] < MAXLEN - 1 ? row->lens[c->keynum] : MAXLEN - 1;
+  for (int i = 0; i < len; i++) {
+    char ch = key[i];
+    hash = hash * 33 + ch;
+  }
+  return hash % numpartitions;
+}
+
+void LineViewPrinter(void* arg) {
+  struct rowview* row = (struct rowview*)arg;
+  printf("%.*s", row->len, row->line);
+}
+
+void RowViewPrinter(void* arg) {
+  struct rowview* row = (struct rowview*)arg;
+  if (row->ncols == 0) {
+    printf("\n");
+    return;
+  }
+  printf("%.*s", row->lens[0], row->line + row->offs[0]);
+  for (int i = 1; i < row->ncols; i++) {
+    printf("\t%.*s", row->lens[i], row->line + row->offs[i]);
+  }
+  printf("\n");
+}
@@ -0,0 +1,71 @@
+// zero-copy records: views into a shared partition buffer
+#ifndef __rowview_h__
+#define __rowview_h__
+
+#include "list.h"
+#include "lib.h"
+
+// One line of an input file. All views of a partition point into a
+// single buffer holding the whole file, and the views themselves are
+// allocated as one array, so reading and splitting a partition costs
+// two allocations no matter how many lines it has. Columns are
+// (offset, length) slices of the line; nothing is copied or modified.
+struct rowview {
+  const char* line; // start of the line inside the partition buffer
+  int len; // length of the line, including the '\n' if any
+  int ncols; // 0 until SplitColsView() ran
+  int offs[MAXCOLS]; // column i is line[offs[i]] .. line[offs[i] + lens[i] - 1]
+  int lens[MAXCOLS];
+};
+
+// PartitionMapper for mapPartitions() over RDDFromFiles()
+// input: an opened FILE*
+// output: one `struct rowview` per line, not split yet
+int GetLineViews(void* input, List* output, void* ctx);
+
+// PartitionMapper for mapPartitions() over RDDFromFiles(): GetLineViews()
+// and SplitColsView() in one pass over the buffer (see tokenize.h)
+// input: an opened FILE*
+// ctx: TokenFormat*, NULL for TOKENIZE_WHITESPACE
+// output: one split `struct rowview` per line (CSV record)
+int GetRowViews(void* input, List* output, void* ctx);
+
+// Frees the buffer and the views GetLineViews() or GetRowViews() made
+// for one partition. "first" is the first view they appended, whose
+// line starts the buffer and which starts the view array, so this is
+// free(first->line) and free(first). Every view of the partition
+// becomes invalid; the RDDs holding them are not freed.
+void FreeRowViews(void* first);
+
+// Mappers
+// arg: `struct rowview` from GetLineViews()
+// returns: the same view with its columns set. Whitespace-delimited,
+// like SplitCols(), but columns are not truncated to MAXLEN.
+void* SplitColsView(void* arg);
+
+// Filters
+// arg: `struct rowview`
+// needle: char* string
+// returns: 1 if the line contains needle, or 0. Never frees "arg".
+int StringContainsView(void* arg, void* needle);
+
+// Joiners
+// row1, row2: split `struct rowview`s
+// ctx: `struct sumjoin_ctx`
+// returns: new `struct row` with the key and the sum, as SumJoin():
+// keys are compared as SplitCols() keeps them, the first MAXLEN - 1
+// characters
+void* SumJoinView(void* row1, void* row2, void* ctx);
+
+// Partitioners
+// arg: split `struct rowview`
+// ctx: `struct colpart_ctx`
+// returns: the same partition as ColumnHashPartitioner() on the
+// equivalent `struct row`
+unsigned long ColumnHashPartitionerView(void* arg, int numpartitions, void* ctx);
+
+// Printers
+void LineViewPrinter(void* arg);
+void RowViewPrinter(void* arg);
+
+#endif // __rowview_h__
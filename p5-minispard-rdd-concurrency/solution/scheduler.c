@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "scheduler.h"
+
+//////// Job pools ///////////////
+
+static JobPool pools[MAXPOOLS] = {{0, "default", 1, 0, {0, 0, 0, 0}}};
+static int numpools = 1;
+static pthread_mutex_t pools_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread JobPool* thread_pool = NULL; // set by MS_SetPool()
+
+JobPool* MS_CreatePool(const char* name, int weight, int priority) {
+  JobPool* pool = NULL;
+  pthread_mutex_lock(&pools_lock);
+  for (int i = 0; i < numpools && pool == NULL; i++) {
+    if (strncmp(pools[i].name, name, POOL_NAME_LEN) == 0) {
+      pool = &pools[i];
+    }
+  }
+  if (pool == NULL && numpools < MAXPOOLS) {
+    pool = &pools[numpools];
+    memset(pool, 0, sizeof(JobPool));
+    pool->id = numpools++;
+    snprintf(pool->name, POOL_NAME_LEN, "%s", name);
+  }
+  if (pool != NULL) {
+    pool->weight = weight < 1 ? 1 : weight;
+    pool->priority = priority;
+  }
+  pthread_mutex_unlock(&pools_lock);
+  return pool;
+}
+
+void MS_SetPool(JobPool* pool) {
+  thread_pool = pool;
+}
+
+JobPool* MS_DefaultPool() {
+  return &pools[0];
+}
+
+JobPool* pool_by_id(int id) {
+  pthread_mutex_lock(&pools_lock);
+  JobPool* pool = id >= 0 && id < numpools ? &pools[id] : &pools[0];
+  pthread_mutex_unlock(&pools_lock);
+  return pool;
+}
+
+JobPool* current_pool() {
+  return thread_pool != NULL ? thread_pool : &pools[0];
+}
+
+JobPoolStats MS_GetPoolStats(JobPool* pool) {
+  JobPoolStats stats;
+  stats.jobs = __atomic_load_n(&pool->stats.jobs, __ATOMIC_RELAXED);
+  stats.tasks = __atomic_load_n(&pool->stats.tasks, __ATOMIC_RELAXED);
+  stats.wait_us = __atomic_load_n(&pool->stats.wait_us, __ATOMIC_RELAXED);
+  stats.max_wait_us = __atomic_load_n(&pool->stats.max_wait_us, __ATOMIC_RELAXED);
+  return stats;
+}
+
+void MS_ResetPoolStats(JobPool* pool) {
+  __atomic_store_n(&pool->stats.jobs, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&pool->stats.tasks, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&pool->stats.wait_us, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&pool->stats.max_wait_us, 0, __ATOMIC_RELAXED);
+}
+
+void pool_job_started(JobPool* pool) {
+  __atomic_add_fetch(&pool->stats.jobs, 1, __ATOMIC_RELAXED);
+}
+
+void pool_task_scheduled(JobPool* pool, TaskMetric* metric) {
+  long wait = TIME_DIFF_MICROS(metric->created, metric->scheduled);
+  __atomic_add_fetch(&pool->stats.tasks, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&pool->stats.wait_us, wait, __ATOMIC_RELAXED);
+  long max = __atomic_load_n(&pool->stats.max_wait_us, __ATOMIC_RELAXED);
+  while (wait > max && !__atomic_compare_exchange_n(&pool->stats.max_wait_us, &max, wait, 1,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+//////// Policies ///////////////
+
+static SchedPolicy* policy = &sched_fair;
+
+void MS_SetScheduler(SchedPolicy* p) {
+  policy = p != NULL ? p : &sched_fair;
+}
+
+SchedPolicy* sched_policy() {
+  return policy;
+}
+
+// intrusive FIFO of tasks, linked through Task::next
+typedef struct {
+  Task* head;
+  Task* tail;
+  int size;
+} TaskQueue;
+
+static void task_queue_push(TaskQueue* q, Task* task) {
+  task->next = NULL;
+  if (q->tail == NULL) {
+    q->head = task;
+  } else {
+    q->tail->next = task;
+  }
+  q->tail = task;
+  q->size++;
+}
+
+static Task* task_queue_pop(TaskQueue* q) {
+  Task* task = q->head;
+  if (task != NULL) {
+    q->head = task->next;
+    if (q->head == NULL) {
+      q->tail = NULL;
+    }
+    q->size--;
+  }
+  return task;
+}
+
+// FIFO
+
+static void* fifo_create(int nworkers) {
+  (void)nworkers;
+  return calloc(1, sizeof(TaskQueue));
+}
+
+static void fifo_destroy(void* sched) {
+  free(sched);
+}
+
+static void fifo_push(void* sched, Task* task, int worker) {
+  (void)worker;
+  task_queue_push((TaskQueue*)sched, task);
+}
+
+static Task* fifo_pop(void* sched, int worker) {
+  (void)worker;
+  return task_queue_pop((TaskQueue*)sched);
+}
+
+SchedPolicy sched_fifo = {"fifo", fifo_create, fifo_destroy, fifo_push, fifo_pop};
+
+// Fair: one queue per pool. The highest priority with queued tasks is
+// served first; its pools take turns, each turn adding the pool's
+// weight to its deficit and every task taken costing one.
+
+typedef struct {
+  TaskQueue queues[MAXPOOLS];
+  long deficit[MAXPOOLS];
+  int current; // pool whose turn it is
+} FairSched;
+
+static void* fair_create(int nworkers) {
+  (void)nworkers;
+  return calloc(1, sizeof(FairSched));
+}
+
+static void fair_destroy(void* sched) {
+  free(sched);
+}
+
+static JobPool* task_pool(Task* task) {
+  return task->pool != NULL ? task->pool : &pools[0];
+}
+
+static void fair_push(void* sched, Task* task, int worker) {
+  (void)worker;
+  FairSched* fs = (FairSched*)sched;
+  task_queue_push(&fs->queues[task_pool(task)->id], task);
+}
+
+static Task* fair_pop(void* sched, int worker) {
+  (void)worker;
+  FairSched* fs = (FairSched*)sched;
+  int top = 0;
+  int found = 0;
+  for (int i = 0; i < MAXPOOLS; i++) {
+    if (fs->queues[i].size > 0 && (!found || pools[i].priority > top)) {
+      top = pools[i].priority;
+      found = 1;
+    }
+  }
+  if (!found) {
+    return NULL;
+  }
+  // deficit round-robin among the pools of that priority
+  while (1) {
+    int i = fs->current;
+    if (fs->queues[i].size > 0 && pools[i].priority == top && fs->deficit[i] >= 1) {
+      fs->deficit[i]--;
+      Task* task = task_queue_pop(&fs->queues[i]);
+      if (fs->queues[i].size == 0) {
+        fs->deficit[i] = 0; // idle pools do not save up turns
+      }
+      return task;
+    }
+    // the turn passes to the next pool, which gets its quantum
+    fs->current = (i + 1) % MAXPOOLS;
+    i = fs->current;
+    if (fs->queues[i].size > 0 && pools[i].priority == top) {
+      fs->deficit[i] += pools[i].weight;
+    }
+  }
+}
+
+SchedPolicy sched_fair = {"fair", fair_create, fair_destroy, fair_push, fair_pop};
+
+// Deques of tasks, one per worker, for the work stealing and locality
+// policies: the owner takes from the back, other workers from the front.
+
+typedef struct {
+  Task** items; // ring of "cap" slots
+  int front;
+  int size;
+  int cap;
+} TaskDeque;
+
+static void deque_push(TaskDeque* d, Task* task) {
+  if (d->size == d->cap) {
+    int cap = d->cap == 0 ? 16 : d->cap * 2;
+    Task** items = malloc(cap * sizeof(Task*));
+    if (items == NULL) {
+      printf("error growing the task deque\n");
+      exit(1);
+    }
+    for (int i = 0; i < d->size; i++) {
+      items[i] = d->items[(d->front + i) % d->cap];
+    }
+    free(d->items);
+    d->items = items;
+    d->front = 0;
+    d->cap = cap;
+  }
+  d->items[(d->front + d->size++) % d->cap] = task;
+}
+
+static Task* deque_pop_back(TaskDeque* d) {
+  if (d->size == 0) {
+    return NULL;
+  }
+  return d->items[(d->front + --d->size) % d->cap];
+}
+
+static Task* deque_pop_front(TaskDeque* d) {
+  if (d->size == 0) {
+    return NULL;
+  }
+  Task* task = d->items[d->front];
+  d->front = (d->front + 1) % d->cap;
+  d->size--;
+  return task;
+}
+
+typedef struct {
+  int nworkers;
+  int next; // deque the next task from outside goes to (work stealing)
+  TaskDeque shared; // tasks without a home (locality)
+  TaskDeque deques[];
+} DequeSched;
+
+static void* deque_sched_create(int nworkers) {
+  nworkers = nworkers < 1 ? 1 : nworkers;
+  DequeSched* ds = calloc(1, sizeof(DequeSched) + nworkers * sizeof(TaskDeque));
+  if (ds != NULL) {
+    ds->nworkers = nworkers;
+  }
+  return ds;
+}
+
+static void deque_sched_destroy(void* sched) {
+  DequeSched* ds = (DequeSched*)sched;
+  for (int i = 0; i < ds->nworkers; i++) {
+    free(ds->deques[i].items);
+  }
+  free(ds->shared.items);
+  free(ds);
+}
+
+// the oldest task of the first worker after "worker" that has any
+static Task* steal(DequeSched* ds, int worker) {
+  int from = worker < 0 ? 0 : worker + 1;
+  for (int i = 0; i < ds->nworkers; i++) {
+    Task* task = deque_pop_front(&ds->deques[(from + i) % ds->nworkers]);
+    if (task != NULL) {
+      return task;
+    }
+  }
+  return NULL;
+}
+
+// Work stealing
+
+static void steal_push(void* sched, Task* task, int worker) {
+  DequeSched* ds = (DequeSched*)sched;
+  if (worker < 0 || worker >= ds->nworkers) {
+    worker = ds->next;
+    ds->next = (ds->next + 1) % ds->nworkers;
+  }
+  deque_push(&ds->deques[worker], task);
+}
+
+static Task* steal_pop(void* sched, int worker) {
+  DequeSched* ds = (DequeSched*)sched;
+  if (worker >= 0 && worker < ds->nworkers) {
+    Task* task = deque_pop_back(&ds->deques[worker]);
+    if (task != NULL) {
+      return task;
+    }
+  }
+  return steal(ds, worker);
+}
+
+SchedPolicy sched_steal = {"steal", deque_sched_create, deque_sched_destroy, steal_push, steal_pop};
+
+// Locality
+
+static void locality_push(void* sched, Task* task, int worker) {
+  (void)worker;
+  DequeSched* ds = (DequeSched*)sched;
+  if (task->home >= 0 && task->home < ds->nworkers) {
+    deque_push(&ds->deques[task->home], task);
+  } else {
+    deque_push(&ds->shared, task);
+  }
+}
+
+static Task* locality_pop(void* sched, int worker) {
+  DequeSched* ds = (DequeSched*)sched;
+  Task* task = NULL;
+  if (worker >= 0 && worker < ds->nworkers) {
+    task = deque_pop_front(&ds->deques[worker]);
+  }
+  if (task == NULL) {
+    task = deque_pop_front(&ds->shared);
+  }
+  return task != NULL ? task : steal(ds, worker);
+}
+
+SchedPolicy sched_locality = {"locality", deque_sched_create, deque_sched_destroy, locality_push, locality_pop};
@@ -0,0 +1,81 @@
+// task scheduling policies and job pools
+#ifndef __scheduler_h__
+#define __scheduler_h__
+
+#include "minispark.h"
+
+#define MAXPOOLS (16)
+#define POOL_NAME_LEN (32)
+
+// queue wait of the tasks of a pool, from TaskMetric created -> scheduled
+typedef struct {
+  long jobs; // actions (count(), print(), ...) run in the pool
+  long tasks;
+  long wait_us; // total
+  long max_wait_us;
+} JobPoolStats;
+
+// Actions run in the pool set for their thread with MS_SetPool(). Under
+// the fair scheduler, pools with a higher priority always go first, and
+// pools of the same priority get tasks in proportion to their weight.
+struct JobPool {
+  int id; // index in the pool table, 0 is the default pool
+  char name[POOL_NAME_LEN];
+  int weight;
+  int priority;
+  JobPoolStats stats; // updated atomically
+};
+
+// A scheduling policy decides which queued task a worker runs next. Its
+// state is only touched under the work queue lock. The same interface
+// drives the ThreadPool and the scheduler simulator.
+typedef struct SchedPolicy {
+  const char* name;
+  void* (*create)(int nworkers);
+  void (*destroy)(void* sched); // queued tasks are not freed
+  // queue "task"; "worker" is the submitting worker, or -1 from outside
+  void (*push)(void* sched, Task* task, int worker);
+  // next task for "worker"; NULL only if no task is queued
+  // ("worker" may be -1 or beyond the "nworkers" the policy was created for)
+  Task* (*pop)(void* sched, int worker);
+} SchedPolicy;
+
+extern SchedPolicy sched_fifo; // one queue in submission order
+extern SchedPolicy sched_fair; // priorities, then deficit round-robin by weight
+// Work stealing: one deque per worker. Tasks pushed by a worker go to
+// its own deque and the others are dealt out round-robin; a worker takes
+// its newest task, or else steals the oldest of the next busy worker.
+extern SchedPolicy sched_steal;
+// Locality: tasks wait in the queue of their Task::home worker, which
+// takes them first; tasks without a home are shared, and idle workers
+// take the oldest task of another worker before staying idle.
+extern SchedPolicy sched_locality;
+
+// Policy of the pool created by the next MS_Run(). Defaults to sched_fair.
+void MS_SetScheduler(SchedPolicy* policy);
+SchedPolicy* sched_policy();
+
+// Returns the pool called "name", creating it with "weight" (>= 1) and
+// "priority" if needed, or NULL if there are MAXPOOLS pools already.
+JobPool* MS_CreatePool(const char* name, int weight, int priority);
+
+// Run the actions of the calling thread in "pool" (NULL for the
+// default pool).
+void MS_SetPool(JobPool* pool);
+
+JobPool* MS_DefaultPool();
+
+// the pool with index "id", or the default pool if there is none
+JobPool* pool_by_id(int id);
+
+// pool the calling thread's actions run in
+JobPool* current_pool();
+
+JobPoolStats MS_GetPoolStats(JobPool* pool);
+void MS_ResetPoolStats(JobPool* pool);
+
+// called by actions and workers to keep the stats
+void pool_job_started(JobPool* pool);
+void pool_task_scheduled(JobPool* pool, TaskMetric* metric);
+
+#endif // __scheduler_h__
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "setops.h"
+#include "sketch.h"
+#include "lib.h"
+
+#define HASHSET_MIN_CAP (16)
+
+// Open-addressing set of element pointers with linear probing. The
+// hashes are kept next to the elements so probing rarely calls Equals.
+typedef struct {
+  void** elems; // NULL for empty slots
+  unsigned long* hashes;
+  size_t cap; // power of two
+  size_t size;
+} HashSet;
+
+struct distinct_ctx {
+  Hasher hash;
+  Equals eq;
+};
+
+struct sample_ctx {
+  double fraction;
+  unsigned long seed;
+};
+
+// spreads the hash bits over the slot index: within a partition after
+// the shuffle all hashes are equal modulo the partition count
+static size_t slot_of(unsigned long h, size_t cap) {
+  uint64_t x = h;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  return x & (cap - 1);
+}
+
+static int hashset_init(HashSet* set, size_t expected) {
+  set->cap = HASHSET_MIN_CAP;
+  while (set->cap < expected * 2) {
+    set->cap *= 2;
+  }
+  set->size = 0;
+  set->elems = calloc(set->cap, sizeof(void*));
+  set->hashes = malloc(set->cap * sizeof(unsigned long));
+  return set->elems == NULL || set->hashes == NULL ? -1 : 0;
+}
+
+static void hashset_free(HashSet* set) {
+  free(set->elems);
+  free(set->hashes);
+}
+
+static void hashset_put(HashSet* set, void* elem, unsigned long h) {
+  size_t i = slot_of(h, set->cap);
+  while (set->elems[i] != NULL) {
+    i = (i + 1) & (set->cap - 1);
+  }
+  set->elems[i] = elem;
+  set->hashes[i] = h;
+  set->size++;
+}
+
+// doubles the table once it is 3/4 full. returns 0 on success
+static int hashset_grow(HashSet* set) {
+  HashSet bigger;
+  bigger.cap = set->cap * 2;
+  bigger.size = 0;
+  bigger.elems = calloc(bigger.cap, sizeof(void*));
+  bigger.hashes = malloc(bigger.cap * sizeof(unsigned long));
+  if (bigger.elems == NULL || bigger.hashes == NULL) {
+    hashset_free(&bigger);
+    return -1;
+  }
+  for (size_t i = 0; i < set->cap; i++) {
+    if (set->elems[i] != NULL) {
+      hashset_put(&bigger, set->elems[i], set->hashes[i]);
+    }
+  }
+  hashset_free(set);
+  *set = bigger;
+  return 0;
+}
+
+// returns 1 if "elem" was added, 0 if an equal element was there, -1 on
+// failure
+static int hashset_add(HashSet* set, void* elem, unsigned long h, Equals eq) {
+  size_t i = slot_of(h, set->cap);
+  while (set->elems[i] != NULL) {
+    if (set->hashes[i] == h && eq(set->elems[i], elem)) {
+      return 0;
+    }
+    i = (i + 1) & (set->cap - 1);
+  }
+  if ((set->size + 1) * 4 > set->cap * 3) {
+    if (hashset_grow(set) != 0) {
+      return -1;
+    }
+  }
+  hashset_put(set, elem, h);
+  return 1;
+}
+
+// PartitionMapper: the first copy of every element of the partition
+static int DedupPartition(void* input, List* output, void* ctx) {
+  struct distinct_ctx* dctx = (struct distinct_ctx*)ctx;
+  HashSet set;
+  int ret = -1;
+  if (hashset_init(&set, list_get_size((List*)input)) != 0) {
+    goto cleanup;
+  }
+  for (ListNode* node = ((List*)input)->head; node != NULL; node = node->next) {
+    int added = hashset_add(&set, node->data, dctx->hash(node->data), dctx->eq);
+    if (added < 0 || (added == 1 && list_add_elem(output, node->data) != 0)) {
+      goto cleanup;
+    }
+  }
+  ret = 0;
+
+cleanup:
+  hashset_free(&set);
+  return ret;
+}
+
+static unsigned long DistinctPartitioner(void* arg, int numpartitions, void* ctx) {
+  return ((struct distinct_ctx*)ctx)->hash(arg) % numpartitions;
+}
+
+RDD* distinct(RDD* rdd, Hasher hash, Equals eq, int numpartitions) {
+  if (is_file_source(rdd)) {
+    printf("error, RDD %p holds files, not elements\n", rdd);
+    return NULL;
+  }
+  if (numpartitions <= 0) {
+    printf("error, distinct needs a positive number of partitions, not %i\n", numpartitions);
+    return NULL;
+  }
+  struct distinct_ctx* dctx = malloc(sizeof(struct distinct_ctx));
+  if (dctx == NULL) {
+    printf("error allocating distinct of RDD %p\n", rdd);
+    exit(1);
+  }
+  dctx->hash = hash;
+  dctx->eq = eq;
+  RDD* local = mapPartitions(rdd, DedupPartition, dctx);
+  return mapPartitions(partitionBy(local, DistinctPartitioner, numpartitions, dctx), DedupPartition, dctx);
+}
+
+// splitmix64
+static uint64_t next_random(uint64_t* state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// PartitionMapper: Bernoulli sampling with the partition's own generator
+static int SamplePartition(void* input, List* output, void* ctx) {
+  struct sample_ctx* sctx = (struct sample_ctx*)ctx;
+  uint64_t state = sctx->seed;
+  state = next_random(&state) ^ (uint64_t)MS_TaskPartition();
+  // keep elements whose draw, as a 53-bit fraction, is below "fraction"
+  uint64_t below = sctx->fraction >= 1 ? UINT64_MAX : (uint64_t)(sctx->fraction * (1ULL << 53));
+  for (ListNode* node = ((List*)input)->head; node != NULL; node = node->next) {
+    if ((next_random(&state) >> 11) < below && list_add_elem(output, node->data) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+RDD* sample(RDD* rdd, double fraction, unsigned long seed) {
+  if (is_file_source(rdd)) {
+    printf("error, RDD %p holds files, not elements\n", rdd);
+    return NULL;
+  }
+  if (fraction < 0 || fraction > 1) {
+    printf("error, sample fraction %f is not in [0, 1]\n", fraction);
+    return NULL;
+  }
+  struct sample_ctx* sctx = malloc(sizeof(struct sample_ctx));
+  if (sctx == NULL) {
+    printf("error allocating sample of RDD %p\n", rdd);
+    exit(1);
+  }
+  sctx->fraction = fraction;
+  sctx->seed = seed;
+  return mapPartitions(rdd, SamplePartition, sctx);
+}
+
+//////// Hashers and Equals ///////////////
+
+unsigned long StringHash(void* arg) {
+  const char* str = (const char*)arg;
+  return sketch_hash(str, strlen(str));
+}
+
+int StringEquals(void* a, void* b) {
+  return strcmp((const char*)a, (const char*)b) == 0;
+}
+
+unsigned long RowHash(void* arg) {
+  struct row* row = (struct row*)arg;
+  unsigned long h = row->ncols;
+  for (int i = 0; i < row->ncols; i++) {
+    h = h * 31 + sketch_hash(row->cols[i], strlen(row->cols[i]));
+  }
+  return h;
+}
+
+int RowEquals(void* a, void* b) {
+  struct row* r1 = (struct row*)a;
+  struct row* r2 = (struct row*)b;
+  if (r1->ncols != r2->ncols) {
+    return 0;
+  }
+  for (int i = 0; i < r1->ncols; i++) {
+    if (strcmp(r1->cols[i], r2->cols[i]) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
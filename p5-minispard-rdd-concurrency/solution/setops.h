@@ -0,0 +1,30 @@
+// distinct and sample, built from mapPartitions and partitionBy
+#ifndef __setops_h__
+#define __setops_h__
+
+#include "minispark.h"
+
+// Create an RDD with one copy of every element of "rdd", in
+// "numpartitions" partitions. Every input partition drops its own
+// duplicates in a hash set before the shuffle, so only distinct
+// elements move; the partitions after it are deduplicated again. The
+// dropped duplicates are not freed. "rdd" cannot be an RDDFromFiles()
+// source. Returns NULL on invalid arguments.
+RDD* distinct(RDD* rdd, Hasher hash, Equals eq, int numpartitions);
+
+// Create an RDD keeping each element of "rdd" with probability
+// "fraction" (0 to 1). Partition i draws from a generator seeded with
+// "seed" and i, so the same seed keeps the same elements whatever the
+// scheduling. "rdd" cannot be an RDDFromFiles() source. Returns NULL on
+// invalid arguments.
+RDD* sample(RDD* rdd, double fraction, unsigned long seed);
+
+// Hashers and Equals
+// arg: char*
+unsigned long StringHash(void* arg);
+int StringEquals(void* a, void* b);
+// arg: `struct row`, all columns
+unsigned long RowHash(void* arg);
+int RowEquals(void* a, void* b);
+
+#endif // __setops_h__
@@ -0,0 +1,421 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "shuffle.h"
+#include "lib.h"
+
+//////// Codecs ///////////////
+
+static size_t raw_bound(size_t len) {
+  return len;
+}
+
+static size_t raw_compress(const char* src, size_t len, char* dst, size_t cap) {
+  (void)cap;
+  memcpy(dst, src, len);
+  return len;
+}
+
+static long raw_decompress(const char* src, size_t len, char* dst, size_t cap) {
+  if (len > cap) {
+    return -1;
+  }
+  memcpy(dst, src, len);
+  return len;
+}
+
+ShuffleCodec codec_raw = {"raw", raw_bound, raw_compress, raw_decompress};
+
+// LZ77 in LZ4's block format: a sequence is a token (literal length in
+// the high nibble, match length - LZ_MIN_MATCH in the low one, 15 means
+// more length bytes follow), the literals, and a 2-byte little-endian
+// match offset. The last sequence only has literals. Matches are found
+// with a single-entry hash table of 4-byte prefixes, so it is fast
+// rather than tight; rows full of zeroed padding are what it is for.
+#define LZ_MIN_MATCH (4)
+#define LZ_HASH_BITS (12)
+#define LZ_MAX_OFFSET (65535)
+#define LZ_LAST_LITERALS (5) // the block always ends with literals
+#define LZ_MATCH_LIMIT (12) // no match starts in the last bytes
+
+static size_t lz_bound(size_t len) {
+  return len + len / 255 + 16;
+}
+
+static inline uint32_t read32(const char* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline unsigned lz_hash(uint32_t v) {
+  return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// "len" as a run of 255s and a final byte below 255
+static char* put_length(char* op, size_t len) {
+  while (len >= 255) {
+    *op++ = (char)255;
+    len -= 255;
+  }
+  *op++ = (char)len;
+  return op;
+}
+
+static char* put_sequence(char* op, const char* literals, size_t nlit, size_t offset, size_t mlen) {
+  char* token = op++;
+  *token = (char)((nlit < 15 ? nlit : 15) << 4);
+  if (nlit >= 15) {
+    op = put_length(op, nlit - 15);
+  }
+  memcpy(op, literals, nlit);
+  op += nlit;
+  if (offset == 0) { // last sequence
+    return op;
+  }
+  *op++ = (char)(offset & 0xff);
+  *op++ = (char)(offset >> 8);
+  mlen -= LZ_MIN_MATCH;
+  *token |= (char)(mlen < 15 ? mlen : 15);
+  if (mlen >= 15) {
+    op = put_length(op, mlen - 15);
+  }
+  return op;
+}
+
+static size_t lz_compress(const char* src, size_t len, char* dst, size_t cap) {
+  (void)cap;
+  uint32_t table[1 << LZ_HASH_BITS] = {0}; // position of the last prefix with that hash
+  const char* ip = src;
+  const char* anchor = src; // first byte not written yet
+  const char* end = src + len;
+  const char* match_limit = len > LZ_MATCH_LIMIT ? end - LZ_MATCH_LIMIT : src;
+  char* op = dst;
+
+  while (ip < match_limit) {
+    uint32_t seq = read32(ip);
+    unsigned h = lz_hash(seq);
+    const char* ref = src + table[h];
+    table[h] = ip - src;
+    if (ref >= ip || ip - ref > LZ_MAX_OFFSET || read32(ref) != seq) {
+      // skip faster through data that does not compress
+      ip += 1 + ((ip - anchor) >> 6);
+      continue;
+    }
+    const char* mp = ip + LZ_MIN_MATCH;
+    const char* rp = ref + LZ_MIN_MATCH;
+    while (mp < end - LZ_LAST_LITERALS && *mp == *rp) {
+      mp++;
+      rp++;
+    }
+    op = put_sequence(op, anchor, ip - anchor, ip - ref, mp - ip);
+    ip = mp;
+    anchor = ip;
+  }
+  op = put_sequence(op, anchor, end - anchor, 0, 0);
+  return op - dst;
+}
+
+// reads the extra bytes of a length field, or returns -1
+static long get_length(const unsigned char** ip, const unsigned char* end) {
+  long len = 0;
+  unsigned char b;
+  do {
+    if (*ip >= end) {
+      return -1;
+    }
+    b = *(*ip)++;
+    len += b;
+  } while (b == 255);
+  return len;
+}
+
+static long lz_decompress(const char* src, size_t len, char* dst, size_t cap) {
+  const unsigned char* ip = (const unsigned char*)src;
+  const unsigned char* end = ip + len;
+  char* op = dst;
+  char* oend = dst + cap;
+
+  while (ip < end) {
+    unsigned token = *ip++;
+    long nlit = token >> 4;
+    if (nlit == 15) {
+      long more = get_length(&ip, end);
+      if (more < 0) {
+        return -1;
+      }
+      nlit += more;
+    }
+    if (nlit > end - ip || nlit > oend - op) {
+      return -1;
+    }
+    memcpy(op, ip, nlit);
+    op += nlit;
+    ip += nlit;
+    if (ip == end) { // last sequence
+      break;
+    }
+
+    if (end - ip < 2) {
+      return -1;
+    }
+    long offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > op - dst) {
+      return -1;
+    }
+    long mlen = token & 15;
+    if (mlen == 15) {
+      long more = get_length(&ip, end);
+      if (more < 0) {
+        return -1;
+      }
+      mlen += more;
+    }
+    mlen += LZ_MIN_MATCH;
+    if (mlen > oend - op) {
+      return -1;
+    }
+    const char* ref = op - offset;
+    if (offset >= mlen) {
+      memcpy(op, ref, mlen);
+    } else {
+      for (long i = 0; i < mlen; i++) { // overlapping: repeats the last "offset" bytes
+        op[i] = ref[i];
+      }
+    }
+    op += mlen;
+  }
+  return op - dst;
+}
+
+ShuffleCodec codec_lz = {"lz", lz_bound, lz_compress, lz_decompress};
+
+//////// Settings and stats ///////////////
+
+static __thread ShuffleCodec* thread_codec = NULL; // set by MS_SetShuffleCodec()
+static ShuffleStats stats;
+
+RDD* withEncoding(RDD* rdd, Encoder enc, Decoder dec) {
+  if (rdd->trans != PARTITIONBY) {
+    printf("error, RDD %p is not a partitionBy, encoding ignored\n", rdd);
+    return rdd;
+  }
+  rdd->encode = enc;
+  rdd->decode = dec;
+  return rdd;
+}
+
+void MS_SetShuffleCodec(ShuffleCodec* codec) {
+  thread_codec = codec;
+}
+
+ShuffleCodec* shuffle_codec() {
+  return thread_codec;
+}
+
+ShuffleStats MS_GetShuffleStats() {
+  ShuffleStats s;
+  s.blocks = __atomic_load_n(&stats.blocks, __ATOMIC_RELAXED);
+  s.elements = __atomic_load_n(&stats.elements, __ATOMIC_RELAXED);
+  s.raw_bytes = __atomic_load_n(&stats.raw_bytes, __ATOMIC_RELAXED);
+  s.bytes = __atomic_load_n(&stats.bytes, __ATOMIC_RELAXED);
+  s.write_us = __atomic_load_n(&stats.write_us, __ATOMIC_RELAXED);
+  s.read_us = __atomic_load_n(&stats.read_us, __ATOMIC_RELAXED);
+  return s;
+}
+
+void MS_ResetShuffleStats() {
+  __atomic_store_n(&stats.blocks, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats.elements, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats.raw_bytes, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats.bytes, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats.write_us, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats.read_us, 0, __ATOMIC_RELAXED);
+}
+
+static long cpu_micros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+//////// Blocks ///////////////
+
+// compresses the "len" serialized bytes of "count" elements into a new
+// block at the end of "blocks", counting it in "acc" unless it is NULL
+static int flush_block(const char* buf, size_t len, int count, ShuffleCodec* codec, List* blocks,
+                       ShuffleStats* acc) {
+  ShuffleBlock* block = malloc(sizeof(ShuffleBlock) + codec->bound(len));
+  if (block == NULL) {
+    return -1;
+  }
+  block->count = count;
+  block->raw_len = len;
+  block->len = codec->compress(buf, len, block->data, codec->bound(len));
+  ShuffleBlock* shrunk = realloc(block, sizeof(ShuffleBlock) + block->len);
+  if (shrunk != NULL) {
+    block = shrunk;
+  }
+  if (list_add_elem(blocks, block) != 0) {
+    free(block);
+    return -1;
+  }
+  if (acc != NULL) {
+    __atomic_fetch_add(&acc->blocks, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&acc->elements, count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&acc->raw_bytes, len, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&acc->bytes, block->len, __ATOMIC_RELAXED);
+  }
+  return 0;
+}
+
+static int write_blocks(List* elems, Encoder enc, ShuffleCodec* codec, List* blocks, ShuffleStats* acc) {
+  int ret = -1;
+  long start = cpu_micros();
+  size_t cap = SHUFFLE_BLOCK_BYTES;
+  size_t len = 0;
+  int count = 0;
+  char* buf = malloc(cap);
+  if (buf == NULL) {
+    goto cleanup;
+  }
+
+  for (ListNode* node = elems->head; node != NULL; node = node->next) {
+    size_t room = cap - len > sizeof(uint32_t) ? cap - len - sizeof(uint32_t) : 0;
+    size_t n = enc(node->data, buf + len + sizeof(uint32_t), room);
+    if (n > room) {
+      // grow and encode again
+      size_t need = len + sizeof(uint32_t) + n;
+      size_t bigger = cap * 2 > need ? cap * 2 : need;
+      char* grown = realloc(buf, bigger);
+      if (grown == NULL) {
+        goto cleanup;
+      }
+      buf = grown;
+      cap = bigger;
+      n = enc(node->data, buf + len + sizeof(uint32_t), n);
+    }
+    uint32_t n32 = n;
+    memcpy(buf + len, &n32, sizeof(uint32_t));
+    len += sizeof(uint32_t) + n;
+    count++;
+    if (len >= SHUFFLE_BLOCK_BYTES) {
+      if (flush_block(buf, len, count, codec, blocks, acc) != 0) {
+        goto cleanup;
+      }
+      len = 0;
+      count = 0;
+    }
+  }
+  if (count > 0 && flush_block(buf, len, count, codec, blocks, acc) != 0) {
+    goto cleanup;
+  }
+  ret = 0;
+
+  cleanup:
+    free(buf);
+    if (acc != NULL) {
+      __atomic_fetch_add(&acc->write_us, cpu_micros() - start, __ATOMIC_RELAXED);
+    }
+    return ret;
+}
+
+int shuffle_write(List* elems, Encoder enc, ShuffleCodec* codec, List* blocks) {
+  return write_blocks(elems, enc, codec, blocks, &stats);
+}
+
+int blocks_write(List* elems, Encoder enc, ShuffleCodec* codec, List* blocks) {
+  return write_blocks(elems, enc, codec, blocks, NULL);
+}
+
+static int read_blocks(List* blocks, Decoder dec, ShuffleCodec* codec, List* out, ShuffleStats* acc) {
+  int ret = -1;
+  long start = cpu_micros();
+  size_t cap = 0;
+  char* buf = NULL;
+
+  for (ListNode* node = blocks->head; node != NULL; node = node->next) {
+    ShuffleBlock* block = (ShuffleBlock*)node->data;
+    if (block->raw_len > cap) {
+      char* grown = realloc(buf, block->raw_len);
+      if (grown == NULL) {
+        goto cleanup;
+      }
+      buf = grown;
+      cap = block->raw_len;
+    }
+    if (codec->decompress(block->data, block->len, buf, cap) != (long)block->raw_len) {
+      printf("error, corrupt block of %i elements\n", block->count);
+      goto cleanup;
+    }
+    size_t pos = 0;
+    for (int i = 0; i < block->count; i++) {
+      uint32_t n;
+      if (pos + sizeof(uint32_t) > block->raw_len) {
+        goto cleanup;
+      }
+      memcpy(&n, buf + pos, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+      if (n > block->raw_len - pos) {
+        goto cleanup;
+      }
+      void* elem = dec(buf + pos, n);
+      if (elem == NULL || list_add_elem(out, elem) != 0) {
+        goto cleanup;
+      }
+      pos += n;
+    }
+  }
+  ret = 0;
+
+  cleanup:
+    free(buf);
+    if (acc != NULL) {
+      __atomic_fetch_add(&acc->read_us, cpu_micros() - start, __ATOMIC_RELAXED);
+    }
+    return ret;
+}
+
+int shuffle_read(List* blocks, Decoder dec, ShuffleCodec* codec, List* out) {
+  return read_blocks(blocks, dec, codec, out, &stats);
+}
+
+int blocks_read(List* blocks, Decoder dec, ShuffleCodec* codec, List* out) {
+  return read_blocks(blocks, dec, codec, out, NULL);
+}
+
+void shuffle_blocks_clear(List* blocks) {
+  while (list_get_size(blocks) > 0) {
+    free(list_remove_elem(blocks));
+  }
+}
+
+//////// Row format ///////////////
+
+size_t RowEncoder(void* elem, char* buf, size_t cap) {
+  struct row* row = (struct row*)elem;
+  if (cap < sizeof(struct row)) {
+    return sizeof(struct row);
+  }
+  struct row* out = (struct row*)buf;
+  // columns past ncols are uninitialized, zero them so the padding compresses
+  memcpy(out->cols, row->cols, row->ncols * MAXLEN);
+  memset(out->cols[row->ncols], 0, (MAXCOLS - row->ncols) * MAXLEN);
+  memcpy(&out->ncols, &row->ncols, sizeof(row->ncols));
+  return sizeof(struct row);
+}
+
+void* RowDecoder(const char* buf, size_t len) {
+  if (len != sizeof(struct row)) {
+    return NULL;
+  }
+  struct row* row = malloc(sizeof(struct row));
+  if (row != NULL) {
+    memcpy(row, buf, sizeof(struct row));
+  }
+  return row;
+}
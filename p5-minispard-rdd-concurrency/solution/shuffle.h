@@ -0,0 +1,84 @@
+// serialized, compressed shuffles
+#ifndef __shuffle_h__
+#define __shuffle_h__
+
+#include <stddef.h>
+#include "minispark.h"
+
+#define SHUFFLE_BLOCK_BYTES (64 * 1024) // serialized bytes per block
+
+// A block codec. Codecs work on whole blocks and keep no state, so one
+// codec is used by all workers at once.
+typedef struct ShuffleCodec {
+  const char* name;
+  // largest compressed size of "len" bytes
+  size_t (*bound)(size_t len);
+  // compress "len" bytes of "src" into "dst", which holds at least
+  // bound(len) bytes. returns the compressed size
+  size_t (*compress)(const char* src, size_t len, char* dst, size_t cap);
+  // returns the decompressed size, or -1 if "src" is corrupt or does
+  // not fit in "cap" bytes
+  long (*decompress)(const char* src, size_t len, char* dst, size_t cap);
+} ShuffleCodec;
+
+extern ShuffleCodec codec_raw; // serialized, not compressed
+extern ShuffleCodec codec_lz; // LZ77 with LZ4's block format
+
+// Shuffle data of one map task for one output partition. "data" holds
+// "count" elements, each a 4-byte length followed by what the Encoder
+// wrote, compressed with the RDD's codec.
+typedef struct {
+  int count;
+  size_t raw_len; // before compression
+  size_t len; // of "data"
+  char data[];
+} ShuffleBlock;
+
+typedef struct {
+  long blocks;
+  long elements;
+  long raw_bytes; // serialized
+  long bytes; // compressed, i.e. what was moved
+  long write_us; // CPU time spent serializing and compressing
+  long read_us; // CPU time spent decompressing and deserializing
+} ShuffleStats;
+
+// Marks "rdd", a partitionBy, as serializable: "enc" and "dec" convert
+// its elements to and from bytes, so its shuffle can be compressed.
+// Returns "rdd".
+RDD* withEncoding(RDD* rdd, Encoder enc, Decoder dec);
+
+// Shuffles of the actions run by the calling thread from now on are
+// serialized and compressed with "codec", if their partitionBy has an
+// encoding. NULL, the default, moves element pointers.
+void MS_SetShuffleCodec(ShuffleCodec* codec);
+
+// codec the calling thread's actions shuffle with
+ShuffleCodec* shuffle_codec();
+
+ShuffleStats MS_GetShuffleStats();
+void MS_ResetShuffleStats();
+
+// Serializes the elements of "elems" with "enc" and compresses them
+// with "codec" into blocks of about SHUFFLE_BLOCK_BYTES, appended to
+// "blocks". returns 0 on success
+int shuffle_write(List* elems, Encoder enc, ShuffleCodec* codec, List* blocks);
+
+// Decodes every block of "blocks" with "codec" and "dec", appending
+// the elements to "out". returns 0 on success
+int shuffle_read(List* blocks, Decoder dec, ShuffleCodec* codec, List* out);
+
+// the same without counting in ShuffleStats, for other users of the
+// block format (checkpoints)
+int blocks_write(List* elems, Encoder enc, ShuffleCodec* codec, List* blocks);
+int blocks_read(List* blocks, Decoder dec, ShuffleCodec* codec, List* out);
+
+// frees the blocks of "blocks", leaving it empty
+void shuffle_blocks_clear(List* blocks);
+
+// Encoder and Decoder for `struct row` (lib.h). Rows are written as
+// they are in memory, with unused columns zeroed.
+size_t RowEncoder(void* elem, char* buf, size_t cap);
+void* RowDecoder(const char* buf, size_t len);
+
+#endif // __shuffle_h__
@@ -0,0 +1,454 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "simulator.h"
+
+int tracing = 0;
+
+// the trace being recorded, and what its stages were recorded from
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static JobTrace* recording = NULL;
+static struct timespec trace_start;
+
+typedef struct {
+  RDD* rdd;
+  int fetch;
+  long last_done_us; // when its last recorded task finished
+} StageKey;
+
+static StageKey* keys = NULL; // one per stage of "recording"
+static int keys_cap = 0;
+
+static long usec_since_start(struct timespec* t) {
+  return (t->tv_sec - trace_start.tv_sec) * 1000000L + (t->tv_nsec - trace_start.tv_nsec) / 1000;
+}
+
+static void* grow(void* items, int* cap, size_t size) {
+  int newcap = *cap == 0 ? 64 : *cap * 2;
+  items = realloc(items, newcap * size);
+  if (items == NULL) {
+    printf("error growing the job trace\n");
+    exit(1);
+  }
+  *cap = newcap;
+  return items;
+}
+
+JobTrace* trace_create() {
+  JobTrace* trace = calloc(1, sizeof(JobTrace));
+  if (trace == NULL) {
+    printf("error allocating the job trace\n");
+    exit(1);
+  }
+  return trace;
+}
+
+void trace_free(JobTrace* trace) {
+  if (trace == NULL) {
+    return;
+  }
+  free(trace->stages);
+  free(trace->tasks);
+  free(trace);
+}
+
+int trace_add_stage(JobTrace* trace, int* deps, int ndeps, int shuffle, int pool, long arrival_us) {
+  if (trace->nstages == trace->stages_cap) {
+    trace->stages = grow(trace->stages, &trace->stages_cap, sizeof(SimStage));
+  }
+  SimStage* stage = &trace->stages[trace->nstages];
+  memset(stage, 0, sizeof(SimStage));
+  for (int i = 0; i < ndeps && stage->ndeps < SIM_MAXDEPS; i++) {
+    stage->deps[stage->ndeps++] = deps[i];
+  }
+  stage->shuffle = shuffle;
+  stage->pool = pool;
+  stage->arrival_us = arrival_us;
+  return trace->nstages++;
+}
+
+int trace_add_task(JobTrace* trace, int stage, int pnum, long duration_us) {
+  if (trace->ntasks == trace->tasks_cap) {
+    trace->tasks = grow(trace->tasks, &trace->tasks_cap, sizeof(SimTask));
+  }
+  trace->tasks[trace->ntasks] = (SimTask){stage, pnum, duration_us};
+  trace->stages[stage].ntasks++;
+  return trace->ntasks++;
+}
+
+//////// Recording ///////////////////
+
+void MS_TraceStart() {
+  pthread_mutex_lock(&trace_lock);
+  trace_free(recording);
+  recording = trace_create();
+  clock_gettime(CLOCK_MONOTONIC, &trace_start);
+  tracing = 1;
+  pthread_mutex_unlock(&trace_lock);
+}
+
+JobTrace* MS_TraceStop() {
+  pthread_mutex_lock(&trace_lock);
+  tracing = 0;
+  JobTrace* trace = recording;
+  recording = NULL;
+  free(keys);
+  keys = NULL;
+  keys_cap = 0;
+  pthread_mutex_unlock(&trace_lock);
+  return trace;
+}
+
+// latest stage recorded for "rdd" (any phase), -1 if none
+static int latest_stage(RDD* rdd) {
+  for (int i = recording->nstages - 1; i >= 0; i--) {
+    if (keys[i].rdd == rdd) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// adds the stages "rdd" was computed from to "deps", looking through
+// RDDs that ran no tasks (e.g. unions)
+static void collect_deps(RDD* rdd, int* deps, int* ndeps, int depth) {
+  for (int i = 0; i < rdd->numdependencies; i++) {
+    RDD* dep = rdd->dependencies[i];
+    int stage = latest_stage(dep);
+    if (stage < 0) {
+      if (depth < 16) {
+        collect_deps(dep, deps, ndeps, depth + 1);
+      }
+      continue;
+    }
+    int seen = 0;
+    for (int j = 0; j < *ndeps; j++) {
+      seen |= deps[j] == stage;
+    }
+    if (!seen && *ndeps < SIM_MAXDEPS) {
+      deps[(*ndeps)++] = stage;
+    }
+  }
+}
+
+// the stage "task" belongs to. A task created after the last task of a
+// stage of its RDD finished starts a new stage: its RDD is computed
+// again (streams, reset RDDs).
+static int stage_of(Task* task, long created_us) {
+  for (int i = recording->nstages - 1; i >= 0; i--) {
+    if (keys[i].rdd == task->rdd && keys[i].fetch == task->fetch) {
+      if (created_us <= keys[i].last_done_us) {
+        return i;
+      }
+      break;
+    }
+  }
+
+  int deps[SIM_MAXDEPS];
+  int ndeps = 0;
+  if (task->fetch) {
+    int routing = latest_stage(task->rdd);
+    if (routing >= 0) {
+      deps[ndeps++] = routing;
+    }
+  } else {
+    collect_deps(task->rdd, deps, &ndeps, 0);
+  }
+  int shuffle = task->rdd->trans == PARTITIONBY && !task->fetch;
+  int pool = task->pool != NULL ? task->pool->id : 0;
+  int stage = trace_add_stage(recording, deps, ndeps, shuffle, pool, created_us);
+  if (stage >= keys_cap) {
+    keys = grow(keys, &keys_cap, sizeof(StageKey));
+  }
+  keys[stage] = (StageKey){task->rdd, task->fetch, created_us};
+  return stage;
+}
+
+void trace_task_done(Task* task) {
+  TaskMetric* metric = task->metric;
+  pthread_mutex_lock(&trace_lock);
+  if (recording != NULL) {
+    long created_us = usec_since_start(&metric->created);
+    int stage = stage_of(task, created_us);
+    trace_add_task(recording, stage, task->pnum, metric->duration);
+    long done_us = usec_since_start(&metric->scheduled) + metric->duration;
+    if (done_us > keys[stage].last_done_us) {
+      keys[stage].last_done_us = done_us;
+    }
+  }
+  pthread_mutex_unlock(&trace_lock);
+}
+
+//////// Files ///////////////////
+
+int trace_save(JobTrace* trace, FILE* out) {
+  fprintf(out, "trace %d %d\n", trace->nstages, trace->ntasks);
+  for (int i = 0; i < trace->nstages; i++) {
+    SimStage* stage = &trace->stages[i];
+    fprintf(out, "stage %d", stage->ndeps);
+    for (int j = 0; j < stage->ndeps; j++) {
+      fprintf(out, " %d", stage->deps[j]);
+    }
+    fprintf(out, " %d %d %ld\n", stage->shuffle, stage->pool, stage->arrival_us);
+  }
+  for (int i = 0; i < trace->ntasks; i++) {
+    SimTask* task = &trace->tasks[i];
+    fprintf(out, "task %d %d %ld\n", task->stage, task->pnum, task->duration_us);
+  }
+  return ferror(out) ? -1 : 0;
+}
+
+JobTrace* trace_load(FILE* in) {
+  int nstages, ntasks;
+  if (fscanf(in, " trace %d %d", &nstages, &ntasks) != 2 || nstages < 0 || ntasks < 0) {
+    return NULL;
+  }
+  JobTrace* trace = trace_create();
+  for (int i = 0; i < nstages; i++) {
+    int deps[SIM_MAXDEPS];
+    int ndeps, shuffle, pool;
+    long arrival;
+    if (fscanf(in, " stage %d", &ndeps) != 1 || ndeps < 0 || ndeps > SIM_MAXDEPS) {
+      goto error;
+    }
+    for (int j = 0; j < ndeps; j++) {
+      if (fscanf(in, "%d", &deps[j]) != 1 || deps[j] < 0 || deps[j] >= i) {
+        goto error;
+      }
+    }
+    if (fscanf(in, "%d %d %ld", &shuffle, &pool, &arrival) != 3) {
+      goto error;
+    }
+    trace_add_stage(trace, deps, ndeps, shuffle, pool, arrival);
+  }
+  for (int i = 0; i < ntasks; i++) {
+    int stage, pnum;
+    long duration;
+    if (fscanf(in, " task %d %d %ld", &stage, &pnum, &duration) != 3 || stage < 0 || stage >= nstages ||
+        pnum < 0 || duration < 0) {
+      goto error;
+    }
+    trace_add_task(trace, stage, pnum, duration);
+  }
+  return trace;
+
+error:
+  trace_free(trace);
+  return NULL;
+}
+
+//////// Simulation ///////////////////
+
+typedef struct {
+  int first; // its tasks are order[first .. first + ntasks)
+  int pending_deps; // dependencies not done yet
+  int remaining; // tasks not done yet
+  int released;
+  long release_us;
+  int maxpnum;
+  int* ran_on; // core that last computed each partition, -1 if none
+} StageState;
+
+static void stage_done(JobTrace* trace, StageState* state, int s) {
+  for (int i = s + 1; i < trace->nstages; i++) {
+    for (int j = 0; j < trace->stages[i].ndeps; j++) {
+      if (trace->stages[i].deps[j] == s) {
+        state[i].pending_deps--;
+      }
+    }
+  }
+}
+
+// core that computed partition "pnum" of a dependency of stage "s", -1
+// if it was shuffled or not computed
+static int task_home(JobTrace* trace, StageState* state, int s, int pnum) {
+  SimStage* stage = &trace->stages[s];
+  for (int i = 0; i < stage->ndeps; i++) {
+    int dep = stage->deps[i];
+    if (!trace->stages[dep].shuffle && pnum <= state[dep].maxpnum && state[dep].ran_on[pnum] >= 0) {
+      return state[dep].ran_on[pnum];
+    }
+  }
+  return -1;
+}
+
+int sched_simulate(JobTrace* trace, SimConfig* config, SimResult* result) {
+  memset(result, 0, sizeof(SimResult));
+  if (config->cores < 1 || config->policy == NULL) {
+    return -1;
+  }
+  for (int s = 0; s < trace->nstages; s++) {
+    for (int j = 0; j < trace->stages[s].ndeps; j++) {
+      if (trace->stages[s].deps[j] < 0 || trace->stages[s].deps[j] >= s) {
+        printf("error, stage %d of the trace depends on stage %d\n", s, trace->stages[s].deps[j]);
+        return -1;
+      }
+    }
+  }
+
+  int ret = -1;
+  int cores = config->cores;
+  StageState* state = calloc(trace->nstages, sizeof(StageState));
+  int* order = malloc((trace->ntasks + 1) * sizeof(int)); // task indexes by stage
+  Task* tasks = calloc(trace->ntasks + 1, sizeof(Task));
+  Task** running = calloc(cores, sizeof(Task*));
+  long* finish = calloc(cores, sizeof(long));
+  void* sched = config->policy->create(cores);
+  if (state == NULL || order == NULL || tasks == NULL || running == NULL || finish == NULL || sched == NULL) {
+    printf("error allocating the simulation\n");
+    exit(1);
+  }
+
+  int next = 0;
+  for (int s = 0; s < trace->nstages; s++) {
+    state[s].first = next;
+    next += trace->stages[s].ntasks;
+    state[s].pending_deps = trace->stages[s].ndeps;
+    state[s].remaining = trace->stages[s].ntasks;
+    state[s].maxpnum = -1;
+  }
+  int* filled = calloc(trace->nstages + 1, sizeof(int));
+  if (filled == NULL) {
+    printf("error allocating the simulation\n");
+    exit(1);
+  }
+  for (int i = 0; i < trace->ntasks; i++) {
+    SimTask* t = &trace->tasks[i];
+    if (t->stage < 0 || t->stage >= trace->nstages || t->pnum < 0) {
+      printf("error, task %d of the trace is in stage %d\n", i, t->stage);
+      free(filled);
+      goto cleanup;
+    }
+    order[state[t->stage].first + filled[t->stage]++] = i;
+    if (t->pnum > state[t->stage].maxpnum) {
+      state[t->stage].maxpnum = t->pnum;
+    }
+    tasks[i].pnum = t->pnum;
+    tasks[i].pool = pool_by_id(trace->stages[t->stage].pool);
+    tasks[i].morsel = -1;
+    tasks[i].home = -1;
+  }
+  free(filled);
+  for (int s = 0; s < trace->nstages; s++) {
+    state[s].ran_on = malloc((state[s].maxpnum + 2) * sizeof(int));
+    if (state[s].ran_on == NULL) {
+      printf("error allocating the simulation\n");
+      exit(1);
+    }
+    for (int p = 0; p <= state[s].maxpnum; p++) {
+      state[s].ran_on[p] = -1;
+    }
+  }
+
+  // the clock starts when the first stage arrives
+  long now = LONG_MAX;
+  for (int s = 0; s < trace->nstages; s++) {
+    if (trace->stages[s].ndeps == 0 && trace->stages[s].arrival_us < now) {
+      now = trace->stages[s].arrival_us;
+    }
+  }
+  long origin = now = now == LONG_MAX ? 0 : now;
+  long wait_us = 0;
+  int done = 0;
+  int stages_done = 0;
+  while (stages_done < trace->nstages) {
+    // start the stages that are ready; a stage without tasks is done at once
+    int changed = 1;
+    while (changed) {
+      changed = 0;
+      for (int s = 0; s < trace->nstages; s++) {
+        SimStage* stage = &trace->stages[s];
+        if (state[s].released || state[s].pending_deps > 0 || (stage->ndeps == 0 && stage->arrival_us > now)) {
+          continue;
+        }
+        state[s].released = 1;
+        state[s].release_us = now;
+        for (int i = 0; i < stage->ntasks; i++) {
+          Task* task = &tasks[order[state[s].first + i]];
+          task->home = task_home(trace, state, s, task->pnum);
+          config->policy->push(sched, task, -1);
+        }
+        if (stage->ntasks == 0) {
+          stage_done(trace, state, s);
+          stages_done++;
+          changed = 1;
+        }
+      }
+    }
+
+    for (int c = 0; c < cores; c++) {
+      if (running[c] != NULL) {
+        continue;
+      }
+      Task* task = config->policy->pop(sched, c);
+      if (task == NULL) {
+        break;
+      }
+      SimTask* t = &trace->tasks[task - tasks];
+      long duration = t->duration_us;
+      if (task->home >= 0 && task->home != c) {
+        result->remote_tasks++;
+        duration = (long)(duration * (1.0 + config->remote_penalty));
+      }
+      running[c] = task;
+      finish[c] = now + duration;
+      result->busy_us += duration;
+      wait_us += now - state[t->stage].release_us;
+    }
+
+    // advance to the next task that finishes or stage that arrives
+    long event = LONG_MAX;
+    for (int c = 0; c < cores; c++) {
+      if (running[c] != NULL && finish[c] < event) {
+        event = finish[c];
+      }
+    }
+    for (int s = 0; s < trace->nstages; s++) {
+      if (!state[s].released && trace->stages[s].ndeps == 0 && trace->stages[s].arrival_us < event) {
+        event = trace->stages[s].arrival_us;
+      }
+    }
+    if (event == LONG_MAX) {
+      if (stages_done < trace->nstages) {
+        printf("error, %d stages of the trace never start\n", trace->nstages - stages_done);
+        goto cleanup;
+      }
+      break;
+    }
+    now = event;
+
+    for (int c = 0; c < cores; c++) {
+      if (running[c] == NULL || finish[c] != now) {
+        continue;
+      }
+      SimTask* t = &trace->tasks[running[c] - tasks];
+      running[c] = NULL;
+      state[t->stage].ran_on[t->pnum] = c;
+      done++;
+      result->makespan_us = now - origin;
+      if (--state[t->stage].remaining == 0) {
+        stage_done(trace, state, t->stage);
+        stages_done++;
+      }
+    }
+  }
+
+  result->tasks = done;
+  result->mean_wait_us = done > 0 ? (double)wait_us / done : 0.0;
+  result->utilization = result->makespan_us > 0 ? (double)result->busy_us / ((double)cores * result->makespan_us) : 0.0;
+  ret = 0;
+
+cleanup:
+  config->policy->destroy(sched);
+  for (int s = 0; s < trace->nstages; s++) {
+    free(state[s].ran_on);
+  }
+  free(state);
+  free(order);
+  free(tasks);
+  free(running);
+  free(finish);
+  return ret;
+}
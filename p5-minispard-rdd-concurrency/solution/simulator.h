@@ -0,0 +1,90 @@
+// job traces and a scheduler simulator to replay them
+#ifndef __simulator_h__
+#define __simulator_h__
+
+#include <stdio.h>
+#include "minispark.h"
+#include "scheduler.h"
+
+#define SIM_MAXDEPS (8)
+
+// A group of tasks that can start together: the tasks of an RDD, or the
+// fetch tasks of a serialized partitionBy (which wait for its routing
+// tasks). A stage starts once all the stages it depends on are done, or
+// at "arrival_us" if it has none.
+typedef struct {
+  int ndeps;
+  int deps[SIM_MAXDEPS]; // indexes of earlier stages
+  int shuffle; // its output partitions are not where its tasks ran (partitionBy)
+  int pool; // JobPool id of its action
+  long arrival_us; // from the start of the trace
+  int ntasks;
+} SimStage;
+
+typedef struct {
+  int stage;
+  int pnum; // partition it computes
+  long duration_us;
+} SimTask;
+
+typedef struct {
+  SimStage* stages;
+  int nstages;
+  SimTask* tasks;
+  int ntasks;
+  int stages_cap;
+  int tasks_cap;
+} JobTrace;
+
+typedef struct {
+  int cores;
+  SchedPolicy* policy;
+  // a task that does not run on the core that computed its input
+  // partition takes (1 + remote_penalty) times as long
+  double remote_penalty;
+} SimConfig;
+
+typedef struct {
+  long makespan_us; // from the arrival of the first stage to the end of the last task
+  long busy_us; // summed over the cores
+  double utilization; // busy_us / (cores * makespan_us)
+  int tasks;
+  int remote_tasks; // tasks run away from the core that computed their input
+  double mean_wait_us; // from stage start to task start
+} SimResult;
+
+// 0 when no trace is being recorded
+extern int tracing;
+
+// Records every task the workers run from now on: its RDD, partition,
+// TaskMetric duration and pool. Only one trace is recorded at a time.
+void MS_TraceStart();
+
+// Stops recording and returns the trace, NULL if none was started. The
+// stages of RDDs computed before MS_TraceStart() are left out, and a
+// stage that depends on them starts when its first task was created.
+JobTrace* MS_TraceStop();
+
+// building traces by hand; both return the index of what they added
+JobTrace* trace_create();
+int trace_add_stage(JobTrace* trace, int* deps, int ndeps, int shuffle, int pool, long arrival_us);
+int trace_add_task(JobTrace* trace, int stage, int pnum, long duration_us);
+void trace_free(JobTrace* trace);
+
+// one line per stage and per task; returns 0 on success
+int trace_save(JobTrace* trace, FILE* out);
+// reads what trace_save() wrote; NULL on error
+JobTrace* trace_load(FILE* in);
+
+// Replays "trace" on config->cores simulated cores scheduled by
+// config->policy, the same policy code the ThreadPool runs. Tasks are
+// pushed when their stage starts and idle cores take tasks in order of
+// their id, so results only depend on the trace and the config. Pools
+// are looked up by id in this process (see pool_by_id()). Returns 0 on
+// success, -1 if the trace is inconsistent.
+int sched_simulate(JobTrace* trace, SimConfig* config, SimResult* result);
+
+// called by workers when a task finishes while tracing
+void trace_task_done(Task* task);
+
+#endif // __simulator_h__
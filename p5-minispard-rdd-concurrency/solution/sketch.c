@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sketch.h"
+#include "lib.h"
+
+// FNV-1a, finished with MurmurHash3's fmix64 so every output bit
+// depends on every input bit (HyperLogLog reads the top bits)
+uint64_t sketch_hash(const char* key, size_t len) {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)key[i];
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+//////// HyperLogLog ///////////////
+
+HyperLogLog* hll_init(int precision) {
+  if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION) {
+    printf("error, HyperLogLog precision %i is not in [%i, %i]\n", precision, HLL_MIN_PRECISION, HLL_MAX_PRECISION);
+    return NULL;
+  }
+  HyperLogLog* hll = calloc(1, sizeof(HyperLogLog) + (1 << precision));
+  if (hll != NULL) {
+    hll->precision = precision;
+  }
+  return hll;
+}
+
+void hll_add(HyperLogLog* hll, uint64_t hash) {
+  int p = hll->precision;
+  uint64_t idx = hash >> (64 - p);
+  uint64_t rest = hash << p;
+  // position of the first 1 bit in the remaining 64 - p bits
+  unsigned char rank = rest == 0 ? 64 - p + 1 : __builtin_clzll(rest) + 1;
+  if (rank > hll->regs[idx]) {
+    hll->regs[idx] = rank;
+  }
+}
+
+void hll_merge(HyperLogLog* dst, HyperLogLog* src) {
+  for (int i = 0; i < (1 << dst->precision); i++) {
+    if (src->regs[i] > dst->regs[i]) {
+      dst->regs[i] = src->regs[i];
+    }
+  }
+}
+
+double hll_estimate(HyperLogLog* hll) {
+  int m = 1 << hll->precision;
+  double sum = 0;
+  int zeros = 0;
+  for (int i = 0; i < m; i++) {
+    sum += ldexp(1.0, -hll->regs[i]);
+    zeros += hll->regs[i] == 0;
+  }
+  double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / (1 + 1.079 / m);
+  double estimate = alpha * m * m / sum;
+  // linear counting is more accurate while many registers are empty
+  if (estimate <= 2.5 * m && zeros > 0) {
+    estimate = m * log((double)m / zeros);
+  }
+  return estimate;
+}
+
+//////// Count-min sketch ///////////////
+
+CountMinSketch* cms_init(double eps, double delta) {
+  if (eps <= 0 || eps >= 1 || delta <= 0 || delta >= 1) {
+    printf("error, count-min sketch needs 0 < eps, delta < 1\n");
+    return NULL;
+  }
+  int width = (int)ceil(M_E / eps);
+  int depth = (int)ceil(log(1 / delta));
+  CountMinSketch* cms = calloc(1, sizeof(CountMinSketch) + (size_t)width * depth * sizeof(long));
+  if (cms != NULL) {
+    cms->width = width;
+    cms->depth = depth;
+  }
+  return cms;
+}
+
+// counter of "hash" in row "row": the rows use h1 + row * h2, which is
+// as good as independent hash functions for this purpose
+static long* cms_counter(CountMinSketch* cms, uint64_t hash, int row) {
+  uint32_t h1 = (uint32_t)hash;
+  uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+  return &cms->counts[(size_t)row * cms->width + (h1 + (uint64_t)row * h2) % cms->width];
+}
+
+void cms_add(CountMinSketch* cms, uint64_t hash, long n) {
+  for (int row = 0; row < cms->depth; row++) {
+    *cms_counter(cms, hash, row) += n;
+  }
+  cms->total += n;
+}
+
+void cms_merge(CountMinSketch* dst, CountMinSketch* src) {
+  for (size_t i = 0; i < (size_t)dst->width * dst->depth; i++) {
+    dst->counts[i] += src->counts[i];
+  }
+  dst->total += src->total;
+}
+
+long cms_estimate(CountMinSketch* cms, const char* key, size_t len) {
+  uint64_t hash = sketch_hash(key, len);
+  long min = *cms_counter(cms, hash, 0);
+  for (int row = 1; row < cms->depth; row++) {
+    long c = *cms_counter(cms, hash, row);
+    min = c < min ? c : min;
+  }
+  return min;
+}
+
+//////// Bloom filter ///////////////
+
+int bloom_init(BloomFilter* bf, long n, double fpp) {
+  if (n < 1) {
+    n = 1;
+  }
+  // m = -n ln(p) / ln(2)^2 bits and k = m / n ln(2) hashes
+  double m = ceil(-n * log(fpp) / (M_LN2 * M_LN2));
+  bf->nbits = m < 64 ? 64 : (uint64_t)m;
+  bf->nhashes = (int)round(bf->nbits / (double)n * M_LN2);
+  bf->nhashes = bf->nhashes < 1 ? 1 : bf->nhashes;
+  bf->bits = calloc((bf->nbits + 63) / 64, sizeof(uint64_t));
+  return bf->bits == NULL ? -1 : 0;
+}
+
+// bit "i" of "hash", double hashing like cms_counter()
+static uint64_t bloom_bit(BloomFilter* bf, uint64_t hash, int i) {
+  uint32_t h1 = (uint32_t)hash;
+  uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+  return (h1 + (uint64_t)i * h2) % bf->nbits;
+}
+
+void bloom_add(BloomFilter* bf, uint64_t hash) {
+  for (int i = 0; i < bf->nhashes; i++) {
+    uint64_t bit = bloom_bit(bf, hash, i);
+    bf->bits[bit / 64] |= 1ULL << (bit % 64);
+  }
+}
+
+int bloom_contains(BloomFilter* bf, uint64_t hash) {
+  for (int i = 0; i < bf->nhashes; i++) {
+    uint64_t bit = bloom_bit(bf, hash, i);
+    if ((bf->bits[bit / 64] & (1ULL << (bit % 64))) == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void bloom_free(BloomFilter* bf) {
+  free(bf->bits);
+  bf->bits = NULL;
+}
+
+//////// Actions ///////////////
+
+struct sketch_ctx {
+  KeyFn key;
+  void* ctx;
+  int precision; // HyperLogLog
+  double eps; // count-min sketch
+  double delta;
+};
+
+// PartitionMappers: one sketch per partition
+static int hll_partition(void* input, List* output, void* ctx) {
+  struct sketch_ctx* sctx = (struct sketch_ctx*)ctx;
+  HyperLogLog* hll = hll_init(sctx->precision);
+  if (hll == NULL) {
+    return -1;
+  }
+  for (ListNode* node = ((List*)input)->head; node != NULL; node = node->next) {
+    size_t len;
+    const char* key = sctx->key(node->data, &len, sctx->ctx);
+    hll_add(hll, sketch_hash(key, len));
+  }
+  return list_add_elem(output, hll);
+}
+
+static int cms_partition(void* input, List* output, void* ctx) {
+  struct sketch_ctx* sctx = (struct sketch_ctx*)ctx;
+  CountMinSketch* cms = cms_init(sctx->eps, sctx->delta);
+  if (cms == NULL) {
+    return -1;
+  }
+  for (ListNode* node = ((List*)input)->head; node != NULL; node = node->next) {
+    size_t len;
+    const char* key = sctx->key(node->data, &len, sctx->ctx);
+    cms_add(cms, sketch_hash(key, len), 1);
+  }
+  return list_add_elem(output, cms);
+}
+
+// runs "fn" over every partition of "rdd"; returns the RDD holding the
+// sketches, or NULL
+static RDD* sketch_partitions(RDD* rdd, PartitionMapper fn, struct sketch_ctx* sctx) {
+  if (is_file_source(rdd)) {
+    printf("error, RDD %p holds files, not elements\n", rdd);
+    return NULL;
+  }
+  RDD* sketches = mapPartitions(rdd, fn, sctx);
+  return count(sketches) < 0 ? NULL : sketches;
+}
+
+long countApproxDistinct(RDD* dataset, KeyFn key, void* ctx, int precision) {
+  struct sketch_ctx sctx = {key, ctx, precision, 0, 0};
+  HyperLogLog* total = hll_init(precision);
+  if (total == NULL) {
+    return -1;
+  }
+  RDD* sketches = sketch_partitions(dataset, hll_partition, &sctx);
+  if (sketches == NULL) {
+    free(total);
+    return -1;
+  }
+  for (ListNode* p = sketches->partitions->head; p != NULL; p = p->next) {
+    for (ListNode* node = ((List*)p->data)->head; node != NULL; node = node->next) {
+      hll_merge(total, (HyperLogLog*)node->data);
+      free(node->data);
+    }
+  }
+  long estimate = (long)(hll_estimate(total) + 0.5);
+  free(total);
+  return estimate;
+}
+
+CountMinSketch* countMinSketch(RDD* dataset, KeyFn key, void* ctx, double eps, double delta) {
+  struct sketch_ctx sctx = {key, ctx, 0, eps, delta};
+  CountMinSketch* total = cms_init(eps, delta);
+  if (total == NULL) {
+    return NULL;
+  }
+  RDD* sketches = sketch_partitions(dataset, cms_partition, &sctx);
+  if (sketches == NULL) {
+    free(total);
+    return NULL;
+  }
+  for (ListNode* p = sketches->partitions->head; p != NULL; p = p->next) {
+    for (ListNode* node = ((List*)p->data)->head; node != NULL; node = node->next) {
+      cms_merge(total, (CountMinSketch*)node->data);
+      free(node->data);
+    }
+  }
+  return total;
+}
+
+//////// Keys ///////////////
+
+const char* ColumnKey(void* arg, size_t* len, void* ctx) {
+  struct row* row = (struct row*)arg;
+  int col = ((struct colpart_ctx*)ctx)->keynum;
+  const char* key = col < row->ncols ? row->cols[col] : "";
+  *len = strlen(key);
+  return key;
+}
+
+const char* LineKey(void* arg, size_t* len, void* ctx) {
+  (void)ctx;
+  const char* line = (const char*)arg;
+  *len = strcspn(line, "\n");
+  return line;
+}
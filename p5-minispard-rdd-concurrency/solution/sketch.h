@@ -0,0 +1,82 @@
+// approximate aggregations: HyperLogLog and count-min sketches
+#ifndef __sketch_h__
+#define __sketch_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "minispark.h"
+
+#define HLL_MIN_PRECISION (4)
+#define HLL_MAX_PRECISION (18)
+
+// 2^precision registers, each holding the longest run of leading zero
+// bits seen among the hashes routed to it. The relative error of the
+// estimate is about 1.04 / sqrt(2^precision).
+typedef struct {
+  int precision;
+  unsigned char regs[];
+} HyperLogLog;
+
+// "depth" rows of "width" counters; a key adds 1 to one counter per row
+// and its estimate is the smallest of them, so it never undercounts.
+typedef struct {
+  int width;
+  int depth;
+  long total; // keys added
+  long counts[]; // depth * width
+} CountMinSketch;
+
+// "nhashes" bits out of "nbits" are set per key; a key that was added is
+// always found, others are found with the false positive rate it was
+// sized for.
+typedef struct {
+  uint64_t nbits;
+  int nhashes;
+  uint64_t* bits;
+} BloomFilter;
+
+// 64-bit hash of "len" bytes
+uint64_t sketch_hash(const char* key, size_t len);
+
+HyperLogLog* hll_init(int precision);
+void hll_add(HyperLogLog* hll, uint64_t hash);
+// adds the keys of "src" to "dst", which must have the same precision
+void hll_merge(HyperLogLog* dst, HyperLogLog* src);
+double hll_estimate(HyperLogLog* hll);
+
+// width e / eps and depth ln(1 / delta): estimates exceed the true count
+// by at most eps * total with probability 1 - delta
+CountMinSketch* cms_init(double eps, double delta);
+void cms_add(CountMinSketch* cms, uint64_t hash, long n);
+// adds the counts of "src" to "dst", which must have the same shape
+void cms_merge(CountMinSketch* dst, CountMinSketch* src);
+long cms_estimate(CountMinSketch* cms, const char* key, size_t len);
+
+// sized for "n" keys at a false positive rate of "fpp". returns 0 on success
+int bloom_init(BloomFilter* bf, long n, double fpp);
+void bloom_add(BloomFilter* bf, uint64_t hash);
+int bloom_contains(BloomFilter* bf, uint64_t hash);
+void bloom_free(BloomFilter* bf);
+
+//////// actions ////////
+
+// Estimate the number of distinct keys in "dataset" in one pass: every
+// partition fills its own HyperLogLog of 2^precision registers (4 to 18)
+// and they are merged at the end. "ctx" is passed to "key". Returns -1
+// on failure.
+long countApproxDistinct(RDD* dataset, KeyFn key, void* ctx, int precision);
+
+// Build a count-min sketch of the keys of "dataset" in one pass, one
+// sketch per partition merged at the end (see cms_init() for "eps" and
+// "delta"). Query it with cms_estimate() and free() it. Returns NULL on
+// failure.
+CountMinSketch* countMinSketch(RDD* dataset, KeyFn key, void* ctx, double eps, double delta);
+
+// KeyFns
+// arg: `struct row`
+// ctx: `struct colpart_ctx`, the column holding the key
+const char* ColumnKey(void* arg, size_t* len, void* ctx);
+// arg: char* line, the key is the line without its '\n'
+const char* LineKey(void* arg, size_t* len, void* ctx);
+
+#endif // __sketch_h__
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "sorted.h"
+
+unsigned long RangePartitioner(void* arg, int numpartitions, void* ctx) {
+  struct range_ctx* range = (struct range_ctx*)ctx;
+  // first bound bigger than the element
+  int lo = 0;
+  int hi = range->nbounds;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (range->order.cmp(arg, range->bounds[mid], range->order.ctx) < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo < numpartitions ? lo : numpartitions - 1;
+}
+
+// merges the sorted runs src[lo, mid) and src[mid, hi) into dst
+static void merge_runs(void** src, void** dst, int lo, int mid, int hi, struct sort_ctx* order) {
+  int i = lo;
+  int j = mid;
+  for (int k = lo; k < hi; k++) {
+    if (i < mid && (j >= hi || order->cmp(src[i], src[j], order->ctx) <= 0)) {
+      dst[k] = src[i++];
+    } else {
+      dst[k] = src[j++];
+    }
+  }
+}
+
+int SortPartition(void* input, List* output, void* ctx) {
+  List* partition = (List*)input;
+  struct sort_ctx* order = (struct sort_ctx*)ctx;
+  int n = list_get_size(partition);
+  void** elems = malloc(2 * (n > 0 ? n : 1) * sizeof(void*));
+  if (elems == NULL) {
+    printf("error allocating sort buffer for %i elements\n", n);
+    return -1;
+  }
+  int i = 0;
+  for (ListNode* node = partition->head; node != NULL; node = node->next) {
+    elems[i++] = node->data;
+  }
+
+  // bottom-up merge sort, which is stable unlike qsort()
+  void** src = elems;
+  void** dst = elems + n;
+  for (int width = 1; width < n; width *= 2) {
+    for (int lo = 0; lo < n; lo += 2 * width) {
+      int mid = lo + width < n ? lo + width : n;
+      int hi = lo + 2 * width < n ? lo + 2 * width : n;
+      merge_runs(src, dst, lo, mid, hi, order);
+    }
+    void** tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  int ret = 0;
+  for (i = 0; i < n && ret == 0; i++) {
+    ret = list_add_elem(output, src[i]);
+  }
+  free(elems);
+  return ret;
+}
+
+int top_init(TopHeap* heap, struct top_ctx* top) {
+  heap->top = *top;
+  heap->size = 0;
+  heap->elems = malloc((top->k > 0 ? top->k : 1) * sizeof(void*));
+  return heap->elems == NULL ? -1 : 0;
+}
+
+static int top_less(TopHeap* heap, int i, int j) {
+  return heap->top.order.cmp(heap->elems[i], heap->elems[j], heap->top.order.ctx) < 0;
+}
+
+static void top_swap(TopHeap* heap, int i, int j) {
+  void* tmp = heap->elems[i];
+  heap->elems[i] = heap->elems[j];
+  heap->elems[j] = tmp;
+}
+
+// restores the heap below "i" after elems[i] grew
+static void top_sift_down(TopHeap* heap, int i) {
+  while (1) {
+    int smallest = i;
+    int l = 2 * i + 1;
+    int r = l + 1;
+    if (l < heap->size && top_less(heap, l, smallest)) {
+      smallest = l;
+    }
+    if (r < heap->size && top_less(heap, r, smallest)) {
+      smallest = r;
+    }
+    if (smallest == i) {
+      return;
+    }
+    top_swap(heap, i, smallest);
+    i = smallest;
+  }
+}
+
+void top_offer(TopHeap* heap, void* elem) {
+  if (heap->size < heap->top.k) {
+    int i = heap->size++;
+    heap->elems[i] = elem;
+    while (i > 0 && top_less(heap, i, (i - 1) / 2)) {
+      top_swap(heap, i, (i - 1) / 2);
+      i = (i - 1) / 2;
+    }
+  } else if (heap->top.k > 0 && heap->top.order.cmp(elem, heap->elems[0], heap->top.order.ctx) > 0) {
+    heap->elems[0] = elem;
+    top_sift_down(heap, 0);
+  }
+}
+
+int top_drain(TopHeap* heap, void** out) {
+  int n = heap->size;
+  // popping the smallest fills "out" from the back
+  while (heap->size > 0) {
+    out[heap->size - 1] = heap->elems[0];
+    heap->elems[0] = heap->elems[--heap->size];
+    top_sift_down(heap, 0);
+  }
+  free(heap->elems);
+  heap->elems = NULL;
+  return n;
+}
+
+int TopPartition(void* input, List* output, void* ctx) {
+  TopHeap heap;
+  if (top_init(&heap, (struct top_ctx*)ctx) != 0) {
+    printf("error allocating a heap of %i elements\n", ((struct top_ctx*)ctx)->k);
+    return -1;
+  }
+  for (ListNode* node = ((List*)input)->head; node != NULL; node = node->next) {
+    top_offer(&heap, node->data);
+  }
+  void** kept = malloc((heap.size > 0 ? heap.size : 1) * sizeof(void*));
+  if (kept == NULL) {
+    free(heap.elems);
+    return -1;
+  }
+  int n = top_drain(&heap, kept);
+  int ret = 0;
+  for (int i = 0; i < n && ret == 0; i++) {
+    ret = list_add_elem(output, kept[i]);
+  }
+  free(kept);
+  return ret;
+}
@@ -0,0 +1,60 @@
+// helpers for key-ordered data, e.g. inputs of sortMergeJoin()
+#ifndef __sorted_h__
+#define __sorted_h__
+
+#include "minispark.h"
+
+// key order shared by the helpers below
+struct sort_ctx {
+  Comparator cmp;
+  void* ctx; // passed to cmp
+};
+
+// ctx of RangePartitioner(): partition i holds the elements e with
+// bounds[i-1] <= e < bounds[i], so "bounds" must be sorted and
+// partitionBy() called with nbounds + 1 partitions. Two sides
+// partitioned with the same bounds line up for sortMergeJoin().
+struct range_ctx {
+  struct sort_ctx order;
+  void** bounds; // elements of the same kind as the partitioned ones
+  int nbounds;
+};
+
+// Partitioners
+// ctx: `struct range_ctx`
+unsigned long RangePartitioner(void* arg, int numpartitions, void* ctx);
+
+// PartitionMappers for mapPartitions()
+// input: List partition
+// ctx: `struct sort_ctx`
+// output: the elements of the partition, sorted. Elements with equal
+// keys keep their order.
+int SortPartition(void* input, List* output, void* ctx);
+
+// ctx of TopPartition() and top()
+struct top_ctx {
+  struct sort_ctx order;
+  int k;
+};
+
+// keeps the "k" largest elements offered to it, in a min-heap
+typedef struct {
+  void** elems; // elems[0] is the smallest kept element
+  int size;
+  struct top_ctx top;
+} TopHeap;
+
+// returns 0 on success
+int top_init(TopHeap* heap, struct top_ctx* top);
+void top_offer(TopHeap* heap, void* elem);
+// moves the kept elements to "out", largest first, frees the heap and
+// returns how many there were
+int top_drain(TopHeap* heap, void** out);
+
+// PartitionMappers for mapPartitions()
+// input: List partition
+// ctx: `struct top_ctx`
+// output: the k largest elements of the partition, largest first
+int TopPartition(void* input, List* output, void* ctx);
+
+#endif // __sorted_h__
@@ -0,0 +1,271 @@
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+#include "stream.h"
+#include "optimizer.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+extern ThreadPool* global_thread_pool;
+
+// FILE_BACKED source RDD with "numpartitions" empty partitions
+static RDD *stream_source_rdd(int numpartitions)
+{
+  List* partitions = list_init();
+  if (partitions == NULL) {
+    printf("error creating partitions for stream source rdd\n");
+    exit(1);
+  }
+  for (int i = 0; i < numpartitions; i++) {
+    List* inner_list = list_init();
+    if (inner_list == NULL || list_add_elem(partitions, inner_list) != 0) {
+      printf("error creating partition %i for stream source rdd\n", i);
+      exit(1);
+    }
+  }
+  return create_source_rdd(FILE_BACKED, NULL, partitions, numpartitions);
+}
+
+Stream* stream_init(char* filenames[], int numfiles, int interval_ms) {
+  if (global_thread_pool == NULL) {
+    MS_Run();
+  }
+
+  Stream* s = malloc(sizeof(Stream));
+  if (s == NULL) {
+    return NULL;
+  }
+  s->filenames = filenames;
+  s->numfiles = numfiles;
+  s->interval_ms = interval_ms;
+  s->batch = 0;
+  s->numqueries = 0;
+  s->files = malloc(numfiles * sizeof(FILE*));
+  s->starts = malloc(numfiles * sizeof(long));
+  if (s->files == NULL || s->starts == NULL) {
+    free(s->files);
+    free(s->starts);
+    free(s);
+    return NULL;
+  }
+  for (int i = 0; i < numfiles; i++) {
+    s->files[i] = fopen(filenames[i], "r");
+    if (s->files[i] == NULL) {
+      perror("fopen");
+      exit(1);
+    }
+  }
+  s->source = stream_source_rdd(numfiles);
+  return s;
+}
+
+RDD* stream_source(Stream* s) {
+  return s->source;
+}
+
+static StreamQuery* stream_add_query(Stream* s, RDD* sink, Reducer fn, void* init, void* ctx) {
+  if (s->numqueries == MAXQUERIES) {
+    printf("error, stream %p already has %d queries\n", s, MAXQUERIES);
+    return NULL;
+  }
+  StreamQuery* q = &s->queries[s->numqueries++];
+  q->sink = sink;
+  q->fn = fn;
+  q->ctx = ctx;
+  q->value = init;
+  q->count = 0;
+  q->last_count = 0;
+  return q;
+}
+
+StreamQuery* stream_count(Stream* s, RDD* sink) {
+  return stream_add_query(s, sink, NULL, NULL, NULL);
+}
+
+StreamQuery* stream_reduce(Stream* s, RDD* sink, Reducer fn, void* init, void* ctx) {
+  return stream_add_query(s, sink, fn, init, ctx);
+}
+
+long stream_query_count(StreamQuery* q) {
+  return q->count;
+}
+
+void* stream_query_value(StreamQuery* q) {
+  return q->value;
+}
+
+// sleep until "interval_ms" after the start of the previous batch
+static void stream_wait_interval(Stream* s) {
+  if (s->batch == 0) {
+    return;
+  }
+  struct timespec next = s->last_batch;
+  next.tv_sec += s->interval_ms / 1000;
+  next.tv_nsec += (s->interval_ms % 1000) * 1000000L;
+  if (next.tv_nsec >= 1000000000L) {
+    next.tv_sec++;
+    next.tv_nsec -= 1000000000L;
+  }
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+  }
+}
+
+// append the complete lines added to "fp" since the last call to "out".
+// a trailing line without '\n' is still being written, so it is left
+// for the next batch.
+static int stream_read_lines(FILE* fp, List* out) {
+  int n = 0;
+  clearerr(fp);
+  while (1) {
+    long pos = ftell(fp);
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len = getline(&line, &size, fp);
+    if (len < 0) {
+      free(line);
+      break;
+    }
+    if (line[len - 1] != '\n') {
+      free(line);
+      fseek(fp, pos, SEEK_SET);
+      break;
+    }
+    if (list_add_elem(out, line) != 0) {
+      free(line);
+      return -1;
+    }
+    n++;
+  }
+  return n;
+}
+
+// moves every file back to where the latest batch began
+static void stream_rewind(Stream* s) {
+  for (int i = 0; i < s->numfiles; i++) {
+    fseek(s->files[i], s->starts[i], SEEK_SET);
+  }
+}
+
+// reads the complete lines appended to every file into "batches". On
+// failure nothing is consumed: the lines read so far are freed and the
+// files rewound. returns the number of lines, or -1
+static int stream_read_batch(Stream* s, List** batches) {
+  for (int i = 0; i < s->numfiles; i++) {
+    batches[i] = NULL;
+    s->starts[i] = ftell(s->files[i]);
+    if (s->starts[i] < 0) {
+      return -1;
+    }
+  }
+  int newlines = 0;
+  for (int i = 0; i < s->numfiles; i++) {
+    batches[i] = list_init();
+    int n = batches[i] == NULL ? -1 : stream_read_lines(s->files[i], batches[i]);
+    if (n < 0) {
+      newlines = -1;
+      break;
+    }
+    newlines += n;
+  }
+  if (newlines < 0) {
+    for (int i = 0; i < s->numfiles && batches[i] != NULL; i++) {
+      while (list_get_size(batches[i]) > 0) {
+        free(list_remove_elem(batches[i]));
+      }
+      list_free(batches[i]);
+    }
+    stream_rewind(s);
+  }
+  return newlines;
+}
+
+int stream_run_batch(Stream* s) {
+  stream_wait_interval(s);
+  clock_gettime(CLOCK_MONOTONIC, &s->last_batch);
+
+  List** batches = malloc(s->numfiles * sizeof(List*));
+  if (batches == NULL) {
+    return -1;
+  }
+  int newlines = stream_read_batch(s, batches);
+  if (newlines < 0) {
+    free(batches);
+    return -1;
+  }
+  // swap in the new batch; the previous batch's lines belong to the
+  // elements derived from them, so only the lists are freed here
+  for (int i = 0; i < s->numfiles; i++) {
+    List* old = (List*)list_get(s->source->partitions, i);
+    list_set(s->source->partitions, i, batches[i]);
+    list_free(old);
+  }
+  free(batches);
+  s->batch++;
+
+  for (int i = 0; i < s->numqueries; i++) {
+    rdd_reset(s->queries[i].sink);
+  }
+  // all queries must compute the batch before any of them folds it in
+  for (int i = 0; i < s->numqueries; i++) {
+    StreamQuery* q = &s->queries[i];
+    pool_job_started(current_pool());
+    optimize(q->sink, NULL);
+    execute(q->sink);
+    wait_rdd(q->sink);
+    if (q->sink->failed) {
+      printf("error, batch %d of stream query %d could not be computed\n", s->batch, i);
+      stream_rewind(s); // its lines are read again by the next call
+      s->batch--;
+      return -1;
+    }
+  }
+  for (int i = 0; i < s->numqueries; i++) {
+    StreamQuery* q = &s->queries[i];
+    q->last_count = 0;
+    if (q->sink->partitions == NULL) {
+      continue;
+    }
+    ListIterator* piter = list_iterator_begin(q->sink->partitions);
+    while (list_iterator_has_next(piter)) {
+      List* partition = (List*)list_iterator_next(piter);
+      if (partition == NULL) {
+        continue;
+      }
+      if (q->fn == NULL) {
+        q->last_count += list_get_size(partition);
+        continue;
+      }
+      ListIterator* iter = list_iterator_begin(partition);
+      while (list_iterator_has_next(iter)) {
+        q->value = q->fn(q->value, list_iterator_next(iter), q->ctx);
+        q->last_count++;
+      }
+      list_iterator_destroy(iter);
+    }
+    list_iterator_destroy(piter);
+    q->count += q->last_count;
+  }
+  return newlines;
+}
+
+void stream_destroy(Stream* s) {
+  if (s == NULL) {
+    return;
+  }
+  for (int i = 0; i < s->numfiles; i++) {
+    fclose(s->files[i]);
+  }
+  free(s->files);
+  free(s->starts);
+  while (list_get_size(s->source->partitions) > 0) {
+    list_free((List*)list_remove_elem(s->source->partitions));
+  }
+  list_free(s->source->partitions);
+  pthread_mutex_destroy(&s->source->rdd_lock);
+  pthread_cond_destroy(&s->source->completed_cv);
+  free(s->source);
+  free(s);
+}
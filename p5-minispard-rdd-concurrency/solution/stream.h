@@ -0,0 +1,69 @@
+#ifndef __stream_h__
+#define __stream_h__
+
+#include <stdio.h>
+#include <time.h>
+#include "minispark.h"
+
+#define MAXQUERIES (16)
+
+// folds "elem" into the running value "acc" and returns the new value
+typedef void* (*Reducer)(void* acc, void* elem, void* ctx);
+
+typedef struct {
+  RDD* sink; // RDD evaluated on every batch
+  Reducer fn; // NULL for count queries
+  void* ctx;
+  void* value; // running reduce value
+  long count; // running number of elements across all batches
+  long last_count; // elements produced by the latest batch
+} StreamQuery;
+
+// A stream tails a set of growing files. Every batch reads the complete
+// lines appended since the previous batch into a FILE_BACKED source RDD
+// (one partition per file) and re-runs the registered queries on them.
+typedef struct {
+  char** filenames;
+  FILE** files;
+  long* starts; // where the latest batch begins in each file
+  int numfiles;
+  int interval_ms; // minimum time between the start of two batches
+  int batch; // number of batches run so far
+  struct timespec last_batch;
+  RDD* source; // FILE_BACKED, partitions hold the current batch's lines
+  StreamQuery queries[MAXQUERIES];
+  int numqueries;
+} Stream;
+
+// Open "filenames" for tailing. Batches are formed at most every
+// "interval_ms" milliseconds.
+Stream* stream_init(char* filenames[], int numfiles, int interval_ms);
+
+// The source RDD to build the per-batch DAG on. Its elements are the
+// new lines (char*) of each batch, so it takes the place of
+// map(RDDFromFiles(...), GetLines). All other sources reachable from
+// a query are only read once.
+RDD* stream_source(Stream* s);
+
+// Keep a running count of the elements of "sink" across batches.
+StreamQuery* stream_count(Stream* s, RDD* sink);
+
+// Keep a running reduction of the elements of "sink" across batches,
+// starting from "init".
+StreamQuery* stream_reduce(Stream* s, RDD* sink, Reducer fn, void* init, void* ctx);
+
+// Wait for the next interval, read the new lines and update every
+// query. Returns the number of new lines, or -1 on error, which leaves
+// every query as it was. On error the files are rewound to where the
+// batch began, so the next call reads its lines again; queries may have
+// freed the lines already (e.g. StringContains), so they are not re-run.
+int stream_run_batch(Stream* s);
+
+long stream_query_count(StreamQuery* q);
+void* stream_query_value(StreamQuery* q);
+
+// Close the input files and free the stream. Queries are owned by
+// the stream and become invalid.
+void stream_destroy(Stream* s);
+
+#endif // __stream_h__
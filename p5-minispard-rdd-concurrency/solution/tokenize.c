@@ -0,0 +1,272 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "tokenize.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define CHUNK (64) // bytes per bitmask
+#define BLOCK_CHUNKS (64) // bitmasks computed at once, 4 KiB of input
+
+// state of one tokenize_lines() call, advanced one interesting
+// position (delimiter, '\n' or quote) at a time
+typedef struct {
+  const char* buf;
+  struct rowview* views;
+  int maxlines;
+  int nlines;
+  long line_start;
+  long field_start; // whitespace: one past the previous delimiter; CSV: start of the field
+  int in_quotes;
+} Tokenizer;
+
+// resolved once from the CPU, before any tokenize_lines() reads it;
+// tokenize_set_kernel() may change it later
+static TokenizerKernel kernel = TOKENIZE_AUTO;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static TokenizerKernel best_kernel() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return TOKENIZE_AVX2;
+  }
+  return TOKENIZE_SSE2; // part of x86-64
+#else
+  return TOKENIZE_SCALAR;
+#endif
+}
+
+static void resolve_kernel() {
+  __atomic_store_n(&kernel, best_kernel(), __ATOMIC_RELAXED);
+}
+
+TokenizerKernel tokenize_set_kernel(TokenizerKernel k) {
+  pthread_once(&kernel_once, resolve_kernel);
+  TokenizerKernel best = best_kernel();
+  TokenizerKernel chosen = k == TOKENIZE_AUTO || k > best ? best : k;
+  __atomic_store_n(&kernel, chosen, __ATOMIC_RELAXED);
+  return chosen;
+}
+
+int tokenize_count_lines(const char* buf, long len) {
+  int n = 0;
+  for (const char* p = buf; p < buf + len; n++) {
+    const char* nl = memchr(p, '\n', buf + len - p);
+    p = nl ? nl + 1 : buf + len;
+  }
+  return n;
+}
+
+static inline void add_column(Tokenizer* t, long start, long end) {
+  struct rowview* row = &t->views[t->nlines];
+  if (row->ncols < MAXCOLS) {
+    row->offs[row->ncols] = start - t->line_start;
+    row->lens[row->ncols++] = end - start;
+  }
+}
+
+// ends the current line at "end" (one past its '\n'); returns -1 if the
+// next line has no view
+static inline int end_line(Tokenizer* t, long end) {
+  struct rowview* row = &t->views[t->nlines];
+  row->line = t->buf + t->line_start;
+  row->len = end - t->line_start;
+  t->line_start = end;
+  if (++t->nlines == t->maxlines) {
+    return -1;
+  }
+  t->views[t->nlines].ncols = 0;
+  return 0;
+}
+
+static inline int whitespace_at(Tokenizer* t, long p) {
+  if (p > t->field_start) {
+    add_column(t, t->field_start, p);
+  }
+  t->field_start = p + 1;
+  return t->buf[p] == '\n' ? end_line(t, p + 1) : 0;
+}
+
+static inline void add_csv_field(Tokenizer* t, long start, long end) {
+  if (end - start >= 2 && t->buf[start] == '"' && t->buf[end - 1] == '"') {
+    start++;
+    end--;
+  }
+  add_column(t, start, end);
+}
+
+static inline int csv_at(Tokenizer* t, long p) {
+  char c = t->buf[p];
+  if (c == '"') {
+    t->in_quotes = !t->in_quotes;
+    return 0;
+  }
+  if (t->in_quotes) {
+    return 0;
+  }
+  long end = p;
+  if (c == '\n' && end > t->field_start && t->buf[end - 1] == '\r') {
+    end--;
+  }
+  // an empty line has no columns, an empty field is one
+  if (c != '\n' || end > t->line_start) {
+    add_csv_field(t, t->field_start, end);
+  }
+  t->field_start = p + 1;
+  return c == '\n' ? end_line(t, p + 1) : 0;
+}
+
+// visits the set bits of "mask", positions base + i; returns -1 once
+// the views ran out
+static inline int visit(Tokenizer* t, TokenFormat fmt, long base, uint64_t mask) {
+  while (mask != 0) {
+    long p = base + __builtin_ctzll(mask);
+    mask &= mask - 1;
+    if ((fmt == TOKENIZE_CSV ? csv_at(t, p) : whitespace_at(t, p)) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// A kernel sets masks[i] to the bitmask of the bytes of chunk i of "p"
+// equal to "a", "b" or "c". Kernels make no calls: calling SSE code
+// with the upper halves of the AVX registers in use is slow.
+typedef void (*MaskKernel)(const char* p, int nchunks, char a, char b, char c, uint64_t* masks);
+
+static void masks_scalar(const char* p, int nchunks, char a, char b, char c, uint64_t* masks) {
+  for (int i = 0; i < nchunks; i++, p += CHUNK) {
+    uint64_t mask = 0;
+    for (int j = 0; j < CHUNK; j++) {
+      mask |= (uint64_t)((p[j] == a) | (p[j] == b) | (p[j] == c)) << j;
+    }
+    masks[i] = mask;
+  }
+}
+
+#if defined(__x86_64__)
+static void masks_sse2(const char* p, int nchunks, char a, char b, char c, uint64_t* masks) {
+  __m128i va = _mm_set1_epi8(a);
+  __m128i vb = _mm_set1_epi8(b);
+  __m128i vc = _mm_set1_epi8(c);
+  for (int i = 0; i < nchunks; i++, p += CHUNK) {
+    uint64_t mask = 0;
+    for (int j = 0; j < CHUNK / 16; j++) {
+      __m128i v = _mm_loadu_si128((const __m128i*)p + j);
+      __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)), _mm_cmpeq_epi8(v, vc));
+      mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(eq) << (16 * j);
+    }
+    masks[i] = mask;
+  }
+}
+
+__attribute__((target("avx2"))) static void masks_avx2(const char* p, int nchunks, char a, char b, char c,
+                                                       uint64_t* masks) {
+  __m256i va = _mm256_set1_epi8(a);
+  __m256i vb = _mm256_set1_epi8(b);
+  __m256i vc = _mm256_set1_epi8(c);
+  for (int i = 0; i < nchunks; i++, p += CHUNK) {
+    __m256i lo = _mm256_loadu_si256((const __m256i*)p);
+    __m256i hi = _mm256_loadu_si256((const __m256i*)p + 1);
+    __m256i eq_lo = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(lo, va), _mm256_cmpeq_epi8(lo, vb)),
+                                    _mm256_cmpeq_epi8(lo, vc));
+    __m256i eq_hi = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(hi, va), _mm256_cmpeq_epi8(hi, vb)),
+                                    _mm256_cmpeq_epi8(hi, vc));
+    masks[i] = (uint64_t)(uint32_t)_mm256_movemask_epi8(eq_lo) | (uint64_t)(uint32_t)_mm256_movemask_epi8(eq_hi) << 32;
+  }
+}
+#endif
+
+// Runs "visit" over the bitmasks of the whole buffer, BLOCK_CHUNKS
+// chunks per kernel call. The tail is padded with '\0's, which are
+// never interesting. returns -1 once the views ran out
+static int run(Tokenizer* t, MaskKernel masks_of, const char* buf, long len, TokenFormat fmt, char a, char b) {
+  uint64_t masks[BLOCK_CHUNKS];
+  long base = 0;
+  while (base + CHUNK <= len) {
+    long left = (len - base) / CHUNK;
+    int n = left < BLOCK_CHUNKS ? left : BLOCK_CHUNKS;
+    masks_of(buf + base, n, a, b, '\n', masks);
+    for (int i = 0; i < n; i++, base += CHUNK) {
+      if (visit(t, fmt, base, masks[i]) != 0) {
+        return -1;
+      }
+    }
+  }
+  if (base < len) {
+    char tail[CHUNK] = {0};
+    memcpy(tail, buf + base, len - base);
+    masks_of(tail, 1, a, b, '\n', masks);
+    return visit(t, fmt, base, masks[0]);
+  }
+  return 0;
+}
+
+int tokenize_lines(const char* buf, long len, TokenFormat fmt, struct rowview* views, int maxlines) {
+  if (maxlines <= 0) {
+    return len > 0 ? -1 : 0;
+  }
+  pthread_once(&kernel_once, resolve_kernel);
+  TokenizerKernel k = __atomic_load_n(&kernel, __ATOMIC_RELAXED);
+  Tokenizer t = {buf, views, maxlines, 0, 0, 0, 0};
+  views[0].ncols = 0;
+  char a = fmt == TOKENIZE_CSV ? ',' : ' ';
+  char b = fmt == TOKENIZE_CSV ? '"' : '\t';
+  MaskKernel masks_of = masks_scalar;
+#if defined(__x86_64__)
+  masks_of = k == TOKENIZE_AVX2 ? masks_avx2 : k == TOKENIZE_SSE2 ? masks_sse2 : masks_scalar;
+#endif
+  int ret = run(&t, masks_of, buf, len, fmt, a, b);
+  // the views ran out: fine only if nothing follows the last '\n'
+  if (ret != 0) {
+    return t.line_start < len ? -1 : t.nlines;
+  }
+  // last line without '\n'
+  if (t.line_start < len) {
+    if (fmt == TOKENIZE_CSV) {
+      long end = len > t.field_start && buf[len - 1] == '\r' ? len - 1 : len;
+      add_csv_field(&t, t.field_start, end);
+    } else if (len > t.field_start) {
+      add_column(&t, t.field_start, len);
+    }
+    struct rowview* row = &views[t.nlines];
+    row->line = buf + t.line_start;
+    row->len = len - t.line_start;
+    t.nlines++;
+  }
+  return t.nlines;
+}
+
+void* SplitColsFast(void* arg) {
+  char* line = (char*)arg;
+  struct row* row = malloc(sizeof(struct row));
+  if (row == NULL) {
+    free(line);
+    return NULL;
+  }
+  row->ncols = 0;
+  // like strtok_r() on " \t\n", an embedded '\n' only separates columns
+  long len = strlen(line);
+  int nlines = tokenize_count_lines(line, len);
+  struct rowview one;
+  struct rowview* views = nlines <= 1 ? &one : malloc(nlines * sizeof(struct rowview));
+  if (views != NULL) {
+    nlines = tokenize_lines(line, len, TOKENIZE_WHITESPACE, views, nlines);
+  }
+  for (int l = 0; views != NULL && l < nlines; l++) {
+    for (int i = 0; i < views[l].ncols && row->ncols < MAXCOLS; i++) {
+      const char* col = views[l].line + views[l].offs[i];
+      int n = views[l].lens[i] < MAXLEN - 1 ? views[l].lens[i] : MAXLEN - 1;
+      memcpy(row->cols[row->ncols], col, n);
+      row->cols[row->ncols++][n] = '\0';
+    }
+  }
+  if (views != &one) {
+    free(views);
+  }
+  free(line);
+  return row;
+}
@@ -0,0 +1,44 @@
+// vectorized column splitting of whole buffers of lines
+#ifndef __tokenize_h__
+#define __tokenize_h__
+
+#include "rowview.h"
+
+typedef enum {
+  TOKENIZE_WHITESPACE, // columns separated by runs of ' ' and '\t', like SplitCols()
+  TOKENIZE_CSV // ',' separated, fields may be "quoted" and hold ',' and '\n'
+} TokenFormat;
+
+typedef enum {
+  TOKENIZE_SCALAR,
+  TOKENIZE_SSE2, // 16 bytes per compare
+  TOKENIZE_AVX2, // 32 bytes per compare
+  TOKENIZE_AUTO // the widest the CPU has, the default
+} TokenizerKernel;
+
+// Picks how delimiters are found; returns the kernel that will be used,
+// which is narrower than "kernel" if the CPU lacks it. Without a call,
+// the widest kernel is picked once, on first use.
+TokenizerKernel tokenize_set_kernel(TokenizerKernel kernel);
+
+// Upper bound of the lines (CSV records) in buf[0, len)
+int tokenize_count_lines(const char* buf, long len);
+
+// Splits every line of buf[0, len) into columns in one pass. The
+// positions of delimiters, '\n's and quotes are found 64 bytes at a time
+// as bitmasks, and only those positions are visited one by one. Line i
+// is described by views[i], whose columns are slices of the buffer like
+// SplitColsView() makes; columns past MAXCOLS are dropped. Quoted CSV
+// fields are sliced without their quotes, and escaped quotes ("") are
+// left doubled, since nothing is copied. Returns the number of lines, or
+// -1 if there are more than "maxlines".
+int tokenize_lines(const char* buf, long len, TokenFormat fmt, struct rowview* views, int maxlines);
+
+// Mappers
+// arg: char* line
+// returns: `struct row`, the same as SplitCols(), which it replaces: runs
+// of ' ', '\t' and '\n' separate columns, even within one line. Columns
+// past MAXCOLS are dropped, where SplitCols() would overrun the row.
+void* SplitColsFast(void* arg);
+
+#endif // __tokenize_h__
@@ -0,0 +1,93 @@
+// header-only typed pipelines on top of mapPartitions()
+#ifndef __typed_h__
+#define __typed_h__
+
+#include <stdio.h>
+#include "minispark.h"
+#include "list.h"
+
+// A typed pipeline is a statically known chain of map/filter stages.
+// The macros below expand the whole chain into one loop per partition
+// that calls every stage directly, so the compiler can inline and
+// specialize them instead of going through a void* call per element.
+//
+//   static inline struct row* split(char* line) { ... }
+//   static inline int keep(struct row* r, void* ctx) { ... }
+//
+//   MS_SOURCE_PIPELINE(rows, char*, read_line,
+//     MS_MAP(char*, struct row*, split)
+//     MS_FILTER(struct row*, keep))
+//
+//   RDD* out = mapPartitions(RDDFromFiles(files, n), rows, ctx);
+//
+// The result is a regular RDD, so it can feed (or be fed by) any other
+// transformation at the stage boundary.
+//
+// Stages work on the current element "_ms_v". A map returning NULL
+// drops the element, like in map(). Elements must be pointers since
+// partitions are List*s.
+
+// apply "fn" (in_t -> out_t) to the current element
+#define MS_MAP(in_t, out_t, fn)                 \
+  {                                             \
+    out_t _ms_out = fn((in_t)_ms_v);            \
+    if (_ms_out == NULL) {                      \
+      continue;                                 \
+    }                                           \
+    _ms_v = (void*)_ms_out;                     \
+  }
+
+// keep the current element only if fn(elem, ctx) returns non-zero
+#define MS_FILTER(t, fn)                        \
+  if (!fn((t)_ms_v, _ms_ctx)) {                 \
+    continue;                                   \
+  }
+
+// define "static int name(void* input, List* output, void* ctx)" running
+// STAGES over every element of a List* partition
+#define MS_PIPELINE(name, STAGES)                                   \
+  static int name(void* input, List* output, void* ctx) {           \
+    void* _ms_ctx = ctx;                                            \
+    (void)_ms_ctx;                                                  \
+    for (ListNode* _ms_n = ((List*)input)->head; _ms_n != NULL;     \
+         _ms_n = _ms_n->next) {                                     \
+      void* _ms_v = _ms_n->data;                                    \
+      STAGES                                                        \
+      if (list_add_elem(output, _ms_v) != 0) {                      \
+        return -1;                                                  \
+      }                                                             \
+    }                                                               \
+    return 0;                                                       \
+  }
+
+// same as MS_PIPELINE, but for a file source partition. "reader" is
+// called with the FILE* until it returns NULL, like a source Mapper.
+#define MS_SOURCE_PIPELINE(name, src_t, reader, STAGES)             \
+  static int name(void* input, List* output, void* ctx) {           \
+    void* _ms_ctx = ctx;                                            \
+    (void)_ms_ctx;                                                  \
+    FILE* _ms_fp = (FILE*)input;                                    \
+    src_t _ms_src;                                                  \
+    while ((_ms_src = reader(_ms_fp)) != NULL) {                    \
+      void* _ms_v = (void*)_ms_src;                                 \
+      STAGES                                                        \
+      if (list_add_elem(output, _ms_v) != 0) {                      \
+        return -1;                                                  \
+      }                                                             \
+    }                                                               \
+    return 0;                                                       \
+  }
+
+// wrap a typed function as a plain Mapper/Filter, for stages that
+// have to stay in the untyped RDD graph
+#define MS_TYPED_MAPPER(name, in_t, out_t, fn)                      \
+  static void* name(void* arg) {                                    \
+    return (void*)fn((in_t)arg);                                    \
+  }
+
+#define MS_TYPED_FILTER(name, t, fn)                                \
+  static int name(void* arg, void* ctx) {                           \
+    return fn((t)arg, ctx) ? 1 : 0;                                 \
+  }
+
+#endif // __typed_h__
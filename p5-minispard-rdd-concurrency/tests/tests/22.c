@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+#include "typed.h"
+
+// typed stages, visible to the compiler so they can be inlined
+static inline char* read_line(FILE* fp) {
+  char *line = NULL;
+  size_t size = 0;
+  if (getline(&line, &size, fp) < 0) {
+    free(line);
+    return NULL;
+  }
+  return line;
+}
+
+static inline int contains(char* line, void* needle) {
+  if (strstr(line, (char*)needle)) {
+    return 1;
+  }
+  free(line);
+  return 0;
+}
+
+MS_SOURCE_PIPELINE(grep_lines, char*, read_line,
+  MS_FILTER(char*, contains))
+
+MS_PIPELINE(split_rows,
+  MS_MAP(char*, struct row*, SplitCols))
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf("usage: ./grep <query> file1 ...\n");
+    return -1;
+  }
+
+  MS_Run();
+  RDD* files = RDDFromFiles(argv + 2, argc - 2);
+  RDD* matches = mapPartitions(files, grep_lines, argv[1]);
+  print(matches, StringPrinter);
+
+  // typed stages mixed with regular transformations
+  RDD* files2 = RDDFromFiles(argv + 2, argc - 2);
+  RDD* lines = filter(map(files2, GetLines), StringContains, argv[1]);
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+  RDD* rows = partitionBy(mapPartitions(lines, split_rows, NULL), ColumnHashPartitioner, 2, &pctx);
+  printf("rows: %d\n", count(rows));
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+
+  return 0;
+}
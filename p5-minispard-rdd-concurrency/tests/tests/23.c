@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+#include "stream.h"
+
+#define STREAMFILE "./tests-out/23.stream"
+
+void* SumLengths(void* acc, void* elem, void* ctx) {
+  (void)ctx;
+  long* total = (long*)acc;
+  *total += strlen((char*)elem);
+  return total;
+}
+
+// like StringContains, but does not free the lines other queries read
+int HasWord(void* arg, void* word) {
+  return strstr((char*)arg, (char*)word) != NULL;
+}
+
+int fail_bad = 1;
+
+// fails every task that sees a line containing "bad", while fail_bad is set
+void* FailOnBad(void* arg) {
+  if (fail_bad && strstr((char*)arg, "bad") != NULL) {
+    MS_FailTask();
+  }
+  return arg;
+}
+
+void append(const char* text) {
+  FILE* fp = fopen(STREAMFILE, "a");
+  fputs(text, fp);
+  fclose(fp);
+}
+
+int main() {
+  FILE* fp = fopen(STREAMFILE, "w");
+  fputs("one\ntwo\nthree one\n", fp);
+  fclose(fp);
+
+  char* filenames[1] = {STREAMFILE};
+  long total = 0;
+  int n;
+
+  MS_Run();
+  Stream* s = stream_init(filenames, 1, 10);
+  RDD* matches = filter(stream_source(s), HasWord, "one");
+  StreamQuery* cnt = stream_count(s, matches);
+  StreamQuery* bytes = stream_reduce(s, matches, SumLengths, &total, NULL);
+  StreamQuery* checked = stream_count(s, map(stream_source(s), FailOnBad));
+
+  n = stream_run_batch(s);
+  printf("batch %d lines, %ld matches, %ld bytes\n", n,
+         stream_query_count(cnt), *(long*)stream_query_value(bytes));
+
+  append("four one\nfive\nsix o");
+  n = stream_run_batch(s);
+  printf("batch %d lines, %ld matches, %ld bytes\n", n,
+         stream_query_count(cnt), *(long*)stream_query_value(bytes));
+
+  append("ne\n");
+  n = stream_run_batch(s);
+  printf("batch %d lines, %ld matches, %ld bytes\n", n,
+         stream_query_count(cnt), *(long*)stream_query_value(bytes));
+
+  n = stream_run_batch(s);
+  printf("batch %d lines, %ld matches, %ld bytes\n", n,
+         stream_query_count(cnt), *(long*)stream_query_value(bytes));
+
+  // a batch that cannot be computed is not counted
+  MS_SetTaskRetries(0);
+  append("bad one\n");
+  n = stream_run_batch(s);
+  printf("batch %d lines, %ld matches, %ld bytes, %ld checked\n", n,
+         stream_query_count(cnt), *(long*)stream_query_value(bytes), stream_query_count(checked));
+
+  // its lines are read again, with the ones appended since
+  fail_bad = 0;
+  append("seven\n");
+  n = stream_run_batch(s);
+  printf("batch %d lines, %ld matches, %ld bytes, %ld checked\n", n,
+         stream_query_count(cnt), *(long*)stream_query_value(bytes), stream_query_count(checked));
+
+  stream_destroy(s);
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib.h"
+#include "minispark.h"
+
+int lines_read = 0;
+int mapped = 0;
+int crashed = 0;
+
+// fails the task reading the second line, once
+void* FlakyLines(void* arg) {
+  if (++lines_read == 2) {
+    MS_FailTask();
+  }
+  return GetLines(arg);
+}
+
+// fails on the second element, once
+void* FlakyMap(void* arg) {
+  if (++mapped == 2) {
+    MS_FailTask();
+  }
+  return arg;
+}
+
+// segfaults on the first element, once
+void* CrashOnce(void* arg) {
+  if (!crashed) {
+    crashed = 1;
+    *(volatile int*)NULL = 1;
+  }
+  return arg;
+}
+
+int source_crashed = 0;
+
+// segfaults on its first call, once
+void* CrashingLines(void* arg) {
+  if (!source_crashed) {
+    source_crashed = 1;
+    *(volatile int*)NULL = 1;
+  }
+  return GetLines(arg);
+}
+
+int partitioned = 0;
+
+// fails on the second element, once per reset of "partitioned"
+unsigned long FlakyPartitioner(void* arg, int numpartitions, void* ctx) {
+  (void)ctx;
+  if (++partitioned == 2) {
+    MS_FailTask();
+  }
+  return ((char*)arg)[0] % numpartitions;
+}
+
+void* AlwaysFail(void* arg) {
+  MS_FailTask();
+  return arg;
+}
+
+void* Identity(void* arg) {
+  return arg;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("need one file\n");
+    return -1;
+  }
+
+  MS_Run();
+
+  printf("flaky source: %d\n", count(map(RDDFromFiles(argv + 1, 1), FlakyLines)));
+  printf("flaky map: %d\n", count(map(map(RDDFromFiles(argv + 1, 1), GetLines), FlakyMap)));
+
+  printf("flaky partitionBy: %d\n", count(partitionBy(map(RDDFromFiles(argv + 1, 1), GetLines), FlakyPartitioner, 2, NULL)));
+  // each morsel publishes its own elements
+  partitioned = 0;
+  MS_SetMorselSize(1, 0);
+  printf("flaky partitionBy morsels: %d\n",
+         count(partitionBy(map(RDDFromFiles(argv + 1, 1), GetLines), FlakyPartitioner, 2, NULL)));
+  MS_SetMorselSize(DEFAULT_MORSEL_ELEMS, 0);
+
+  MS_SetSandbox(1);
+  printf("crash: %d\n", count(map(map(RDDFromFiles(argv + 1, 1), GetLines), CrashOnce)));
+  // the crashed byte morsel's stream and buffer are released
+  MS_SetMorselSize(DEFAULT_MORSEL_ELEMS, 4);
+  printf("crash in morsel: %d\n", count(map(RDDFromFiles(argv + 1, 1), CrashingLines)));
+  MS_SetMorselSize(DEFAULT_MORSEL_ELEMS, 0);
+  MS_SetSandbox(0);
+
+  MS_SetTaskRetries(1);
+  RDD* failed = map(map(RDDFromFiles(argv + 1, 1), GetLines), AlwaysFail);
+  printf("failed: %d\n", count(failed));
+  printf("dependent: %d\n", count(map(failed, Identity)));
+  print(failed, StringPrinter);
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib.h"
+#include "minispark.h"
+#include "rowview.h"
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    printf("usage: 25.tmp <query> file1 file2\n");
+    return -1;
+  }
+
+  struct sumjoin_ctx sctx;
+  sctx.keynum = 0;
+  sctx.target = 1;
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+
+  MS_Run();
+
+  RDD* lines = mapPartitions(RDDFromFiles(argv + 2, 2), GetLineViews, NULL);
+  print(filter(lines, StringContainsView, argv[1]), LineViewPrinter);
+
+  RDD* data1 = map(mapPartitions(RDDFromFiles(argv + 2, 1), GetLineViews, NULL), SplitColsView);
+  RDD* data2 = map(mapPartitions(RDDFromFiles(argv + 3, 1), GetLineViews, NULL), SplitColsView);
+  RDD* repart1 = partitionBy(data1, ColumnHashPartitionerView, 4, &pctx);
+  RDD* repart2 = partitionBy(data2, ColumnHashPartitionerView, 4, &pctx);
+  print(repart1, RowViewPrinter);
+  print(join(repart1, repart2, SumJoinView, &sctx), RowPrinter);
+
+  // rows without the key or target column join with nothing
+  char* shortfile = "./tests-out/25.short";
+  FILE* fp = fopen(shortfile, "w");
+  fputs("a 1\n\nb\na 2\n", fp);
+  fclose(fp);
+  RDD* short1 = map(mapPartitions(RDDFromFiles(&shortfile, 1), GetLineViews, NULL), SplitColsView);
+  RDD* short2 = map(mapPartitions(RDDFromFiles(&shortfile, 1), GetLineViews, NULL), SplitColsView);
+  RDD* joined = join(partitionBy(short1, ColumnHashPartitionerView, 2, &pctx),
+                     partitionBy(short2, ColumnHashPartitionerView, 2, &pctx), SumJoinView, &sctx);
+  printf("short rows joined: %d\n", count(joined));
+
+  // keys longer than SplitCols() keeps match on what it keeps
+  char* longfile = "./tests-out/25.long";
+  fp = fopen(longfile, "w");
+  fputs("abcdefghijklmnopqrstuvwxyz0123456789 1\nabcdefghijklmnopqrstuvwxyz01234XYZ 2\n", fp);
+  fclose(fp);
+  RDD* long1 = map(mapPartitions(RDDFromFiles(&longfile, 1), GetLineViews, NULL), SplitColsView);
+  RDD* long2 = map(map(RDDFromFiles(&longfile, 1), GetLines), SplitCols);
+  RDD* long3 = map(mapPartitions(RDDFromFiles(&longfile, 1), GetLineViews, NULL), SplitColsView);
+  RDD* long4 = map(map(RDDFromFiles(&longfile, 1), GetLines), SplitCols);
+  printf("long keys joined: %d views, %d rows\n", count(join(long1, long3, SumJoinView, &sctx)),
+         count(join(long2, long4, SumJoin, &sctx)));
+
+  // a partition's views are freed together
+  List* views = list_init();
+  fp = fopen(shortfile, "r");
+  GetLineViews(fp, views, NULL);
+  fclose(fp);
+  printf("views of the partition: %d\n", list_get_size(views));
+  FreeRowViews(list_get(views, 0));
+  list_free(views);
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
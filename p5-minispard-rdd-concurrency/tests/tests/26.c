@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define INFILE "./tests-out/26.in"
+#define NUMLINES (10000)
+
+int expected = 0;
+int step = 1;
+int out_of_order = 0;
+
+// lines are "line <i>\n"; checks that they come back in file order
+void OrderPrinter(void* arg) {
+  int i = atoi((char*)arg + strlen("line "));
+  if (i != expected) {
+    out_of_order++;
+  }
+  expected = i + step;
+}
+
+int KeepEven(void* arg, void* ctx) {
+  (void)ctx;
+  return atoi((char*)arg + strlen("line ")) % 2 == 0;
+}
+
+void* Identity(void* arg) {
+  return arg;
+}
+
+void check_order(RDD* rdd, int each) {
+  expected = 0;
+  step = each;
+  out_of_order = 0;
+  print(rdd, OrderPrinter);
+  printf("%s\n", out_of_order == 0 && expected == NUMLINES ? "in order" : "out of order");
+}
+
+int main() {
+  FILE* fp = fopen(INFILE, "w");
+  if (fp == NULL) {
+    printf("cannot create %s\n", INFILE);
+    return -1;
+  }
+  for (int i = 0; i < NUMLINES; i++) {
+    fprintf(fp, "line %d\n", i);
+  }
+  fclose(fp);
+  char* files[] = {INFILE};
+
+  MS_Run();
+
+  // byte morsels over the file, element morsels over the lines
+  MS_SetMorselSize(128, 1000);
+  RDD* lines = map(RDDFromFiles(files, 1), GetLines);
+  printf("lines: %d\n", count(lines));
+  check_order(lines, 1);
+
+  RDD* even = filter(map(lines, Identity), KeepEven, NULL);
+  printf("even: %d\n", count(even));
+  check_order(even, 2);
+
+  RDD* parts = partitionBy(lines, StringHashPartitioner, 4, NULL);
+  printf("partitioned: %d\n", count(parts));
+
+  // morsels smaller than a line: every line is still read exactly once
+  MS_SetMorselSize(1, 3);
+  lines = map(RDDFromFiles(files, 1), GetLines);
+  printf("lines: %d\n", count(lines));
+  check_order(lines, 1);
+
+  // morsels off
+  MS_SetMorselSize(0, 0);
+  lines = map(RDDFromFiles(files, 1), GetLines);
+  even = filter(lines, KeepEven, NULL);
+  printf("even: %d\n", count(even));
+  check_order(even, 2);
+
+  MS_TearDown();
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+int filtered = 0;
+
+// lines are "<key>\t<value>"
+unsigned long KeyPartitioner(void* arg, int numpartitions, void* ctx) {
+  (void)ctx;
+  unsigned long hash = 5381;
+  for (char* c = (char*)arg; *c != '\0' && *c != '\t'; c++) {
+    hash = hash * 33 + *c;
+  }
+  return hash % numpartitions;
+}
+
+int NotX(void* arg, void* ctx) {
+  (void)ctx;
+  __atomic_add_fetch(&filtered, 1, __ATOMIC_RELAXED);
+  return ((char*)arg)[0] != 'x';
+}
+
+void* KeyJoin(void* arg1, void* arg2, void* ctx) {
+  (void)ctx;
+  size_t len = strcspn((char*)arg1, "\t");
+  if (len != strcspn((char*)arg2, "\t") || strncmp((char*)arg1, (char*)arg2, len) != 0) {
+    return NULL;
+  }
+  return strndup((char*)arg1, len);
+}
+
+// key-partitioned lines of "file", written the long way round
+RDD* keyed(char* file) {
+  char* files[] = {file};
+  RDD* lines = map(map(map(RDDFromFiles(files, 1), GetLines), identity), identity);
+  RDD* twice = partitionBy(partitionBy(lines, StringHashPartitioner, 3, NULL), KeyPartitioner, 4, NULL);
+  return filter(twice, NotX, NULL);
+}
+
+RDD* plan(char* file1, char* file2) {
+  RDD* left = keyed(file1);
+  RDD* right = keyed(file2);
+  // already partitioned by key: the join needs no new shuffle
+  return join(partitionBy(left, KeyPartitioner, 4, NULL),
+              partitionBy(right, KeyPartitioner, 4, NULL), KeyJoin, NULL);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf("need two files\n");
+    return -1;
+  }
+
+  MS_Run();
+
+  RDD* joined = plan(argv[1], argv[2]);
+  explain(joined);
+  printf("joined: %d\n", count(joined));
+  printf("filter calls: %d\n", filtered);
+  explain(joined);
+
+  MS_SetOptimizer(0);
+  filtered = 0;
+  joined = plan(argv[1], argv[2]);
+  explain(joined);
+  printf("joined: %d\n", count(joined));
+  printf("filter calls: %d\n", filtered);
+
+  MS_TearDown();
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+#include "sorted.h"
+
+#define LEFTFILE "./tests-out/28.left"
+#define RIGHTFILE "./tests-out/28.right"
+
+// lines are "<key>\t<value>\n"
+int KeyCmp(void* a, void* b, void* ctx) {
+  (void)ctx;
+  size_t la = strcspn((char*)a, "\t");
+  size_t lb = strcspn((char*)b, "\t");
+  int c = strncmp((char*)a, (char*)b, la < lb ? la : lb);
+  return c != 0 ? c : (int)la - (int)lb;
+}
+
+void* PairJoin(void* arg1, void* arg2, void* ctx) {
+  char* l = (char*)arg1;
+  char* r = (char*)arg2;
+  if (KeyCmp(l, r, ctx) != 0) {
+    return NULL;
+  }
+  char* out = malloc(64);
+  size_t klen = strcspn(l, "\t");
+  snprintf(out, 64, "%.*s %d+%d", (int)klen, l, atoi(l + klen + 1), atoi(r + strcspn(r, "\t") + 1));
+  return out;
+}
+
+void PairPrinter(void* arg) {
+  printf("%s\n", (char*)arg);
+}
+
+void write_lines(char* path, char* lines[], int n) {
+  FILE* fp = fopen(path, "w");
+  for (int i = 0; i < n; i++) {
+    fprintf(fp, "%s\n", lines[i]);
+  }
+  fclose(fp);
+}
+
+RDD* lines_of(char* path) {
+  char* files[] = {path};
+  return map(RDDFromFiles(files, 1), GetLines);
+}
+
+int main() {
+  char* left[] = {"e\t1", "c\t1", "a\t1", "c\t2", "b\t1", "a\t2", "c\t3"};
+  char* right[] = {"d\t1", "c\t8", "e\t1", "a\t9", "c\t9", "e\t2"};
+  write_lines(LEFTFILE, left, 7);
+  write_lines(RIGHTFILE, right, 6);
+
+  MS_Run();
+
+  // range partition both sides the same way, then sort each partition
+  char* bounds[] = {"c\t", "e\t"};
+  struct range_ctx range = {{KeyCmp, NULL}, (void**)bounds, 2};
+  RDD* sides[2];
+  for (int i = 0; i < 2; i++) {
+    RDD* ranged = partitionBy(lines_of(i == 0 ? LEFTFILE : RIGHTFILE), RangePartitioner, 3, &range);
+    sides[i] = mapPartitions(ranged, SortPartition, &range.order);
+  }
+  RDD* merged = sortMergeJoin(sides[0], sides[1], KeyCmp, PairJoin, NULL);
+  print(merged, PairPrinter);
+  printf("merge join: %d\n", count(merged));
+
+  // same result as the nested loop join
+  RDD* hashed = join(partitionBy(lines_of(LEFTFILE), RangePartitioner, 3, &range),
+                     partitionBy(lines_of(RIGHTFILE), RangePartitioner, 3, &range), PairJoin, NULL);
+  printf("join: %d\n", count(hashed));
+
+  // unsorted inputs are detected
+  MS_SetTaskRetries(0);
+  RDD* unsorted = sortMergeJoin(lines_of(LEFTFILE), lines_of(RIGHTFILE), KeyCmp, PairJoin, NULL);
+  printf("unsorted: %d\n", count(unsorted));
+
+  MS_TearDown();
+  return 0;
+}
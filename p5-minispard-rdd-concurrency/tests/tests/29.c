@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define INFILE "./tests-out/29.in"
+#define NUMLINES (5000)
+
+void* Same(void* arg) {
+  return arg;
+}
+
+int main() {
+  FILE* fp = fopen(INFILE, "w");
+  if (fp == NULL) {
+    printf("cannot create %s\n", INFILE);
+    return -1;
+  }
+  for (int i = 0; i < NUMLINES; i++) {
+    fprintf(fp, "%d\n", i);
+  }
+  fclose(fp);
+  char* files[] = {INFILE};
+
+  MS_Run();
+
+  // one task per element: several times the size of the metric ring
+  MS_SetMorselSize(1, 0);
+  RDD* lines = map(RDDFromFiles(files, 1), GetLines);
+  printf("mapped: %d\n", count(map(lines, Same)));
+  printf("filtered: %d\n", count(filter(lines, StringContains, "7")));
+
+  MS_TearDown();
+
+  // every task's metric made it to the log, each on its own line
+  fp = fopen("metrics.log", "r");
+  if (fp == NULL) {
+    printf("no metrics.log\n");
+    return -1;
+  }
+  int maps = 0, filters = 0, bad = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    int trans;
+    if (strncmp(line, "RDD ", 4) != 0 || sscanf(strstr(line, "Trans"), "Trans %d", &trans) != 1) {
+      bad++;
+    } else if (trans == MAP) {
+      maps++;
+    } else if (trans == FILTER) {
+      filters++;
+    }
+  }
+  fclose(fp);
+  printf("map metrics: %d, filter metrics: %d, malformed: %d\n", maps, filters, bad);
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "lib.h"
+#include "minispark.h"
+
+#define INFILE "./tests-out/30.in"
+#define NUMLINES (10000)
+
+void* Same(void* arg) {
+  return arg;
+}
+
+int main() {
+  FILE* fp = fopen(INFILE, "w");
+  if (fp == NULL) {
+    printf("cannot create %s\n", INFILE);
+    return -1;
+  }
+  for (int i = 0; i < NUMLINES; i++) {
+    fprintf(fp, "%d\n", i);
+  }
+  fclose(fp);
+  char* files[] = {INFILE};
+
+  // one worker to begin with, up to 4 when the queue backs up
+  MS_SetPoolSize(1, 4);
+  MS_SetIdlePolicy(100, 4, 50);
+  MS_Run();
+  // main thread, monitor and the worker
+  printf("threads at start: %d\n", getNumThreads());
+
+  MS_SetMorselSize(1, 0);
+  RDD* lines = map(RDDFromFiles(files, 1), GetLines);
+  printf("mapped: %d\n", count(map(lines, Same)));
+  int grown = getNumThreads() - 2;
+  printf("workers grew: %s\n", grown > 1 && grown <= 4 ? "yes" : "no");
+
+  // idle workers retire down to the minimum
+  usleep(500 * 1000);
+  printf("threads after idling: %d\n", getNumThreads());
+
+  // and come back for the next stage
+  printf("filtered: %d\n", count(filter(lines, StringContains, "7")));
+
+  MS_TearDown();
+  printf("threads after teardown: %d\n", getNumThreads());
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "lib.h"
+#include "minispark.h"
+#include "scheduler.h"
+
+#define INFILE "./tests-out/31.in"
+#define NUMLINES (200)
+
+JobPool* batch_pool;
+JobPool* interactive_pool;
+volatile int batch_done = 0;
+char* files[] = {INFILE};
+
+void* SlowMap(void* arg) {
+  usleep(2000);
+  return arg;
+}
+
+void* run_batch(void* arg) {
+  (void)arg;
+  MS_SetPool(batch_pool);
+  RDD* lines = map(RDDFromFiles(files, 1), GetLines);
+  count(map(lines, SlowMap));
+  batch_done = 1;
+  return NULL;
+}
+
+// pops the tasks of the policy's queue and prints the pool of each
+void print_order(SchedPolicy* policy, JobPool** order, int n) {
+  void* q = policy->create(1);
+  Task tasks[16];
+  for (int i = 0; i < n; i++) {
+    tasks[i].pool = order[i];
+    policy->push(q, &tasks[i], -1);
+  }
+  printf("%s:", policy->name);
+  Task* t;
+  while ((t = policy->pop(q, 0)) != NULL) {
+    printf(" %s", t->pool->name);
+  }
+  printf("\n");
+  policy->destroy(q);
+}
+
+int main() {
+  FILE* fp = fopen(INFILE, "w");
+  if (fp == NULL) {
+    printf("cannot create %s\n", INFILE);
+    return -1;
+  }
+  for (int i = 0; i < NUMLINES; i++) {
+    fprintf(fp, "%d\n", i);
+  }
+  fclose(fp);
+
+  JobPool* a = MS_CreatePool("a", 2, 0);
+  JobPool* b = MS_CreatePool("b", 1, 0);
+  JobPool* c = MS_CreatePool("c", 1, 1);
+  JobPool* order[] = {a, a, a, a, a, a, b, b, b, c, c};
+  print_order(&sched_fifo, order, 11);
+  print_order(&sched_fair, order, 11);
+
+  // a small job in a high priority pool is not stuck behind a big one
+  batch_pool = MS_CreatePool("batch", 1, 0);
+  interactive_pool = MS_CreatePool("interactive", 1, 1);
+  MS_SetPoolSize(1, 1);
+  MS_SetMorselSize(1, 0);
+  MS_Run();
+
+  pthread_t batch;
+  pthread_create(&batch, NULL, run_batch, NULL);
+  usleep(100 * 1000);
+  MS_SetPool(interactive_pool);
+  RDD* lines = map(RDDFromFiles(files, 1), GetLines);
+  printf("interactive: %d\n", count(filter(lines, StringContains, "7")));
+  printf("batch still running: %s\n", batch_done ? "no" : "yes");
+  pthread_join(batch, NULL);
+
+  JobPoolStats bs = MS_GetPoolStats(batch_pool);
+  JobPoolStats is = MS_GetPoolStats(interactive_pool);
+  printf("batch: %ld jobs, %ld tasks\n", bs.jobs, bs.tasks);
+  printf("interactive: %ld jobs, %ld tasks\n", is.jobs, is.tasks);
+
+  MS_TearDown();
+  return 0;
+}
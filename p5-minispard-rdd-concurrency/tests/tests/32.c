@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+#include "shuffle.h"
+
+static int roundtrip(ShuffleCodec* codec, const char* src, size_t len) {
+  char* packed = malloc(codec->bound(len) + 1);
+  char* unpacked = malloc(len + 1);
+  size_t n = codec->compress(src, len, packed, codec->bound(len));
+  long m = codec->decompress(packed, n, unpacked, len);
+  int ok = n <= codec->bound(len) && m == (long)len && memcmp(src, unpacked, len) == 0;
+  free(packed);
+  free(unpacked);
+  return ok;
+}
+
+static long sum = 0;
+
+void SumPrinter(void* arg) {
+  struct row* row = (struct row*)arg;
+  __atomic_fetch_add(&sum, atol(row->cols[1]), __ATOMIC_RELAXED);
+}
+
+static long sumjoin(ShuffleCodec* codec, char* files[], int numfiles, struct sumjoin_ctx* sctx) {
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+  MS_SetShuffleCodec(codec);
+  RDD* data1 = map(map(RDDFromFiles(files, numfiles / 2), GetLines), SplitCols);
+  RDD* data2 = map(map(RDDFromFiles(files + numfiles / 2, numfiles - numfiles / 2), GetLines), SplitCols);
+  RDD* repart1 = withEncoding(partitionBy(data1, ColumnHashPartitioner, 4, &pctx), RowEncoder, RowDecoder);
+  RDD* repart2 = withEncoding(partitionBy(data2, ColumnHashPartitioner, 4, &pctx), RowEncoder, RowDecoder);
+  sum = 0;
+  print(join(repart1, repart2, SumJoin, sctx), SumPrinter);
+  return sum;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf("usage: 32.tmp file1 file2 ...\n");
+    return -1;
+  }
+
+  // codec on its own: runs, text, incompressible bytes, tiny inputs
+  size_t len = 200000;
+  char* zeros = calloc(len, 1);
+  char* text = malloc(len);
+  char* noise = malloc(len);
+  srand(32);
+  for (size_t i = 0; i < len; i++) {
+    text[i] = "the quick brown fox jumps over the lazy dog\n"[i % 44];
+    noise[i] = (char)rand();
+  }
+  printf("zeros: %s\n", roundtrip(&codec_lz, zeros, len) ? "ok" : "bad");
+  printf("text: %s\n", roundtrip(&codec_lz, text, len) ? "ok" : "bad");
+  printf("noise: %s\n", roundtrip(&codec_lz, noise, len) ? "ok" : "bad");
+  int small = 1;
+  for (size_t n = 0; n < 40; n++) {
+    small &= roundtrip(&codec_lz, text, n) && roundtrip(&codec_raw, noise, n);
+  }
+  printf("small: %s\n", small ? "ok" : "bad");
+
+  char packed[64];
+  char out[64];
+  size_t n = codec_lz.compress(text, 44, packed, sizeof(packed));
+  printf("truncated block rejected: %s\n", codec_lz.decompress(packed, n - 1, out, sizeof(out)) < 0 ? "yes" : "no");
+  printf("short output rejected: %s\n", codec_lz.decompress(packed, n, out, 43) < 0 ? "yes" : "no");
+  free(zeros);
+  free(text);
+  free(noise);
+
+  // the same join with pointer, serialized and compressed shuffles
+  struct sumjoin_ctx sctx;
+  sctx.keynum = 0;
+  sctx.target = 1;
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+  MS_Run();
+  long expected = sumjoin(NULL, files, numfiles, &sctx);
+  ShuffleStats s = MS_GetShuffleStats();
+  printf("pointer shuffle: sum %ld, %ld bytes\n", expected, s.bytes);
+
+  MS_ResetShuffleStats();
+  long raw = sumjoin(&codec_raw, files, numfiles, &sctx);
+  ShuffleStats r = MS_GetShuffleStats();
+  printf("raw shuffle: same sum %s, %ld rows\n", raw == expected ? "yes" : "no", r.elements);
+
+  MS_ResetShuffleStats();
+  long lz = sumjoin(&codec_lz, files, numfiles, &sctx);
+  ShuffleStats z = MS_GetShuffleStats();
+  printf("lz shuffle: same sum %s, %ld rows\n", lz == expected ? "yes" : "no", z.elements);
+  printf("lz moved less than a quarter: %s\n", z.bytes * 4 < r.bytes && z.raw_bytes == r.raw_bytes ? "yes" : "no");
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
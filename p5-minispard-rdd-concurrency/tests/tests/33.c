@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+
+static int lines_read = 0;
+
+void* CountedGetLines(void* arg) {
+  void* line = GetLines(arg);
+  if (line != NULL) {
+    __atomic_fetch_add(&lines_read, 1, __ATOMIC_RELAXED);
+  }
+  return line;
+}
+
+int KeepAll(void* arg, void* ctx) {
+  (void)arg;
+  (void)ctx;
+  return 1;
+}
+
+// orders rows by the number in column 1
+int ByValue(void* a, void* b, void* ctx) {
+  (void)ctx;
+  long x = atol(((struct row*)a)->cols[1]);
+  long y = atol(((struct row*)b)->cols[1]);
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf("usage: 33.tmp file1 file2 ...\n");
+    return -1;
+  }
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+  void* out[64];
+
+  MS_Run();
+
+  // only the first file is needed for 3 lines
+  RDD* lines = filter(map(RDDFromFiles(files, numfiles), CountedGetLines), KeepAll, NULL);
+  int n = take(lines, 3, out);
+  printf("take 3: %d\n", n);
+  for (int i = 0; i < n; i++) {
+    printf("  %s", (char*)out[i]);
+  }
+  int first = lines_read;
+  printf("files left untouched: %s\n", first > 0 && first < 2000 ? "yes" : "no");
+
+  // the whole RDD still counts every line afterwards
+  lines_read = 0;
+  int total = count(lines);
+  printf("count after take: %s\n", total == lines_read && total > first ? "ok" : "bad");
+
+  // asking for more than there is returns everything
+  RDD* few = filter(map(RDDFromFiles(files, numfiles), GetLines), StringContains, "9999");
+  n = take(few, 64, out);
+  printf("take 64 of %d rare lines: %d\n", count(few), n);
+
+  // take over a shuffle
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+  RDD* rows = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+  RDD* parts = partitionBy(rows, ColumnHashPartitioner, 4, &pctx);
+  printf("take 5 after partitionBy: %d\n", take(parts, 5, out));
+
+  // top 5 by value matches a full sort
+  rows = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+  n = top(rows, 5, ByValue, NULL, out);
+  printf("top 5:");
+  for (int i = 0; i < n; i++) {
+    printf(" %s", ((struct row*)out[i])->cols[1]);
+  }
+  printf("\n");
+
+  rows = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+  int all = count(rows);
+  void** every = malloc(all * sizeof(void*));
+  n = top(rows, all + 10, ByValue, NULL, every);
+  int sorted = n == all;
+  for (int i = 1; i < n; i++) {
+    sorted &= ByValue(every[i - 1], every[i], NULL) >= 0;
+  }
+  printf("top of everything is sorted: %s\n", sorted ? "yes" : "no");
+  free(every);
+
+  // sources hold files, not elements
+  printf("top of files: %d\n", top(RDDFromFiles(files, numfiles), 5, ByValue, NULL, out));
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
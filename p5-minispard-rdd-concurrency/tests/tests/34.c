@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+#include "sketch.h"
+
+#define MAXKEYS (20000)
+
+// exact counts of column "col" of the files, for comparison
+static char keys[MAXKEYS][MAXLEN];
+static long freq[MAXKEYS];
+static int nkeys = 0;
+
+static void exact(char* files[], int numfiles, int col) {
+  for (int f = 0; f < numfiles; f++) {
+    FILE* fp = fopen(files[f], "r");
+    char c0[MAXLEN], c1[MAXLEN];
+    while (fscanf(fp, "%31s %31s", c0, c1) == 2) {
+      char* key = col == 0 ? c0 : c1;
+      int i = 0;
+      while (i < nkeys && strcmp(keys[i], key) != 0) {
+        i++;
+      }
+      if (i == nkeys) {
+        strcpy(keys[nkeys++], key);
+      }
+      freq[i]++;
+    }
+    fclose(fp);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf("usage: 34.tmp file1 file2 ...\n");
+    return -1;
+  }
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+  struct colpart_ctx value_col;
+  value_col.keynum = 1;
+
+  // the sketches on their own
+  HyperLogLog* hll = hll_init(12);
+  for (int i = 0; i < 100000; i++) {
+    char key[16];
+    int len = sprintf(key, "k%d", i % 50000);
+    hll_add(hll, sketch_hash(key, len));
+  }
+  double e = hll_estimate(hll);
+  printf("hll 50000 keys within 5%%: %s\n", e > 47500 && e < 52500 ? "yes" : "no");
+  HyperLogLog* small = hll_init(12);
+  for (int i = 0; i < 10; i++) {
+    hll_add(small, sketch_hash((char*)&i, sizeof(i)));
+  }
+  printf("hll 10 keys: %.0f\n", hll_estimate(small));
+  hll_merge(small, hll);
+  e = hll_estimate(small);
+  printf("merged within 5%%: %s\n", e > 47500 && e < 52500 ? "yes" : "no");
+  printf("bad precision rejected: %s\n", hll_init(2) == NULL ? "yes" : "no");
+  free(hll);
+  free(small);
+
+  MS_Run();
+
+  exact(files, numfiles, 1);
+  RDD* rows = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+  long distinct = countApproxDistinct(rows, ColumnKey, &value_col, 14);
+  printf("distinct values within 2%%: %s\n",
+         distinct > nkeys * 0.98 && distinct < nkeys * 1.02 ? "yes" : "no");
+
+  rows = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+  double eps = 0.001;
+  CountMinSketch* cms = countMinSketch(rows, ColumnKey, &value_col, eps, 0.01);
+  int under = 0;
+  int over = 0;
+  long total = 0;
+  for (int i = 0; i < nkeys; i++) {
+    total += freq[i];
+  }
+  for (int i = 0; i < nkeys; i++) {
+    long est = cms_estimate(cms, keys[i], strlen(keys[i]));
+    under += est < freq[i];
+    over += est > freq[i] + eps * total;
+  }
+  printf("cms total: %s\n", cms->total == total ? "ok" : "bad");
+  printf("cms never undercounts: %s\n", under == 0 ? "yes" : "no");
+  printf("cms within eps * total for 99%% of keys: %s\n", over <= nkeys / 100 ? "yes" : "no");
+  free(cms);
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
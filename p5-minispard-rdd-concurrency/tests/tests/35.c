@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib.h"
+#include "minispark.h"
+#include "optimizer.h"
+
+static long sum = 0;
+
+void SumPrinter(void* arg) {
+  struct row* row = (struct row*)arg;
+  __atomic_fetch_add(&sum, atol(row->cols[1]), __ATOMIC_RELAXED);
+}
+
+// joins files[0, nleft) with files[nleft, numfiles), shuffled or not
+static RDD* sumjoin(char* files[], int nleft, int numfiles, int shuffle, struct sumjoin_ctx* sctx,
+                    struct colpart_ctx* pctx) {
+  RDD* left = map(map(RDDFromFiles(files, nleft), GetLines), SplitCols);
+  RDD* right = map(map(RDDFromFiles(files + nleft, numfiles - nleft), GetLines), SplitCols);
+  if (shuffle) {
+    left = partitionBy(left, ColumnHashPartitioner, 4, pctx);
+    right = partitionBy(right, ColumnHashPartitioner, 4, pctx);
+  }
+  return withJoinKey(join(left, right, SumJoin, sctx), ColumnKey, pctx);
+}
+
+static long run(char* files[], int nleft, int numfiles, int shuffle, int bloom) {
+  struct sumjoin_ctx sctx;
+  sctx.keynum = 0;
+  sctx.target = 1;
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+  MS_SetBloomJoin(bloom);
+  MS_ResetBloomJoinStats();
+  sum = 0;
+  print(sumjoin(files, nleft, numfiles, shuffle, &sctx, &pctx), SumPrinter);
+  return sum;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    printf("usage: 35.tmp small large1 large2 ...\n");
+    return -1;
+  }
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+
+  MS_Run();
+
+  long expected = run(files, 1, numfiles, 1, 0);
+  printf("plain: sum %ld\n", expected);
+
+  long got = run(files, 1, numfiles, 1, 1);
+  BloomJoinStats s = MS_GetBloomJoinStats();
+  printf("small left: same sum %s, %ld filter, most rows dropped %s\n", got == expected ? "yes" : "no",
+         s.joins, s.passed * 4 < s.probed ? "yes" : "no");
+
+  // the smaller side is picked by size, whichever input it is
+  char* swapped[16];
+  for (int i = 0; i < numfiles - 1; i++) {
+    swapped[i] = files[i + 1];
+  }
+  swapped[numfiles - 1] = files[0];
+  got = run(swapped, numfiles - 1, numfiles, 1, 1);
+  s = MS_GetBloomJoinStats();
+  printf("small right: same sum %s, %ld filter, larger side probed %s\n", got == expected ? "yes" : "no",
+         s.joins, s.probed > s.keys ? "yes" : "no");
+
+  // a reset join rebuilds its filter instead of adding another one
+  struct sumjoin_ctx sctx;
+  sctx.keynum = 0;
+  sctx.target = 1;
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+  MS_SetBloomJoin(1);
+  MS_ResetBloomJoinStats();
+  RDD* joined = sumjoin(files, 1, numfiles, 1, &sctx, &pctx);
+  int first = count(joined);
+  rdd_reset(joined);
+  for (int i = 0; i < 2; i++) {
+    RDD* side = joined->dependencies[i];
+    while (side->numdependencies > 0) {
+      side = side->dependencies[0];
+    }
+    for (ListNode* p = side->partitions->head; p != NULL; p = p->next) {
+      fseek((FILE*)p->data, 0, SEEK_SET);
+    }
+  }
+  int again = count(joined);
+  s = MS_GetBloomJoinStats();
+  printf("after reset: same count %s, %ld filter\n", first == again ? "yes" : "no", s.joins);
+
+  // without shuffles the join's inputs are filtered directly
+  long unshuffled = run(files, 1, 2, 0, 0);
+  got = run(files, 1, 2, 0, 1);
+  printf("no shuffle: same sum %s\n", got == unshuffled ? "yes" : "no");
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
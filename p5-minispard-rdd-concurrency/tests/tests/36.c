@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib.h"
+#include "minispark.h"
+#include "checkpoint.h"
+#include "shuffle.h"
+
+static long sum = 0;
+
+void SumPrinter(void* arg) {
+  struct row* row = (struct row*)arg;
+  __atomic_fetch_add(&sum, atol(row->cols[1]), __ATOMIC_RELAXED);
+}
+
+static RDD* rows(char* files[], int numfiles, struct colpart_ctx* pctx) {
+  RDD* lines = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+  return partitionBy(lines, ColumnHashPartitioner, 4, pctx);
+}
+
+static long rowsum(RDD* rdd) {
+  sum = 0;
+  print(rdd, SumPrinter);
+  return sum;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf("usage: 36.tmp dir file1 file2 ...\n");
+    return -1;
+  }
+  char* dir = argv[1];
+  char** files = argv + 2;
+  int numfiles = argc - 2;
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+
+  MS_Run();
+
+  RDD* plain = rows(files, numfiles, &pctx);
+  int expected_count = count(plain);
+  long expected_sum = rowsum(plain);
+
+  RDD* saved = rows(files, numfiles, &pctx);
+  RDD* upstream = saved->dependencies[0];
+  int ret = checkpoint(saved, dir, RowEncoder, RowDecoder);
+  printf("checkpoint: %s, same count %s\n", ret == 0 ? "ok" : "failed",
+         count(saved) == expected_count ? "yes" : "no");
+  printf("reads files: %s, upstream freed %s\n",
+         saved->numdependencies == 1 && is_file_source(saved->dependencies[0]) ? "yes" : "no",
+         upstream->partitions == NULL ? "yes" : "no");
+
+  // recomputed from the files, not from the lineage
+  rdd_reset(saved);
+  printf("after reset: same count %s, same sum %s\n", count(saved) == expected_count ? "yes" : "no",
+         rowsum(saved) == expected_sum ? "yes" : "no");
+  rdd_reset(saved);
+  RDD* keys = map(saved, identity);
+  printf("downstream: same count %s\n", count(keys) == expected_count ? "yes" : "no");
+
+  // the dropped lineage can still be computed by itself
+  printf("upstream again: same count %s\n", count(upstream) == expected_count ? "yes" : "no");
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "lib.h"
+#include "minispark.h"
+#include "output.h"
+
+#define PADDED_ROW ((1 << 20) + 100) // more than a writer buffers
+
+static long sum = 0;
+
+void SumPrinter(void* arg) {
+  struct row* row = (struct row*)arg;
+  __atomic_fetch_add(&sum, atol(row->cols[1]), __ATOMIC_RELAXED);
+}
+
+// a row padded with spaces to PADDED_ROW bytes
+size_t PaddedFormatter(void* arg, char* buf, size_t cap) {
+  size_t n = RowFormatter(arg, buf, cap);
+  if (PADDED_ROW <= cap) {
+    memset(buf + n - 1, ' ', PADDED_ROW - n);
+    buf[PADDED_ROW - 1] = '\n';
+  }
+  return PADDED_ROW;
+}
+
+static long rowsum(RDD* rdd) {
+  sum = 0;
+  print(rdd, SumPrinter);
+  return sum;
+}
+
+static char* part_file(const char* dir, int pnum) {
+  char* path = malloc(4096);
+  snprintf(path, 4096, "%s/part-%05d", dir, pnum);
+  return path;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    printf("usage: 37.tmp dir small large1 large2 ...\n");
+    return -1;
+  }
+  char* dir = argv[1];
+  char** files = argv + 2;
+  int numfiles = argc - 2;
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+
+  MS_Run();
+
+  // the same text, in the same order, either way
+  RDD* small = map(map(RDDFromFiles(files, 1), GetLines), SplitCols);
+  print(small, RowPrinter);
+  printFormatted(small, RowFormatter);
+
+  RDD* rows = partitionBy(map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols), ColumnHashPartitioner, 4,
+                          &pctx);
+  int expected = count(rows);
+  long written = saveAsTextFile(rows, dir, RowFormatter);
+  printf("saved: %s\n", written == expected ? "all rows" : "missing rows");
+
+  // one file per partition, read back as it was
+  char* names[4];
+  for (int i = 0; i < 4; i++) {
+    names[i] = part_file(dir, i);
+  }
+  RDD* saved = map(map(RDDFromFiles(names, 4), GetLines), SplitCols);
+  printf("read back: same count %s, same sum %s\n", count(saved) == expected ? "yes" : "no",
+         rowsum(saved) == rowsum(rows) ? "yes" : "no");
+  int same_partitions = 1;
+  for (int i = 0; i < 4; i++) {
+    RDD* part = map(map(RDDFromFiles(&names[i], 1), GetLines), SplitCols);
+    same_partitions &= count(part) == list_get_size((List*)list_get(rows->partitions, i));
+  }
+  printf("files match partitions: %s\n", same_partitions ? "yes" : "no");
+
+  // elements larger than the buffer
+  char* padded_dir = malloc(4096);
+  snprintf(padded_dir, 4096, "%s-padded", dir);
+  written = saveAsTextFile(small, padded_dir, PaddedFormatter);
+  char* padded = part_file(padded_dir, 0);
+  struct stat st;
+  printf("padded: %ld rows, size ok %s\n", written,
+         stat(padded, &st) == 0 && st.st_size == written * PADDED_ROW ? "yes" : "no");
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "lib.h"
+#include "minispark.h"
+#include "prefetch.h"
+
+static RDD* lines(char* files[], int numfiles) {
+  return map(RDDFromFiles(files, numfiles), GetLines);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: 38.tmp file1 file2 ...\n");
+    return -1;
+  }
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+  long size = 0;
+  for (int i = 0; i < numfiles; i++) {
+    struct stat st;
+    stat(files[i], &st);
+    size += st.st_size;
+  }
+
+  MS_SetPrefetch(0);
+  MS_Run();
+  int expected = count(lines(files, numfiles));
+  long filtered = count(filter(lines(files, numfiles), StringContains, "7"));
+  MS_TearDown();
+
+  MS_SetPrefetch(2);
+  MS_Run();
+  MS_ResetPrefetchStats();
+  RDD* read_ahead = lines(files, numfiles);
+  int got = count(read_ahead);
+  PrefetchStats s = MS_GetPrefetchStats();
+  printf("whole files: same count %s, %s read ahead, all bytes %s\n", got == expected ? "yes" : "no",
+         s.ranges == numfiles ? "all" : "not all", s.bytes == size ? "yes" : "no");
+  printf("filter: same count %s\n", count(filter(lines(files, numfiles), StringContains, "7")) == filtered ? "yes" : "no");
+
+  // the files are left at their end, like GetLines leaves them
+  rdd_reset(read_ahead);
+  MS_ResetPrefetchStats();
+  printf("again without rewinding: %d lines, %ld read ahead\n", count(read_ahead), MS_GetPrefetchStats().ranges);
+
+  // byte morsels are read ahead one by one
+  MS_SetMorselSize(DEFAULT_MORSEL_ELEMS, 4096);
+  MS_ResetPrefetchStats();
+  got = count(lines(files, numfiles));
+  s = MS_GetPrefetchStats();
+  printf("morsels: same count %s, more ranges than files %s, all bytes %s\n", got == expected ? "yes" : "no",
+         s.ranges > numfiles ? "yes" : "no", s.bytes == size ? "yes" : "no");
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
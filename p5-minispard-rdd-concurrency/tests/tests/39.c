@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+#include "setops.h"
+
+static RDD* lines(char* files[], int numfiles) {
+  return map(RDDFromFiles(files, numfiles), GetLines);
+}
+
+unsigned long OnePartition(void* arg, int numpartitions, void* ctx) {
+  (void)arg;
+  (void)numpartitions;
+  (void)ctx;
+  return 0;
+}
+
+// elements of the materialized "rdd", in partition order
+static int elements(RDD* rdd, void** out) {
+  int n = 0;
+  for (ListNode* p = rdd->partitions->head; p != NULL; p = p->next) {
+    for (ListNode* node = ((List*)p->data)->head; node != NULL; node = node->next) {
+      out[n++] = node->data;
+    }
+  }
+  return n;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 4) {
+    printf("usage: 39.tmp file1 file2 file3\n");
+    return -1;
+  }
+  char** files = argv + 1;
+
+  MS_Run();
+
+  // union: files 1-2 and 2-3, the second file twice
+  RDD* left = lines(files, 2);
+  RDD* right = lines(files + 1, 2);
+  RDD* both = unionAll(left, right);
+  int total = count(both);
+  int shared = list_get(both->partitions, 0) == list_get(left->partitions, 0)
+    && list_get(both->partitions, 2) == list_get(right->partitions, 0);
+  printf("union: %d lines in %d partitions, shared %s\n", total, both->numpartitions, shared ? "yes" : "no");
+  printf("filter over union: %d lines with a 7\n", count(filter(both, StringContains, "7")));
+
+  // distinct: duplicates are dropped before the shuffle when they are
+  // in the same partition
+  RDD* twice = unionAll(lines(files, 3), lines(files, 3));
+  RDD* unique = distinct(twice, StringHash, StringEquals, 4);
+  int n = count(unique);
+  printf("distinct: %d of %d lines, %d partitions\n", n, count(twice), unique->numpartitions);
+  RDD* together = partitionBy(twice, OnePartition, 1, NULL);
+  RDD* local = distinct(together, StringHash, StringEquals, 3)->dependencies[0]->dependencies[0];
+  printf("map-side dedup: %d of %d lines shuffled\n", count(local), count(together));
+
+  // sample
+  void** first = malloc(total * sizeof(void*));
+  void** second = malloc(total * sizeof(void*));
+  RDD* s1 = sample(both, 0.1, 42);
+  RDD* s2 = sample(both, 0.1, 42);
+  int n1 = count(s1);
+  int n2 = count(s2);
+  int same = n1 == n2 && elements(s1, first) == elements(s2, second) && memcmp(first, second, n1 * sizeof(void*)) == 0;
+  printf("sample 0.1: about a tenth %s, same seed same elements %s\n", n1 > total / 20 && n1 < total / 5 ? "yes" : "no",
+         same ? "yes" : "no");
+  RDD* s3 = sample(both, 0.1, 43);
+  int n3 = count(s3);
+  elements(s3, second);
+  printf("other seed differs: %s\n", n3 != n1 || memcmp(first, second, n1 * sizeof(void*)) != 0 ? "yes" : "no");
+  printf("sample 0: %d, sample 1: %d\n", count(sample(both, 0, 1)), count(sample(both, 1, 1)));
+
+  // a reset union lists its inputs again
+  rdd_reset(both);
+  for (int i = 0; i < 2; i++) {
+    fseek((FILE*)list_get(left->dependencies[0]->partitions, i), 0, SEEK_SET);
+    fseek((FILE*)list_get(right->dependencies[0]->partitions, i), 0, SEEK_SET);
+  }
+  printf("after reset: %d lines\n", count(both));
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+#include "group.h"
+#include "sketch.h"
+
+#define LEFT "./tests-out/40-left.in"
+#define RIGHT "./tests-out/40-right.in"
+
+// "k<i % nkeys>\t<i>" for i in [0, nlines)
+static void write_file(const char* name, int nlines, int nkeys) {
+  FILE* fp = fopen(name, "w");
+  for (int i = 0; i < nlines; i++) {
+    fprintf(fp, "k%d\t%d\n", i % nkeys, i);
+  }
+  fclose(fp);
+}
+
+static RDD* rows(char* name) {
+  char* files[] = {name, name};
+  // the same file twice: two partitions with the same keys
+  return map(map(RDDFromFiles(files, 2), GetLines), SplitCols);
+}
+
+// checks the Groups of the materialized "rdd"; returns the number of
+// keys and adds up the values of each side
+static int check(RDD* rdd, long sums[2], int* sorted, int* keys_ok) {
+  int n = 0;
+  for (ListNode* p = rdd->partitions->head; p != NULL; p = p->next) {
+    for (ListNode* node = ((List*)p->data)->head; node != NULL; node = node->next, n++) {
+      Group* g = (Group*)node->data;
+      for (int side = 0; side < 2; side++) {
+        for (int i = 0; i < g->count[side]; i++) {
+          struct row* row = (struct row*)g->values[side][i];
+          sums[side] += atol(row->cols[1]);
+          *keys_ok &= strlen(row->cols[0]) == g->keylen && memcmp(row->cols[0], g->key, g->keylen) == 0;
+          // each file is read twice, so values rise, then start over
+          if (i > 0 && i != g->count[side] / 2) {
+            *sorted &= atol(row->cols[1]) > atol(((struct row*)g->values[side][i - 1])->cols[1]);
+          }
+        }
+      }
+      free(g);
+    }
+  }
+  return n;
+}
+
+int main() {
+  write_file(LEFT, 1000, 50);
+  write_file(RIGHT, 300, 70);
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+
+  MS_Run();
+
+  RDD* groups = groupByKey(rows(LEFT), ColumnKey, &pctx, 4);
+  count(groups);
+  long sums[2] = {0, 0};
+  int sorted = 1;
+  int keys_ok = 1;
+  int n = check(groups, sums, &sorted, &keys_ok);
+  printf("groupByKey: %d keys, sum %ld, %ld on the other side, input order %s, keys %s\n", n, sums[0], sums[1],
+         sorted ? "yes" : "no", keys_ok ? "ok" : "wrong");
+
+  RDD* both = cogroup(rows(LEFT), rows(RIGHT), ColumnKey, &pctx, 3);
+  count(both);
+  int only_right = 0;
+  int sizes_ok = 1;
+  for (ListNode* p = both->partitions->head; p != NULL; p = p->next) {
+    for (ListNode* node = ((List*)p->data)->head; node != NULL; node = node->next) {
+      Group* g = (Group*)node->data;
+      int k = atoi(g->key + 1);
+      only_right += g->count[0] == 0;
+      // key k has 1000 / 50 left values and 300 / 70 (+1 below 20) right ones, twice
+      sizes_ok &= g->count[0] == (k < 50 ? 40 : 0) && g->count[1] == 2 * (300 / 70 + (k < 300 % 70));
+    }
+  }
+  sums[0] = sums[1] = 0;
+  n = check(both, sums, &sorted, &keys_ok);
+  printf("cogroup: %d keys, %d only on the right, sizes %s, sums %ld and %ld, input order %s\n", n, only_right,
+         sizes_ok ? "ok" : "wrong", sums[0], sums[1], sorted ? "yes" : "no");
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include "lib.h"
+#include "list.h"
+#include "minispark.h"
+#include "footprint.h"
+
+// bytes of the rows in "rdd", as HeapSize() counts them
+static long row_bytes(RDD* rdd, long* n) {
+  long bytes = 0;
+  *n = 0;
+  for (ListNode* p = rdd->partitions->head; p != NULL; p = p->next) {
+    for (ListNode* node = ((List*)p->data)->head; node != NULL; node = node->next) {
+      bytes += malloc_usable_size(node->data);
+      (*n)++;
+    }
+  }
+  return bytes;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: 41.tmp file1 file2 ...\n");
+    return -1;
+  }
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+
+  MS_Run();
+  MS_SetMemoryAccounting(1, HeapSize);
+
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+  RDD* rows = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+  RDD* repart = partitionBy(rows, ColumnHashPartitioner, 4, &pctx);
+  count(repart);
+
+  long n;
+  long expected = row_bytes(rows, &n) + n * sizeof(ListNode) + (numfiles + 1) * sizeof(List);
+  printf("map: nodes and rows counted %s\n", MS_RDDMemory(rows) == expected ? "yes" : "no");
+  expected = n * sizeof(ListNode) + 5 * sizeof(List) + 4 * sizeof(pthread_mutex_t);
+  printf("partitionBy: nodes only %s\n", MS_RDDMemory(repart) == expected ? "yes" : "no");
+
+  RDDFootprint top[4];
+  int ntop = MS_LargestRDDs(top, 4);
+  // the lines, the rows and the shuffled rows
+  printf("largest first: %s\n",
+         ntop == 3 && top[0].bytes >= top[1].bytes && top[1].bytes >= top[2].bytes && top[2].rdd == repart ? "yes"
+                                                                                                          : "no");
+  // the shuffled rows are counted in the partitions they were routed to
+  printf("partitionBy: spread over its partitions %s\n",
+         top[2].numpartitions == 4 && top[2].largest_partition < n * (long)sizeof(ListNode) ? "yes" : "no");
+
+  long peak;
+  long total = MS_TrackedMemory(&peak);
+  printf("peak covers both: %s\n", peak >= MS_RDDMemory(rows) + MS_RDDMemory(repart) && peak >= total ? "yes" : "no");
+
+  rdd_reset(repart);
+  printf("after reset: released %s\n", MS_RDDMemory(repart) == 0 && MS_RDDMemory(rows) == 0 ? "yes" : "no");
+
+  MS_SetMemoryAccounting(0, NULL); // no report at teardown
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
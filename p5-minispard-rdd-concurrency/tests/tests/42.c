@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib.h"
+#include "minispark.h"
+#include "shuffle.h"
+
+#define WIDE (1000) // partitions per stage
+
+void* Touch(void* arg) {
+  return arg;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: 42.tmp file1 file2 ...\n");
+    return -1;
+  }
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+
+  MS_Run();
+
+  struct colpart_ctx pctx;
+  pctx.keynum = 0;
+  RDD* rows = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+  RDD* wide = partitionBy(rows, ColumnHashPartitioner, WIDE, &pctx);
+  int n = count(wide);
+
+  // every partition is a task, all submitted at once
+  int first = count(map(wide, Touch));
+  TaskPoolStats before = MS_GetTaskPoolStats();
+  int second = count(map(wide, Touch));
+  TaskPoolStats after = MS_GetTaskPoolStats();
+  printf("wide stage: same count %s\n", first == n && second == n ? "yes" : "no");
+  // a few tasks of the previous stage may not be back in the pool yet
+  printf("next stage reuses tasks: %s\n",
+         after.recycled - before.recycled >= WIDE - 100 && after.allocated - before.allocated < 100 ? "yes" : "no");
+
+  // the fetch tasks of a serialized shuffle are submitted together too
+  MS_SetShuffleCodec(&codec_lz);
+  RDD* encoded = withEncoding(partitionBy(map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols),
+                                          ColumnHashPartitioner, WIDE, &pctx),
+                              RowEncoder, RowDecoder);
+  printf("serialized shuffle: same count %s\n", count(encoded) == n ? "yes" : "no");
+  MS_SetShuffleCodec(NULL);
+
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "lib.h"
+#include "minispark.h"
+#include "accumulator.h"
+
+static Accumulator* matched; // bytes of the lines kept
+static Accumulator* longest;
+static Accumulator* shortest;
+
+// StringContains() that also updates the accumulators
+int CountingContains(void* arg, void* needle) {
+  long len = strlen((char*)arg);
+  acc_add(longest, len);
+  acc_add(shortest, len);
+  if (strstr((char*)arg, (char*)needle) == NULL) {
+    free(arg);
+    return 0;
+  }
+  acc_add(matched, len);
+  return 1;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: 43.tmp file1 file2 ...\n");
+    return -1;
+  }
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+
+  // the same, computed here
+  long bytes = 0, max = 0, min = -1;
+  char line[4096];
+  for (int i = 0; i < numfiles; i++) {
+    FILE* fp = fopen(files[i], "r");
+    while (fgets(line, sizeof(line), fp) != NULL) {
+      long len = strlen(line);
+      max = len > max ? len : max;
+      min = min < 0 || len < min ? len : min;
+      bytes += strstr(line, "1") != NULL ? len : 0;
+    }
+    fclose(fp);
+  }
+
+  MS_SetPoolSize(4, 4); // several shards in use
+  MS_Run();
+  matched = acc_create(ACC_SUM);
+  longest = acc_create(ACC_MAX);
+  shortest = acc_create(ACC_MIN);
+
+  printf("empty: sum %ld, max is LONG_MIN %s\n", acc_value(matched),
+         acc_value(longest) == LONG_MIN ? "yes" : "no");
+
+  count(filter(map(RDDFromFiles(files, numfiles), GetLines), CountingContains, "1"));
+  printf("sum: %s\n", acc_value(matched) == bytes ? "yes" : "no");
+  printf("max: %s\n", acc_value(longest) == max ? "yes" : "no");
+  printf("min: %s\n", acc_value(shortest) == min ? "yes" : "no");
+
+  // updates from outside the pool go to the shared shard
+  acc_add(matched, 1);
+  acc_add(longest, max + 1);
+  printf("driver updates: %s\n", acc_value(matched) == bytes + 1 && acc_value(longest) == max + 1 ? "yes" : "no");
+
+  acc_reset(matched);
+  count(filter(map(RDDFromFiles(files, numfiles), GetLines), CountingContains, "1"));
+  printf("after reset: %s\n", acc_value(matched) == bytes ? "yes" : "no");
+
+  acc_free(matched);
+  acc_free(longest);
+  acc_free(shortest);
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
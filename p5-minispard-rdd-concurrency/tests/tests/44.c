@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+#include "rowview.h"
+#include "tokenize.h"
+
+#define MAXVIEWS (4096)
+
+static struct rowview views[MAXVIEWS];
+static struct rowview expected[MAXVIEWS];
+
+static const char* kernels[] = {"scalar", "sse2", "avx2"};
+
+// columns of view "i" of "a" and "b" are the same
+static int same_view(struct rowview* a, struct rowview* b) {
+  if (a->line != b->line || a->len != b->len || a->ncols != b->ncols) {
+    return 0;
+  }
+  for (int c = 0; c < a->ncols; c++) {
+    if (a->offs[c] != b->offs[c] || a->lens[c] != b->lens[c]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void print_views(int n) {
+  for (int i = 0; i < n; i++) {
+    printf("  %d:", views[i].ncols);
+    for (int c = 0; c < views[i].ncols; c++) {
+      printf(" [%.*s]", views[i].lens[c], views[i].line + views[i].offs[c]);
+    }
+    printf("\n");
+  }
+}
+
+static char* read_file(const char* name, long* len) {
+  FILE* fp = fopen(name, "r");
+  fseek(fp, 0, SEEK_END);
+  *len = ftell(fp);
+  rewind(fp);
+  char* buf = malloc(*len + 1);
+  *len = fread(buf, 1, *len, fp);
+  buf[*len] = '\0';
+  fclose(fp);
+  return buf;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: 44.tmp file1 file2 ...\n");
+    return -1;
+  }
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+
+  // every kernel splits like SplitColsView()
+  for (int i = 0; i < numfiles; i++) {
+    long len;
+    char* buf = read_file(files[i], &len);
+    int n = 0;
+    for (const char* p = buf; p < buf + len && n < MAXVIEWS; n++) {
+      const char* nl = memchr(p, '\n', buf + len - p);
+      expected[n].line = p;
+      expected[n].len = (nl ? nl + 1 : buf + len) - p;
+      SplitColsView(&expected[n]);
+      p += expected[n].len;
+    }
+    for (int k = TOKENIZE_SCALAR; k <= TOKENIZE_AVX2; k++) {
+      if (tokenize_set_kernel(k) != (TokenizerKernel)k) {
+        continue; // not on this CPU
+      }
+      int got = tokenize_lines(buf, len, TOKENIZE_WHITESPACE, views, MAXVIEWS);
+      int same = got == n;
+      for (int j = 0; same && j < n; j++) {
+        same = same_view(&views[j], &expected[j]);
+      }
+      if (!same) {
+        printf("%s differs on file %d\n", kernels[k], i);
+      }
+    }
+    free(buf);
+  }
+  tokenize_set_kernel(TOKENIZE_AUTO);
+  printf("whitespace: same as SplitColsView\n");
+
+  // spaces, tabs, long lines crossing 64-byte chunks, no final '\n'
+  const char* text =
+      "a b\tc\n"
+      "   \n"
+      "  lead and  trail  \n"
+      "0123456789012345678901234567890123456789012345678901234567890123456789 x\n"
+      "last";
+  int n = tokenize_lines(text, strlen(text), TOKENIZE_WHITESPACE, views, MAXVIEWS);
+  printf("whitespace lines: %d\n", n);
+  print_views(n);
+
+  // quoted fields, quoted ',' and '\n', empty fields and lines, CRLF
+  const char* csv =
+      "id,name,note\r\n"
+      "1,\"Smith, J\",\"two\nlines\"\n"
+      "\n"
+      "2,,\"say \"\"hi\"\"\"\n"
+      ",\n"
+      "3,plain,end";
+  n = tokenize_lines(csv, strlen(csv), TOKENIZE_CSV, views, MAXVIEWS);
+  printf("csv records: %d\n", n);
+  print_views(n);
+  for (int k = TOKENIZE_SCALAR; k <= TOKENIZE_AVX2; k++) {
+    if (tokenize_set_kernel(k) == (TokenizerKernel)k) {
+      memcpy(expected, views, n * sizeof(struct rowview));
+      int same = tokenize_lines(csv, strlen(csv), TOKENIZE_CSV, views, MAXVIEWS) == n;
+      for (int j = 0; same && j < n; j++) {
+        same = same_view(&views[j], &expected[j]);
+      }
+      if (!same) {
+        printf("%s differs on csv\n", kernels[k]);
+      }
+    }
+  }
+  tokenize_set_kernel(TOKENIZE_AUTO);
+
+  // too few views
+  printf("2 views for %d lines: %d\n", n, tokenize_lines(csv, strlen(csv), TOKENIZE_CSV, views, 2));
+
+  // SplitColsFast() makes the rows SplitCols() does, also across an
+  // embedded '\n'
+  char* samples[] = {"  key\t12 a-very-long-column-truncated-like-strncpy \n", "a 1\nb\t2\n\nc", "", "\n\n"};
+  for (int i = 0; i < 4; i++) {
+    struct row* slow = SplitCols(strdup(samples[i]));
+    struct row* fast = SplitColsFast(strdup(samples[i]));
+    int same = slow->ncols == fast->ncols;
+    for (int c = 0; same && c < slow->ncols; c++) {
+      same = strcmp(slow->cols[c], fast->cols[c]) == 0;
+    }
+    printf("SplitColsFast: %d columns, same row %s\n", fast->ncols, same ? "yes" : "no");
+    free(slow);
+    free(fast);
+  }
+
+  MS_Run();
+  RDD* rows = mapPartitions(RDDFromFiles(files, numfiles), GetRowViews, NULL);
+  int lines = count(rows);
+  RDD* split = map(mapPartitions(RDDFromFiles(files, numfiles), GetLineViews, NULL), SplitColsView);
+  printf("GetRowViews: same count %s\n", lines == count(split) ? "yes" : "no");
+  MS_TearDown();
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
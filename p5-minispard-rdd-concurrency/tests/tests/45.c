@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+#include "scheduler.h"
+#include "simulator.h"
+
+static SchedPolicy* policies[] = {&sched_fifo, &sched_steal, &sched_locality, &sched_fair};
+
+// a batch job of three stages, and a small job in a pool of higher
+// priority that arrives while the batch job runs
+static JobTrace* synthetic(int interactive) {
+  JobTrace* trace = trace_create();
+  int scan = trace_add_stage(trace, NULL, 0, 0, 0, 0);
+  for (int p = 0; p < 4; p++) {
+    trace_add_task(trace, scan, p, 100 * (p + 1));
+  }
+  int parse = trace_add_stage(trace, &scan, 1, 1, 0, 0); // shuffles its output
+  for (int p = 0; p < 4; p++) {
+    trace_add_task(trace, parse, p, 200);
+  }
+  int agg = trace_add_stage(trace, &parse, 1, 0, 0, 0);
+  for (int p = 0; p < 2; p++) {
+    trace_add_task(trace, agg, p, 300);
+  }
+  int small = trace_add_stage(trace, NULL, 0, 0, interactive, 150);
+  for (int p = 0; p < 2; p++) {
+    trace_add_task(trace, small, p, 50);
+  }
+  return trace;
+}
+
+static void simulate(JobTrace* trace, int cores, double penalty) {
+  for (int i = 0; i < 4; i++) {
+    SimConfig config = {cores, policies[i], penalty};
+    SimResult r;
+    if (sched_simulate(trace, &config, &r) != 0) {
+      printf("%s: failed\n", policies[i]->name);
+      continue;
+    }
+    printf("%s: makespan %ld, busy %ld, utilization %.3f, tasks %d, remote %d, mean wait %.1f\n",
+           policies[i]->name, r.makespan_us, r.busy_us, r.utilization, r.tasks, r.remote_tasks, r.mean_wait_us);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: 45.tmp file1 file2 ...\n");
+    return -1;
+  }
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+  JobPool* interactive = MS_CreatePool("interactive", 1, 1);
+
+  JobTrace* trace = synthetic(interactive->id);
+  printf("2 cores:\n");
+  simulate(trace, 2, 0.0);
+  printf("2 cores, remote tasks 50%% slower:\n");
+  simulate(trace, 2, 0.5);
+  printf("8 cores:\n");
+  simulate(trace, 8, 0.0);
+
+  // saved and loaded traces replay the same
+  FILE* fp = tmpfile();
+  trace_save(trace, fp);
+  rewind(fp);
+  JobTrace* loaded = trace_load(fp);
+  fclose(fp);
+  printf("loaded: %s\n", loaded != NULL && loaded->nstages == trace->nstages && loaded->ntasks == trace->ntasks &&
+                              memcmp(loaded->tasks, trace->tasks, trace->ntasks * sizeof(SimTask)) == 0
+                           ? "yes"
+                           : "no");
+  trace_free(loaded);
+  trace_free(trace);
+
+  // a stage that depends on a later one is rejected
+  trace = trace_create();
+  int first = trace_add_stage(trace, NULL, 0, 0, 0, 0);
+  trace_add_task(trace, first, 0, 10);
+  trace->stages[first].ndeps = 1;
+  trace->stages[first].deps[0] = 1;
+  SimConfig config = {1, &sched_fifo, 0.0};
+  SimResult r;
+  printf("bad trace rejected: %s\n", sched_simulate(trace, &config, &r) == -1 ? "yes" : "no");
+  trace_free(trace);
+
+  // the new policies run real jobs, and record them
+  int ok = 1;
+  int expected = -1;
+  JobTrace* recorded = NULL;
+  for (int i = 0; i < 4; i++) {
+    MS_SetScheduler(policies[i]);
+    MS_Run();
+    if (i == 3) {
+      MS_TraceStart();
+    }
+    struct colpart_ctx pctx;
+    pctx.keynum = 0;
+    RDD* rows = map(map(RDDFromFiles(files, numfiles), GetLines), SplitCols);
+    int n = count(partitionBy(rows, ColumnHashPartitioner, 3, &pctx));
+    expected = expected < 0 ? n : expected;
+    ok &= n > 0 && n == expected;
+    if (i == 3) {
+      recorded = MS_TraceStop();
+    }
+    MS_TearDown();
+  }
+  MS_SetScheduler(&sched_fair);
+  printf("jobs under every policy: %s\n", ok ? "yes" : "no");
+
+  // on one core without remote penalty, every policy keeps the core busy
+  // for the recorded durations
+  long total = 0;
+  for (int i = 0; i < recorded->ntasks; i++) {
+    total += recorded->tasks[i].duration_us;
+  }
+  int consistent = recorded->nstages >= 2 && recorded->ntasks >= 2 * numfiles;
+  for (int i = 0; i < 4; i++) {
+    SimConfig one = {1, policies[i], 0.0};
+    consistent &= sched_simulate(recorded, &one, &r) == 0 && r.tasks == recorded->ntasks && r.busy_us == total &&
+                  r.makespan_us >= total;
+  }
+  printf("recorded trace replays: %s\n", consistent ? "yes" : "no");
+  trace_free(recorded);
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib.h"
+#include "minispark.h"
+#include "profile.h"
+
+#define REPORT "./tests-out/46.report"
+#define MAXROWS (16)
+
+// a user Mapper the profiler must name from the test executable
+void* TagLine(void* arg) {
+  return arg;
+}
+
+typedef struct {
+  char name[64];
+  long calls;
+  long samples;
+  long outputs;
+} Row;
+
+static int by_name(const void* a, const void* b) {
+  return strcmp(((Row*)a)->name, ((Row*)b)->name);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    printf("usage: 46.tmp file1 file2 ...\n");
+    return -1;
+  }
+  char** files = argv + 1;
+  int numfiles = argc - 1;
+
+  char name[64];
+  profile_symbol((void*)TagLine, name, sizeof(name));
+  printf("symbol: %s\n", name);
+
+  MS_Run();
+  MS_SetProfiling(1); // every call is sampled, so samples == calls
+  RDD* lines = map(map(RDDFromFiles(files, numfiles), GetLines), TagLine);
+  printf("count: %d\n", count(filter(lines, StringContains, "one")));
+
+  // the report goes to stderr at teardown, with timings that change from
+  // run to run; keep the columns that don't
+  fflush(stdout);
+  if (freopen(REPORT, "w", stderr) == NULL) {
+    printf("cannot redirect stderr\n");
+    return -1;
+  }
+  MS_TearDown();
+  fclose(stderr);
+
+  FILE* fp = fopen(REPORT, "r");
+  Row rows[MAXROWS];
+  int nrows = 0;
+  char line[256];
+  while (fp != NULL && fgets(line, sizeof(line), fp) != NULL && nrows < MAXROWS) {
+    Row* r = &rows[nrows];
+    double cpu_ms, per_call, fanout;
+    if (sscanf(line, "%63s %ld %ld %lf %lf %ld %lf", r->name, &r->calls, &r->samples, &cpu_ms, &per_call,
+               &r->outputs, &fanout) == 7) {
+      nrows++;
+    }
+  }
+  if (fp != NULL) {
+    fclose(fp);
+  }
+  qsort(rows, nrows, sizeof(Row), by_name);
+  for (int i = 0; i < nrows; i++) {
+    printf("%s: calls %ld, sampled %s, outputs %ld\n", rows[i].name, rows[i].calls,
+           rows[i].samples == rows[i].calls ? "all" : "some", rows[i].outputs);
+  }
+
+  int num_threads = getNumThreads();
+  if (num_threads > 1) {
+    printf("Worker threads didn't terminate\n");
+    return 0;
+  }
+  return 0;
+}